@@ -0,0 +1,161 @@
+#ifndef CMDLINE_HPP
+#define CMDLINE_HPP
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 명령 줄 토크나이저와 컴파일 시간 명령 표
+// - CmdTokens::parse() 는 줄 버퍼를 제자리에서 자른다. 구분자(공백, 탭) 자리에 0 을 쓰고
+//   토큰은 줄 버퍼 안을 가리킨다. String 을 만들지 않으므로 힙 할당이 없다.
+//   토큰은 줄 버퍼를 다시 쓰기 전까지만 유효하다.
+// - 명령 표는 이름순으로 정렬된 constexpr CmdEntry 배열이다. 정렬은 CMD_TABLE_SORTED 로 컴파일 때 확인하고
+//   cmdFind() 가 이진 탐색한다.
+
+// 한 줄의 최대 토큰 수 (넘으면 overflow())
+#ifndef CMD_MAX_TOKENS
+#define CMD_MAX_TOKENS 16
+#endif
+
+// 시리얼 명령 한 줄의 최대 길이 (널 포함, 넘는 줄은 버리고 line too long)
+#ifndef CMD_LINE_MAX
+#define CMD_LINE_MAX 256
+#endif
+
+// 시리얼 명령 폴링 주기, 한 번에 읽는 최대 바이트, UART 수신 버퍼
+#ifndef CMD_POLL_MS
+#define CMD_POLL_MS 10
+#endif
+#ifndef CMD_RX_BUDGET
+#define CMD_RX_BUDGET 512
+#endif
+#ifndef CMD_RX_BUFFER
+#define CMD_RX_BUFFER 1024
+#endif
+// 명령 응답 / config set 값 JSON 문서가 같이 쓰는 고정 풀 (poolAllocator.hpp, 힙 대신)
+#ifndef CMD_JSON_POOL_BYTES
+#define CMD_JSON_POOL_BYTES 8192
+#endif
+
+class CmdTokens
+{
+private:
+    const char *mTokens[CMD_MAX_TOKENS];
+    int mCount = 0;
+    bool mOverflow = false;
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+public:
+    // line 은 0 으로 끝나고 쓸 수 있어야 한다. 연속된 구분자는 하나로 본다. 토큰 수를 반환
+    int parse(char *line)
+    {
+        mCount = 0;
+        mOverflow = false;
+
+        char *p = line;
+        while (true)
+        {
+            while (isSpace(*p))
+            {
+                p++;
+            }
+            if (*p == 0)
+            {
+                break;
+            }
+            if (mCount >= CMD_MAX_TOKENS)
+            {
+                mOverflow = true;
+                break;
+            }
+
+            mTokens[mCount++] = p;
+            while (*p != 0 && !isSpace(*p))
+            {
+                p++;
+            }
+            if (*p == 0)
+            {
+                break;
+            }
+            *p++ = 0;
+        }
+        return mCount;
+    }
+
+    int count() const { return mCount; }
+    bool overflow() const { return mOverflow; }
+
+    // 없는 위치는 def
+    const char *get(int index, const char *def = "") const
+    {
+        return index < mCount ? mTokens[index] : def;
+    }
+
+    bool is(int index, const char *text) const
+    {
+        return index < mCount && strcmp(mTokens[index], text) == 0;
+    }
+
+    long toInt(int index, long def = 0) const
+    {
+        return index < mCount ? strtol(mTokens[index], NULL, 10) : def;
+    }
+};
+
+template <typename H>
+struct CmdEntry
+{
+    const char *name;
+    H handler;
+};
+
+namespace cmdLineDetail {
+
+constexpr int compare(const char *a, const char *b)
+{
+    return (*a != *b || *a == 0) ? (int)(unsigned char)*a - (int)(unsigned char)*b : compare(a + 1, b + 1);
+}
+
+template <typename H, size_t N>
+constexpr bool sorted(const CmdEntry<H> (&table)[N], size_t i = 1)
+{
+    return i >= N || (compare(table[i - 1].name, table[i].name) < 0 && sorted(table, i + 1));
+}
+
+} // namespace cmdLineDetail
+
+// 표가 이름순이고 이름이 겹치지 않는지 컴파일 때 확인
+#define CMD_TABLE_SORTED(table) static_assert(cmdLineDetail::sorted(table), #table " must be sorted by name")
+
+// 이름으로 찾기 (없으면 NULL)
+template <typename H, size_t N>
+const CmdEntry<H> *cmdFind(const CmdEntry<H> (&table)[N], const char *name)
+{
+    size_t lo = 0;
+    size_t hi = N;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        int c = strcmp(name, table[mid].name);
+        if (c == 0)
+        {
+            return &table[mid];
+        }
+        if (c < 0)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+#endif // CMDLINE_HPP
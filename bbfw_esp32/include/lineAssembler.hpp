@@ -0,0 +1,85 @@
+#ifndef LINEASSEMBLER_HPP
+#define LINEASSEMBLER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 바이트 단위 줄 조립기
+// - push() 에 받은 바이트를 하나씩 넣으면 줄이 끝날 때 LINE 을 돌려준다. 기다리는 일이 없다.
+// - 줄 끝은 LF, CR, CRLF 모두 받는다. (CR 바로 뒤 LF 는 같은 줄 끝) 빈 줄은 버린다.
+// - N - 1 바이트를 넘는 줄은 줄 끝까지 버리고 OVERLONG 을 돌려준다.
+// - line() 은 0 으로 끝나고 쓸 수 있다. (CmdTokens::parse 가 제자리에서 자른다) 다음 push() 전까지 유효
+
+template <size_t N>
+class LineAssembler
+{
+    static_assert(N >= 2, "LineAssembler needs room for one byte and the terminator");
+
+private:
+    char mBuf[N];
+    size_t mLen = 0;
+    bool mLastCr = false;  // 직전 바이트가 CR (CRLF 의 LF 는 무시)
+    bool mDiscard = false; // 넘친 줄의 나머지를 버리는 중
+    uint32_t mLines = 0;
+    uint32_t mOverlong = 0;
+
+public:
+    enum Result
+    {
+        NONE,
+        LINE,
+        OVERLONG,
+    };
+
+    Result push(char c)
+    {
+        if (c == '\r' || c == '\n')
+        {
+            bool crlf = c == '\n' && mLastCr;
+            mLastCr = c == '\r';
+            if (crlf)
+            {
+                return NONE;
+            }
+            if (mDiscard)
+            {
+                mDiscard = false;
+                mLen = 0;
+                mOverlong++;
+                return OVERLONG;
+            }
+            if (mLen == 0)
+            {
+                return NONE;
+            }
+            mBuf[mLen] = 0;
+            mLen = 0;
+            mLines++;
+            return LINE;
+        }
+
+        mLastCr = false;
+        if (mDiscard)
+        {
+            return NONE;
+        }
+        if (mLen >= N - 1)
+        {
+            mDiscard = true;
+            return NONE;
+        }
+        mBuf[mLen++] = c;
+        return NONE;
+    }
+
+    char *line() { return mBuf; }
+
+    // 조립 중인 바이트 수
+    size_t pending() const { return mLen; }
+
+    // 완성된 줄 / 버린 긴 줄 수
+    uint32_t lines() const { return mLines; }
+    uint32_t overlong() const { return mOverlong; }
+};
+
+#endif // LINEASSEMBLER_HPP
@@ -0,0 +1,107 @@
+#ifndef MPSCRING_HPP
+#define MPSCRING_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+// 다중 생산자 / 단일 소비자 lock-free 링 버퍼 (칸마다 순번, Vyukov bounded queue)
+// - 여러 태스크, 두 코어, ISR 이 같이 push() 해도 된다. 자리는 head 의 CAS 로 잡고 칸 순번으로 공개한다.
+// - 소비자(태스크 하나)는 pop() 만 호출한다. 자리를 잡고 아직 공개하지 않은 칸이 있으면 거기서 멈췄다가 다음에 이어 간다.
+// - 가득 차면 새 항목을 버리고 overflow 카운터를 올린다.
+// - 칸 순번은 (pos - index) 로 저장해 모두 0 인 상태가 빈 링이다. 생성자가 없으므로 전역(정적) 객체로만 쓴다.
+//   0 초기화만 받으므로 다른 전역 객체 생성자(예 : Config::load)에서 push 해도 된다.
+// - ISR 에서 플래시 접근이 없도록 push() 는 항상 인라인된다. (부르는 함수가 IRAM 에 있어야 한다)
+
+#define MPSC_ALWAYS_INLINE inline __attribute__((always_inline))
+
+template <typename T, uint32_t N>
+class MpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "MpscRing size must be a power of two");
+
+private:
+    struct Cell
+    {
+        std::atomic<uint32_t> seq; // pos - index : 같으면 pos 에 쓸 수 있고, +1 이면 pos 를 읽을 수 있다.
+        T item;
+    };
+
+    // 모두 정적 0 초기화 (동적 초기화가 앞서 넣은 항목을 지우지 않게 초기값을 두지 않는다)
+    Cell mCells[N];
+    std::atomic<uint32_t> mHead; // 다음에 잡을 위치 (생산자끼리 CAS)
+    uint32_t mTail;              // 소비자 전용
+    std::atomic<uint32_t> mOverflow;
+    std::atomic<uint32_t> mHighWater;
+
+public:
+    MPSC_ALWAYS_INLINE bool push(const T &item)
+    {
+        uint32_t pos = mHead.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &mCells[pos & (N - 1)];
+            int32_t diff = (int32_t)(cell->seq.load(std::memory_order_acquire) - (pos - (pos & (N - 1))));
+            if (diff == 0)
+            {
+                if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // 소비자가 아직 비우지 않은 칸 (한 바퀴 앞)
+                mOverflow.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = mHead.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->item = item;
+        cell->seq.store(pos - (pos & (N - 1)) + 1, std::memory_order_release);
+
+        uint32_t used = pos + 1 - tailSnapshot();
+        if (used > mHighWater.load(std::memory_order_relaxed))
+        {
+            mHighWater.store(used, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // 공개된 항목을 차례로 최대 maxCount 개 꺼낸다. 꺼낸 개수를 반환
+    uint32_t pop(T *out, uint32_t maxCount)
+    {
+        uint32_t n = 0;
+        while (n < maxCount)
+        {
+            uint32_t pos = mTail;
+            Cell &cell = mCells[pos & (N - 1)];
+            uint32_t base = pos - (pos & (N - 1));
+            if (cell.seq.load(std::memory_order_acquire) != base + 1)
+            {
+                break;
+            }
+            out[n++] = cell.item;
+            cell.seq.store(base + N, std::memory_order_release);
+            mTail = pos + 1;
+        }
+        return n;
+    }
+
+    uint32_t overflow() const { return mOverflow.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return mHighWater.load(std::memory_order_relaxed); }
+    static constexpr uint32_t capacity() { return N; }
+
+private:
+    // 최대 사용량 계산용 (소비자가 동시에 바꾸므로 대략값)
+    MPSC_ALWAYS_INLINE uint32_t tailSnapshot() const
+    {
+        return *(const volatile uint32_t *)&mTail;
+    }
+};
+
+#endif // MPSCRING_HPP
@@ -0,0 +1,163 @@
+#ifndef POOLALLOCATOR_HPP
+#define POOLALLOCATOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ArduinoJson.h>
+
+// 고정 버퍼 위의 ArduinoJson 할당기 : JsonDocument doc(&pool);
+// - 앞에서부터 잘라 준다. (bump) 블록 앞에 크기와 앞 블록 위치를 두고,
+//   맨 끝 블록부터 풀리면 끝을 되돌린다. 명령 하나의 문서들은 명령이 끝나면 모두 풀리므로
+//   명령마다 버퍼 처음부터 다시 쓴다. (문서 안에 문서를 만드는 중첩도 같은 순서로 풀린다)
+// - 맨 끝 블록의 reallocate 는 제자리에서 늘리거나 줄인다. (문자열 조립, shrinkToFit)
+// - 자리가 모자라면 nullptr 을 돌려준다. ArduinoJson 이 overflowed() 로 알리고 힙은 쓰지 않는다.
+// - 잠금이 없다. 한 태스크(명령을 처리하는 앱 태스크)에서만 쓴다.
+
+template <size_t N>
+class PoolAllocator : public ArduinoJson::Allocator
+{
+    static_assert(N >= 64 && N < 0x80000000UL, "PoolAllocator size");
+
+private:
+    static const uint32_t NONE = 0xFFFFFFFFUL;
+    static const uint32_t FREED = 0x80000000UL; // size 의 최상위 비트 : 풀린 블록
+
+    struct Header
+    {
+        uint32_t size; // 본문 바이트 (8 의 배수) | FREED
+        uint32_t prev; // 앞 블록 헤더 위치 (없으면 NONE)
+    };
+
+    alignas(8) uint8_t mBuf[N];
+    size_t mTop = 0;      // 다음 블록 헤더 위치
+    uint32_t mLast = NONE; // 맨 끝 블록 헤더 위치
+    uint32_t mLive = 0;
+    size_t mPeak = 0;
+    uint32_t mFailed = 0;
+
+    static size_t align8(size_t size)
+    {
+        return (size + 7) & ~(size_t)7;
+    }
+
+    Header *header(void *ptr)
+    {
+        return (Header *)((uint8_t *)ptr - sizeof(Header));
+    }
+
+    uint32_t offsetOf(void *ptr)
+    {
+        return (uint32_t)((uint8_t *)ptr - mBuf - sizeof(Header));
+    }
+
+    // 맨 끝부터 풀린 블록을 걷어 낸다.
+    void trim()
+    {
+        while (mLast != NONE)
+        {
+            Header *h = (Header *)(mBuf + mLast);
+            if (!(h->size & FREED))
+            {
+                break;
+            }
+            mTop = mLast;
+            mLast = h->prev;
+        }
+        if (mLive == 0)
+        {
+            mTop = 0;
+            mLast = NONE;
+        }
+    }
+
+public:
+    void *allocate(size_t size) override
+    {
+        size_t need = sizeof(Header) + align8(size);
+        if (need > N - mTop)
+        {
+            mFailed++;
+            return nullptr;
+        }
+        Header *h = (Header *)(mBuf + mTop);
+        h->size = (uint32_t)align8(size);
+        h->prev = mLast;
+        mLast = (uint32_t)mTop;
+        mTop += need;
+        mLive++;
+        if (mTop > mPeak)
+        {
+            mPeak = mTop;
+        }
+        return h + 1;
+    }
+
+    void deallocate(void *ptr) override
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+        header(ptr)->size |= FREED;
+        mLive--;
+        trim();
+    }
+
+    void *reallocate(void *ptr, size_t size) override
+    {
+        if (ptr == nullptr)
+        {
+            return allocate(size);
+        }
+        Header *h = header(ptr);
+        if (offsetOf(ptr) == mLast)
+        {
+            // 맨 끝 블록 : 제자리
+            if (align8(size) > N - mLast - sizeof(Header))
+            {
+                mFailed++;
+                return nullptr;
+            }
+            h->size = (uint32_t)align8(size);
+            mTop = mLast + sizeof(Header) + h->size;
+            if (mTop > mPeak)
+            {
+                mPeak = mTop;
+            }
+            return ptr;
+        }
+        if (align8(size) <= h->size)
+        {
+            return ptr;
+        }
+        void *grown = allocate(size);
+        if (grown == nullptr)
+        {
+            return nullptr;
+        }
+        memcpy(grown, ptr, h->size);
+        deallocate(ptr);
+        return grown;
+    }
+
+    size_t capacity() const
+    {
+        return N;
+    }
+
+    // 가장 많이 쓴 바이트 (헤더 포함)
+    size_t peak() const
+    {
+        return mPeak;
+    }
+
+    // 자리가 모자라 거절한 할당 수
+    uint32_t failed() const
+    {
+        return mFailed;
+    }
+};
+
+#endif // POOLALLOCATOR_HPP
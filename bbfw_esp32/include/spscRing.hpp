@@ -0,0 +1,72 @@
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+// 단일 생산자 / 단일 소비자 lock-free 링 버퍼
+// - 생산자(ISR 등)는 push() 만, 소비자(태스크)는 pop() 만 호출한다.
+// - 가득 차면 새 항목을 버리고 overflow 카운터를 올린다. (이미 들어간 항목은 깨지지 않음)
+// - ISR 에서 플래시 접근이 없도록 push() 는 항상 인라인된다.
+
+#define SPSC_ALWAYS_INLINE inline __attribute__((always_inline))
+
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+private:
+    T mBuf[N];
+    std::atomic<uint32_t> mHead{0}; // 생산자가 쓰는 위치
+    std::atomic<uint32_t> mTail{0}; // 소비자가 읽는 위치
+    std::atomic<uint32_t> mOverflow{0};
+    std::atomic<uint32_t> mHighWater{0};
+
+public:
+    SPSC_ALWAYS_INLINE bool push(const T &item)
+    {
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        uint32_t used = head - mTail.load(std::memory_order_acquire);
+        if (used >= N)
+        {
+            mOverflow.store(mOverflow.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        mBuf[head & (N - 1)] = item;
+        mHead.store(head + 1, std::memory_order_release);
+
+        if (used + 1 > mHighWater.load(std::memory_order_relaxed))
+        {
+            mHighWater.store(used + 1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // 최대 maxCount 개를 한 번에 꺼낸다. 꺼낸 개수를 반환
+    uint32_t pop(T *out, uint32_t maxCount)
+    {
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        uint32_t avail = mHead.load(std::memory_order_acquire) - tail;
+        uint32_t n = avail < maxCount ? avail : maxCount;
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            out[i] = mBuf[(tail + i) & (N - 1)];
+        }
+        mTail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    uint32_t size() const
+    {
+        return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+    uint32_t overflow() const { return mOverflow.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return mHighWater.load(std::memory_order_relaxed); }
+};
+
+#endif // SPSCRING_HPP
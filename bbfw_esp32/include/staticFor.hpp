@@ -0,0 +1,30 @@
+#ifndef STATICFOR_HPP
+#define STATICFOR_HPP
+
+#include <stddef.h>
+#include <utility>
+#include <type_traits>
+
+// 컴파일 시간 반복
+// staticFor<N>(f) 는 f(std::integral_constant<int, 0>{}) ... f(std::integral_constant<int, N-1>{}) 를
+// 풀어 쓴 코드로 만든다. 채널 수가 빌드 시 정해지는 캡처 경로에서 런타임 루프 없이 채널별 코드를 낸다.
+
+#define STATIC_FOR_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace staticForDetail {
+
+template <typename F, int... I>
+STATIC_FOR_ALWAYS_INLINE void expand(F &&f, std::integer_sequence<int, I...>)
+{
+    (f(std::integral_constant<int, I>{}), ...);
+}
+
+} // namespace staticForDetail
+
+template <int N, typename F>
+STATIC_FOR_ALWAYS_INLINE void staticFor(F &&f)
+{
+    staticForDetail::expand(f, std::make_integer_sequence<int, N>{});
+}
+
+#endif // STATICFOR_HPP
@@ -0,0 +1,516 @@
+#include "adcCapture.hpp"
+
+#include <driver/adc.h>
+
+#include "captureBackend.hpp"
+#include "dlog.hpp"
+
+namespace adcCapture {
+
+static const uint32_t RING_MASK = ADC_RING_SAMPLES - 1;
+static_assert((ADC_RING_SAMPLES & RING_MASK) == 0, "ADC_RING_SAMPLES must be a power of two");
+
+// DMA 인터럽트당 / 한 번에 읽는 바이트 (샘플당 2바이트)
+static const uint32_t READ_BYTES = 256;
+// 드라이버 내부 버퍼 : 읽기 태스크가 잠깐 늦어도 샘플을 잃지 않도록
+static const uint32_t DRIVER_BUF_BYTES = 8192;
+
+// 에너지 창 길이 (샘플)
+static const uint32_t ENERGY_LEN = 16;
+
+enum SlotState : uint8_t
+{
+    SLOT_FREE,
+    SLOT_FILLING,  // 트리거 후 post 샘플을 채우는 중
+    SLOT_READY,    // 고정 완료, acquire() 대기
+    SLOT_ACQUIRED  // 처리 중
+};
+
+struct Slot
+{
+    Window window;
+    volatile SlotState state;
+    volatile bool overrun;
+};
+
+static Settings s_cfg;
+static int16_t *s_ring[ADC_MAX_CHANNELS] = {NULL};
+static int8_t s_chanIndex[16];           // ADC1 채널 번호 -> 캡처 채널 (-1 : 미사용)
+
+// 아래는 ADC 태스크만 쓴다.
+static frame_t s_count[ADC_MAX_CHANNELS];  // 채널별 기록한 샘플 수
+static int32_t s_dcQ8[ADC_MAX_CHANNELS];   // DC 추정 (Q8)
+static uint32_t s_energy[ADC_MAX_CHANNELS];
+static bool s_fired[ADC_MAX_CHANNELS];
+static uint32_t s_thrEnergy = 0;
+static bool s_active = false;               // 트리거 진행 중
+static int s_activeSlot = -1;
+static frame_t s_trigger = 0;
+
+static timeBase::stamp_t s_t0 = 0;          // 프레임 0 의 시각
+static bool s_t0Set = false;
+
+static Slot s_slots[ADC_WINDOW_SLOTS];
+static uint32_t s_windowId = 0;
+static portMUX_TYPE s_slotMux = portMUX_INITIALIZER_UNLOCKED;
+
+static Stats s_stats = {};
+static TaskHandle_t s_task = NULL;
+
+static inline frame_t framesDone()
+{
+    frame_t n = s_count[0];
+    for (int ch = 1; ch < s_cfg.numChannels; ch++)
+    {
+        if (s_count[ch] < n)
+        {
+            n = s_count[ch];
+        }
+    }
+    return n;
+}
+
+// 프레임 수 -> ns : frames * 1e9 는 64비트도 며칠이면 넘치므로 초와 나머지로 나눠 곱한다.
+static inline uint64_t framesToNs(frame_t frames)
+{
+    return frames / s_cfg.rateHz * 1000000000ULL + frames % s_cfg.rateHz * 1000000000ULL / s_cfg.rateHz;
+}
+
+static inline timeBase::stamp_t frameNs(frame_t frame)
+{
+    return s_t0 + framesToNs(frame);
+}
+
+uint32_t samplePeriodNs()
+{
+    return 1000000000UL / s_cfg.rateHz;
+}
+
+// 한 프레임 안에서 채널은 패턴 순서대로 변환되므로 채널 k 는 k / (rate * n) 만큼 늦다.
+uint32_t channelSkewNs(int channel)
+{
+    return (uint32_t)((uint64_t)channel * 1000000000ULL / ((uint64_t)s_cfg.rateHz * s_cfg.numChannels));
+}
+
+uint64_t ringLatencyNs()
+{
+    uint32_t framesPerRead = READ_BYTES / 2 / s_cfg.numChannels;
+    return (uint64_t)framesPerRead * 2 * samplePeriodNs() + 1000000ULL;
+}
+
+int numChannels()
+{
+    return s_cfg.numChannels;
+}
+
+static void freezeWindow(frame_t trigger)
+{
+    s_activeSlot = -1;
+    portENTER_CRITICAL(&s_slotMux);
+    for (int i = 0; i < ADC_WINDOW_SLOTS; i++)
+    {
+        if (s_slots[i].state == SLOT_FREE)
+        {
+            Window &w = s_slots[i].window;
+            w.id = ++s_windowId;
+            w.trigger = trigger;
+            w.start = trigger - s_cfg.preSamples;
+            w.length = s_cfg.preSamples + s_cfg.postSamples;
+            w.startNs = frameNs(w.start);
+            s_slots[i].overrun = false;
+            s_slots[i].state = SLOT_FILLING;
+            s_activeSlot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_slotMux);
+
+    if (s_activeSlot < 0)
+    {
+        s_stats.windowsBusy++;
+    }
+}
+
+// 채널 ch 의 에너지가 문턱을 처음 넘은 샘플 -> 에지
+static void onCrossing(int ch, frame_t index)
+{
+    s_fired[ch] = true;
+
+    if (!s_active && index >= s_cfg.preSamples)
+    {
+        s_active = true;
+        s_trigger = index;
+        s_stats.triggers++;
+        freezeWindow(index);
+    }
+
+    dataCapture::pushEdgeFromTask((uint8_t)ch, frameNs(index) + channelSkewNs(ch));
+}
+
+static inline void putSample(int ch, uint16_t raw)
+{
+    frame_t n = s_count[ch];
+    int16_t *ring = s_ring[ch];
+
+    // DC 제거 (느린 IIR)
+    int32_t xQ8 = (int32_t)raw << 8;
+    s_dcQ8[ch] += (xQ8 - s_dcQ8[ch]) >> 10;
+    int16_t x = (int16_t)((xQ8 - s_dcQ8[ch]) >> 8);
+
+    int16_t old = ring[(n - ENERGY_LEN) & RING_MASK];
+    ring[n & RING_MASK] = x;
+
+    // 짧은 구간 에너지 (슬라이딩 합)
+    s_energy[ch] += (uint32_t)((int32_t)x * x);
+    if (n >= ENERGY_LEN)
+    {
+        s_energy[ch] -= (uint32_t)((int32_t)old * old);
+        if (!s_fired[ch] && s_energy[ch] > s_thrEnergy)
+        {
+            onCrossing(ch, n);
+        }
+    }
+
+    s_count[ch] = n + 1;
+}
+
+// 덮어쓰일 창 정리 및 채우기가 끝난 창 고정
+static void updateWindows()
+{
+    frame_t done = framesDone();
+    s_stats.frames = (uint32_t)done;
+
+    // 다음 읽기 블록만큼 여유를 두고, 덮어쓰일 창을 찾는다.
+    uint32_t guard = READ_BYTES / 2 / s_cfg.numChannels + 1;
+
+    portENTER_CRITICAL(&s_slotMux);
+    for (int i = 0; i < ADC_WINDOW_SLOTS; i++)
+    {
+        Slot &slot = s_slots[i];
+        if (slot.state == SLOT_FREE)
+        {
+            continue;
+        }
+        if (done - slot.window.start + guard >= ADC_RING_SAMPLES)
+        {
+            if (slot.state == SLOT_READY)
+            {
+                slot.state = SLOT_FREE;
+                s_stats.windowsStale++;
+            }
+            else if (slot.state == SLOT_ACQUIRED && !slot.overrun)
+            {
+                slot.overrun = true;
+                s_stats.overrun++;
+            }
+        }
+    }
+
+    if (s_active && done >= s_trigger + s_cfg.postSamples)
+    {
+        if (s_activeSlot >= 0)
+        {
+            s_slots[s_activeSlot].state = SLOT_READY;
+        }
+        s_active = false;
+        s_activeSlot = -1;
+    }
+    portEXIT_CRITICAL(&s_slotMux);
+
+    // 창이 끝나면 모든 채널을 다시 무장
+    if (!s_active)
+    {
+        for (int ch = 0; ch < s_cfg.numChannels; ch++)
+        {
+            s_fired[ch] = false;
+        }
+    }
+}
+
+// 잃은 샘플 자리를 0 (DC 제거 후) 으로 채워 채널 샘플 수를 target 으로 맞춘다.
+static void padChannel(int ch, frame_t target)
+{
+    int16_t *ring = s_ring[ch];
+    for (frame_t n = s_count[ch]; n < target; n++)
+    {
+        int16_t old = ring[(n - ENERGY_LEN) & RING_MASK];
+        ring[n & RING_MASK] = 0;
+        if (n >= ENERGY_LEN)
+        {
+            s_energy[ch] -= (uint32_t)((int32_t)old * old);
+        }
+    }
+    s_count[ch] = target;
+}
+
+// 프레임 첫 채널(0) 샘플이 들어오기 직전 : 모든 채널이 같은 프레임 수여야 한다.
+// 샘플을 잃어 채널별 수가 어긋났으면 모자란 채널을 채워 채널 간 한 샘플 어긋남이 남지 않게 한다.
+static inline void alignFrame()
+{
+    frame_t n = s_count[0];
+    frame_t target = n;
+    for (int ch = 1; ch < s_cfg.numChannels; ch++)
+    {
+        if (s_count[ch] > target)
+        {
+            target = s_count[ch];
+        }
+    }
+    if (target == n && framesDone() == n)
+    {
+        return;
+    }
+    for (int ch = 0; ch < s_cfg.numChannels; ch++)
+    {
+        padChannel(ch, target);
+    }
+}
+
+// 샘플을 잃었다 : 채우던 창은 버리고 다시 무장한다. (창 안 샘플 시각이 이어지지 않음)
+static void dropActiveWindow()
+{
+    if (!s_active)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_slotMux);
+    if (s_activeSlot >= 0)
+    {
+        s_slots[s_activeSlot].state = SLOT_FREE;
+    }
+    portEXIT_CRITICAL(&s_slotMux);
+    s_active = false;
+    s_activeSlot = -1;
+    s_stats.windowsLost++;
+    for (int ch = 0; ch < s_cfg.numChannels; ch++)
+    {
+        s_fired[ch] = false;
+    }
+}
+
+// 블록을 다 넣은 뒤 : 마지막 프레임이 지금 끝났다고 보고 프레임 0 시각을 맞춘다.
+static void anchor(bool lost)
+{
+    timeBase::stamp_t now = timeBase::now();
+    frame_t done = framesDone();
+    if (!s_t0Set)
+    {
+        s_t0 = now - framesToNs(done);
+        s_t0Set = true;
+        return;
+    }
+
+    int64_t err = (int64_t)(now - frameNs(done));
+    s_stats.skewNs = (int32_t)(err > INT32_MAX ? INT32_MAX : err < INT32_MIN ? INT32_MIN : err);
+    if (lost || err > ADC_RESYNC_NS || err < -ADC_RESYNC_NS)
+    {
+        s_t0 += err;
+        s_stats.resync++;
+    }
+    else
+    {
+        s_t0 += err > ADC_SLEW_MAX_NS ? ADC_SLEW_MAX_NS : err < -ADC_SLEW_MAX_NS ? -ADC_SLEW_MAX_NS : err;
+    }
+}
+
+static void adcTask(void *param)
+{
+    static uint8_t buf[READ_BYTES];
+
+    while (true)
+    {
+        uint32_t got = 0;
+        esp_err_t err = adc_digi_read_bytes(buf, READ_BYTES, &got, ADC_MAX_DELAY);
+        bool lost = false;
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            // 드라이버 버퍼가 넘쳐 샘플을 잃었다. 읽은 데이터는 유효
+            // 채우던 창은 버리고, 시각 기준은 이 블록 끝에서 다시 잡는다. (채널별 샘플 수는 alignFrame)
+            s_stats.dmaOverflow++;
+            lost = true;
+            dropActiveWindow();
+        }
+        else if (err != ESP_OK)
+        {
+            continue;
+        }
+
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)buf;
+        for (uint32_t i = 0; i < got / 2; i++)
+        {
+            int ch = s_chanIndex[p[i].type1.channel];
+            if (ch >= 0)
+            {
+                // 패턴은 채널 0 부터 변환한다.
+                if (ch == 0)
+                {
+                    alignFrame();
+                }
+                putSample(ch, p[i].type1.data);
+            }
+        }
+
+        anchor(lost);
+        updateWindows();
+    }
+}
+
+/**
+ * @brief ADC1 연속 변환(DMA)을 설정하고 읽기 태스크를 시작합니다.
+ *
+ * @return false 핀이 ADC1 채널이 아니거나 드라이버 설정 실패
+ */
+bool setup(const Settings &settings)
+{
+    s_cfg = settings;
+    if (s_cfg.numChannels > ADC_MAX_CHANNELS)
+    {
+        s_cfg.numChannels = ADC_MAX_CHANNELS;
+    }
+    s_thrEnergy = ENERGY_LEN * s_cfg.threshold * s_cfg.threshold;
+
+    for (int i = 0; i < 16; i++)
+    {
+        s_chanIndex[i] = -1;
+    }
+
+    adc_digi_pattern_config_t pattern[ADC_MAX_CHANNELS] = {};
+    uint32_t chanMask = 0;
+    for (int ch = 0; ch < s_cfg.numChannels; ch++)
+    {
+        int adcCh = digitalPinToAnalogChannel(s_cfg.pins[ch]);
+        if (adcCh < 0 || adcCh >= 8)
+        {
+            DLOG_E(CAPTURE, "adc pin %d is not an ADC1 channel", s_cfg.pins[ch]);
+            return false;
+        }
+        s_chanIndex[adcCh] = ch;
+        chanMask |= 1UL << adcCh;
+
+        pattern[ch].atten = ADC_ATTEN_DB_11;
+        pattern[ch].channel = adcCh;
+        pattern[ch].unit = 0;
+        pattern[ch].bit_width = 12;
+
+        // 원형 버퍼는 시작할 때 한 번만 할당
+        if (s_ring[ch] == NULL)
+        {
+            s_ring[ch] = (int16_t *)malloc(ADC_RING_SAMPLES * sizeof(int16_t));
+            if (s_ring[ch] == NULL)
+            {
+                DLOG_E(CAPTURE, "adc ring alloc failed");
+                return false;
+            }
+        }
+        memset(s_ring[ch], 0, ADC_RING_SAMPLES * sizeof(int16_t));
+        s_count[ch] = 0;
+        s_dcQ8[ch] = 2048 << 8;
+        s_energy[ch] = 0;
+        s_fired[ch] = false;
+    }
+
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = DRIVER_BUF_BYTES;
+    init.conv_num_each_intr = READ_BYTES;
+    init.adc1_chan_mask = chanMask;
+    init.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&init) != ESP_OK)
+    {
+        DLOG_E(CAPTURE, "adc_digi_initialize failed");
+        return false;
+    }
+
+    adc_digi_configuration_t dig = {};
+    dig.conv_limit_en = true;
+    dig.conv_limit_num = 250;
+    dig.pattern_num = s_cfg.numChannels;
+    dig.adc_pattern = pattern;
+    dig.sample_freq_hz = s_cfg.rateHz * s_cfg.numChannels;
+    dig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    dig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&dig) != ESP_OK)
+    {
+        DLOG_E(CAPTURE, "adc_digi_controller_configure failed");
+        return false;
+    }
+
+    // 에지를 한 블록씩 몰아서 넣으므로 dataLoop(우선순위 2)보다 높게 둔다.
+    xTaskCreatePinnedToCore(adcTask, "adcCapture", 4096, NULL, 3, &s_task, 1);
+
+    adc_digi_start();
+    return true;
+}
+
+bool acquire(Window &window, timeBase::stamp_t t)
+{
+    uint64_t period = samplePeriodNs();
+    bool found = false;
+
+    portENTER_CRITICAL(&s_slotMux);
+    for (int i = 0; i < ADC_WINDOW_SLOTS; i++)
+    {
+        Slot &slot = s_slots[i];
+        if (slot.state != SLOT_READY)
+        {
+            continue;
+        }
+        const Window &w = slot.window;
+        if (t >= w.startNs && t < w.startNs + (uint64_t)w.length * period)
+        {
+            slot.state = SLOT_ACQUIRED;
+            window = w;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_slotMux);
+    return found;
+}
+
+void release(const Window &window)
+{
+    portENTER_CRITICAL(&s_slotMux);
+    for (int i = 0; i < ADC_WINDOW_SLOTS; i++)
+    {
+        if (s_slots[i].state == SLOT_ACQUIRED && s_slots[i].window.id == window.id)
+        {
+            s_slots[i].state = SLOT_FREE;
+        }
+    }
+    portEXIT_CRITICAL(&s_slotMux);
+}
+
+bool valid(const Window &window)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&s_slotMux);
+    for (int i = 0; i < ADC_WINDOW_SLOTS; i++)
+    {
+        if (s_slots[i].state == SLOT_ACQUIRED && s_slots[i].window.id == window.id)
+        {
+            ok = !s_slots[i].overrun;
+        }
+    }
+    portEXIT_CRITICAL(&s_slotMux);
+    return ok;
+}
+
+void span(const Window &window, int channel, const int16_t *&p1, uint32_t &n1, const int16_t *&p2, uint32_t &n2)
+{
+    uint32_t offset = (uint32_t)(window.start & RING_MASK);
+    p1 = s_ring[channel] + offset;
+    n1 = ADC_RING_SAMPLES - offset;
+    if (n1 > window.length)
+    {
+        n1 = window.length;
+    }
+    p2 = s_ring[channel];
+    n2 = window.length - n1;
+}
+
+void getStats(Stats &stats)
+{
+    stats = s_stats;
+}
+
+} // namespace adcCapture
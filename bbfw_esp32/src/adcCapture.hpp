@@ -0,0 +1,99 @@
+#ifndef ADCCAPTURE_HPP
+#define ADCCAPTURE_HPP
+
+#include <Arduino.h>
+
+#include "timeBase.hpp"
+
+// 아날로그 파형 캡처 엔진 (config set capture_mode adc)
+// bluemic393 비교기 보드 대신 마이크 출력을 ADC1 연속 변환(DMA)으로 직접 샘플링한다.
+// - 샘플은 채널별 원형 버퍼에 쌓이고, 에너지 트리거가 걸리면 pre/post 길이의 창을 "고정"한다.
+//   창은 버퍼 위치만 가리키며 샘플을 복사하지 않는다.
+// - 채널별 첫 에너지 초과 시점을 에지로 dataCapture 에 넣어 기존 상관/전송 경로를 그대로 쓴다.
+// - 4채널 x 50kS/s (합 200kS/s) 를 목표로 한다.
+
+namespace adcCapture {
+
+#define ADC_MAX_CHANNELS 8
+
+// 채널별 원형 버퍼 길이 (샘플, 2의 거듭제곱)
+#ifndef ADC_RING_SAMPLES
+#define ADC_RING_SAMPLES 8192
+#endif
+
+// 동시에 고정해 둘 수 있는 창 수
+#define ADC_WINDOW_SLOTS 4
+
+// 샘플 시각 기준(프레임 0 시각)을 DMA 블록마다 timeBase 에 맞춘다.
+// 차이가 ADC_RESYNC_NS 안이면 블록당 ADC_SLEW_MAX_NS 까지만 천천히 (ADC 클록 오차),
+// 넘거나 샘플을 잃었으면 바로 맞춘다. (상관기 만료 여유 ringLatencyNs 보다 작아야 한다)
+#ifndef ADC_SLEW_MAX_NS
+#define ADC_SLEW_MAX_NS 2000
+#endif
+#ifndef ADC_RESYNC_NS
+#define ADC_RESYNC_NS 500000
+#endif
+
+struct Settings
+{
+    int numChannels;
+    int pins[ADC_MAX_CHANNELS];  // ADC1 핀 (36,39,34,35,32,33,37,38)
+    uint32_t rateHz;             // 채널당 샘플링 속도
+    uint32_t preSamples;         // 트리거 전 샘플 수
+    uint32_t postSamples;        // 트리거 후 샘플 수
+    uint32_t threshold;          // 에너지 트리거 문턱 (DC 제거 후 RMS, ADC count)
+};
+
+// 프레임 번호 (채널당 샘플 번호) : 32비트는 50kHz 에서 하루 (~23.9 시간) 만에 넘치므로 64비트
+typedef uint64_t frame_t;
+
+// 고정된 파형 창 : 버퍼 위치만 가진다.
+struct Window
+{
+    uint32_t id;
+    frame_t start;                  // 첫 샘플의 프레임 번호
+    uint32_t length;                // 샘플 수 (pre + post)
+    frame_t trigger;                // 트리거 프레임 번호
+    timeBase::stamp_t startNs;      // 첫 샘플 시각
+};
+
+struct Stats
+{
+    uint32_t frames;        // 채널당 샘플 수
+    uint32_t dmaOverflow;   // 드라이버 버퍼가 넘친 횟수 (샘플 손실)
+    uint32_t triggers;
+    uint32_t windowsStale;  // 가져가지 않아 덮어쓴 창
+    uint32_t windowsBusy;   // 슬롯이 없어 고정하지 못한 트리거
+    uint32_t overrun;       // 처리 중인 창을 덮어쓴 횟수
+    uint32_t resync;        // 샘플 시각 기준을 바로 맞춘 횟수 (샘플 손실, 큰 오차)
+    uint32_t windowsLost;   // 채우는 중 샘플을 잃어 버린 창
+    int32_t skewNs;         // 마지막 블록의 timeBase - 샘플 시각 (보정 전)
+};
+
+// ADC DMA 시작 및 캡처 태스크 생성 (코어 1)
+bool setup(const Settings &settings);
+
+// 에지 시각이 ringLatencyNs() 만큼 늦게 들어올 수 있다. (DMA 블록 단위 처리)
+uint64_t ringLatencyNs();
+
+// 이벤트 시각 t 를 포함하는 고정 창을 가져온다. 처리 후 release() 필수
+bool acquire(Window &window, timeBase::stamp_t t);
+void release(const Window &window);
+// 처리하는 동안 덮어쓰이지 않았는지
+bool valid(const Window &window);
+
+/**
+ * @brief 창의 채널 샘플을 복사 없이 두 구간으로 돌려준다. (원형 버퍼 경계에서 나뉨)
+ */
+void span(const Window &window, int channel, const int16_t *&p1, uint32_t &n1, const int16_t *&p2, uint32_t &n2);
+
+// 채널별 샘플 간격 (ns) 및 패턴 안에서 채널 k 의 추가 지연
+uint32_t samplePeriodNs();
+uint32_t channelSkewNs(int channel);
+
+int numChannels();
+void getStats(Stats &stats);
+
+} // namespace adcCapture
+
+#endif // ADCCAPTURE_HPP
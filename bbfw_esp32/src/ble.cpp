@@ -2,11 +2,6 @@
 // #include <TaskScheduler.h>
 //  #include <tonkey.hpp>
 
-#include <BLEDevice.h>
-#include <BLEServer.h>
-#include <BLEUtils.h>
-#include <BLE2902.h>
-
 // #include <vector>
 
 #include "etc.hpp"
@@ -15,165 +10,1223 @@
 #include "context.hpp"
 
 #include "packet.hpp"
+#include "ble.hpp"
+#include "bleStack.hpp"
+#include "bleControl.hpp"
+
+#include "dataCapture.hpp"
+#include "tdoaSolver.hpp"
+#include "dlog.hpp"
 
-//------------------------------------------------ ble start
-BLEServer *pServer = NULL;
-BLECharacteristic *pCharacteristic = NULL;
+// 프로토콜/묶음/TX 태스크 : 스택과 무관 (스택 호출은 bleStack:: 로만)
 bool deviceConnected = false;
 
-// UUID for service and characteristic
-#define SERVICE_UUID "30f3eb7b-1d42-422f-9e40-4ac00754ab3d"
-#define CHARACTERISTIC_UUID "8ae845a8-019d-4509-b05d-938694f346d3"
+// 시차 묶음 전송 (cmd 0x0B / 0x0C), TX 태스크에서만 호출한다.
+static volatile uint16_t s_mtu = 23;        // 협상된 ATT MTU (BT 태스크가 갱신)
+static volatile uint8_t s_format = BLE_FORMAT_V1; // 클라이언트가 cmd 0x02 로 고른 형식 (연결마다 v1 부터)
+static uint8_t s_tickShift = 8;             // v2 tick 단위 (2^n ns)
+static S_Ble_Packet_Batch s_batch;
+static uint8_t s_v2[BLE_LOCAL_MTU - 3];     // v2 묶음 : 헤더 + 인코딩된 이벤트
+static int s_v2Len = 0;
+static uint8_t s_batchFormat = BLE_FORMAT_V1; // 대기 중인 묶음의 형식
+static int s_batchChannels = 0;
+static int s_batchEvents = 0;
+static uint32_t s_batchFirstSeq = 0;       // 대기 중인 묶음 첫 이벤트의 seq (묶음 안 이벤트는 연속)
+static uint32_t s_batchStartMs = 0;
+static uint32_t s_batchDeadlineMs = 20;
+static uint32_t s_batchFill = 0;
+static S_Ble_Stats s_stats = {};
+// dataLoop (코어 1), 앱 태스크, 스택 콜백, TX 태스크가 같이 세므로 모든 필드를 s_statsMux 안에서 바꾼다.
+static portMUX_TYPE s_statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void statsAdd(uint32_t &field, uint32_t n)
+{
+  portENTER_CRITICAL(&s_statsMux);
+  field += n;
+  portEXIT_CRITICAL(&s_statsMux);
+}
+
+// 이벤트 기록 링 : 항목 = seq + ticks[채널 수], 크기는 config ble_history
+// dataLoop 가 쓰고 TX 태스크가 (재전송할 때) 읽는다. 항목 복사만 스핀락 안에서
+// seq 는 32비트 (하루 1000만 이벤트여도 1년 이상), 넘어가는 경우는 다루지 않는다.
+static uint32_t *s_history = NULL;
+static uint32_t s_historySize = 0;
+static int s_historyChannels = 0;
+static uint32_t s_nextSeq = 0; // 다음 이벤트 seq
+static portMUX_TYPE s_historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// 재전송 (cmd 0x04 resume), TX 태스크만 만진다.
+static bool s_replaying = false;
+static uint32_t s_replayNext = 0; // 다음에 보낼 seq
+static uint32_t s_replayEnd = 0;  // 여기 전까지 (이후는 실시간으로 간다)
+static uint32_t s_replayAtMs = 0; // 이 시각 이후 다음 패킷
+static S_Ble_Packet_Batch s_replayBatch;
+static uint8_t s_replayV2[BLE_LOCAL_MTU - 3];
+
+// TX 슬롯 : 캡처 결과 하나 (시차 또는 위치) 또는 명령 응답
+enum TxKind : uint8_t
+{
+  TX_TD,
+  TX_POS,
+  TX_RAW,
+  TX_CONTROL, // 제어 특성 응답 (s_ctlOut[응답 슬롯], mask 바이트 수)
+  TX_BCAST,   // 브로드캐스트 광고 이벤트
+  TX_RESUME,  // 재전송 요청 (seq 부터 mask 전까지)
+  TX_BENCH,   // bench ble (seq 이벤트 수, channels 채널 수), 끝나면 s_benchDone
+};
+
+// 명령 응답 최대 크기 (about 24, ping 12)
+#define BLE_TX_RAW_MAX 32
+
+struct TxSlot
+{
+  TxKind kind;
+  uint8_t channels; // TX_TD : 채널 수, TX_RAW : 바이트 수
+  uint32_t seq;     // 이벤트 seq
+  uint32_t mask;
+  uint32_t ticks[CAPTURE_CHANNELS];
+  tdoaSolver::Fix fix;
+  uint8_t raw[BLE_TX_RAW_MAX];
+  uint64_t timeNs; // TX_BCAST : 가장 빠른 채널 시각
+};
+
+// 브로드캐스트 : 최근 이벤트 (TX 태스크만 만진다)
+struct BcastEvent
+{
+  S_Ble_Bcast_Event header;
+  uint8_t shift;
+  uint8_t length;
+  uint8_t data[BLE_V2_MAX_EVENT];
+};
+static bool s_bcast = false;
+static BcastEvent s_bcastEvents[BLE_BCAST_DEPTH];
+static int s_bcastCount = 0;
+static int s_bcastNewest = 0;  // 가장 최근 이벤트 위치
+static int s_bcastShown = 0;   // legacy : 지금 광고 중인 이벤트 (최근부터 몇 번째)
+static uint32_t s_bcastNewMs = 0;
+static uint32_t s_bcastShowMs = 0;
+
+// 스택 버퍼가 가득 차 notify 가 거절되면 false (재전송은 잠시 뒤 같은 패킷을 다시)
+static bool notifyTD(uint8_t *data, size_t length, int events)
+{
+  if (!bleStack::notify(data, length))
+  {
+    statsAdd(s_stats.notifyFailed, 1);
+    return false;
+  }
+
+  portENTER_CRITICAL(&s_statsMux);
+  s_stats.packets++;
+  s_stats.events += events;
+  s_stats.bytes += length;
+  portEXIT_CRITICAL(&s_statsMux);
+  return true;
+}
+
+// 이벤트 하나 (cmd 0x09)
+static void sendSingle(const uint32_t *pDurationTickList, int numChannels, uint8_t flags)
+{
+  S_Ble_Packet_Data sendData;
+  sendData.header.checkCode = CHECK_CODE;
+  sendData.header.cmd = 0x09; // 0x09 명령어
+  sendData.header.parm[0] = numChannels; // 채널 수
+  sendData.header.parm[1] = 0;
+  sendData.header.parm[2] = flags;
+
+  // (2) 채널별 데이터 복사 (채널 수만큼)
+  for (int ch = 0; ch < numChannels; ch++)
+  {
+    sendData.data[ch] = pDurationTickList[ch]; // 센서 데이터 채우기
+  }
+
+  // (3) BLECharacteristic에 값 설정 + notify
+  notifyTD((uint8_t *)&sendData, sizeof(S_Ble_Header_Packet) + sizeof(uint32_t) * numChannels, 1);
+}
+
+// 지금 MTU 로 한 패킷에 담을 수 있는 이벤트 수 (최소 1, MTU 가 작으면 잘려서 나간다)
+static int batchCapacity(int numChannels)
+{
+  int payload = (int)s_mtu - 3 - (int)(sizeof(S_Ble_Header_Packet) + sizeof(uint32_t));
+  int capacity = payload / (int)(sizeof(uint32_t) * numChannels);
+  int maxCapacity = BLE_BATCH_MAX_WORDS / numChannels;
+  if (capacity > maxCapacity)
+  {
+    capacity = maxCapacity;
+  }
+  if (capacity > 255)
+  {
+    capacity = 255;
+  }
+  return capacity < 1 ? 1 : capacity;
+}
+
+static bool sendBatch(S_Ble_Packet_Batch &batch, int numChannels, int events, uint8_t flags, uint32_t seq)
+{
+  batch.header.checkCode = CHECK_CODE;
+  batch.header.cmd = 0x0B;
+  batch.header.parm[0] = numChannels;
+  batch.header.parm[1] = events;
+  batch.header.parm[2] = flags;
+  batch.seq = seq;
+
+  return notifyTD((uint8_t *)&batch, sizeof(S_Ble_Header_Packet) + sizeof(uint32_t) * (1 + numChannels * events), events);
+}
+
+// v2 묶음 (cmd 0x0C) : buf 앞에 헤더 자리를 두고 이벤트가 인코딩되어 있다.
+static bool sendV2(uint8_t *buf, int length, int events, uint8_t flags, uint32_t seq)
+{
+  S_Ble_V2_Header *header = (S_Ble_V2_Header *)buf;
+  header->checkCode = CHECK_CODE;
+  header->cmd = 0x0C;
+  header->count = events;
+  header->tickShift = s_tickShift;
+  header->flags = flags;
+  header->seq = (uint16_t)seq;
+
+  return notifyTD(buf, length, events);
+}
+
+// v2 묶음 끝 : 지금 MTU 로 한 notify 에 담을 수 있는 곳까지
+static const uint8_t *v2End(uint8_t *buf, size_t size)
+{
+  size_t limit = s_mtu > 3 ? s_mtu - 3 : 0;
+  return buf + (limit < size ? limit : size);
+}
+
+// 대기 중인 묶음을 형식에 맞게 보낸다.
+static void sendPending()
+{
+  if (s_batchFormat == BLE_FORMAT_V2)
+  {
+    sendV2(s_v2, s_v2Len, s_batchEvents, 0, s_batchFirstSeq);
+  }
+  else
+  {
+    sendBatch(s_batch, s_batchChannels, s_batchEvents, 0, s_batchFirstSeq);
+  }
+  s_batchEvents = 0;
+}
+
+void ble_setBatch(uint32_t deadline_ms, uint32_t fill_events)
+{
+  s_batchDeadlineMs = deadline_ms;
+  s_batchFill = fill_events;
+}
+
+void ble_setTickShift(uint8_t shift)
+{
+  s_tickShift = shift > 16 ? 16 : shift;
+}
+
+// 기한이 지난 묶음을 보낸다. force 면 기한과 상관없이
+static void flushTD(bool force)
+{
+  if (s_batchEvents == 0)
+  {
+    return;
+  }
+  if (!deviceConnected)
+  {
+    s_batchEvents = 0;
+    return;
+  }
+  if (force || millis() - s_batchStartMs >= s_batchDeadlineMs)
+  {
+    sendPending();
+  }
+}
+
+// 묶음 기한까지 남은 시간 (대기 중인 이벤트가 없으면 portMAX_DELAY)
+static TickType_t flushWaitTicks()
+{
+  if (s_batchEvents == 0)
+  {
+    return portMAX_DELAY;
+  }
+  uint32_t elapsed = millis() - s_batchStartMs;
+  return elapsed >= s_batchDeadlineMs ? 0 : pdMS_TO_TICKS(s_batchDeadlineMs - elapsed) + 1;
+}
+
+// v2 로 이벤트 하나를 묶음에 넣는다. (v2 버퍼에 바로 인코딩)
+static void queueV2(const uint32_t *pDurationTickList, int numChannels, uint32_t seq)
+{
+  uint32_t mask = 0;
+  for (int ch = 0; ch < numChannels; ch++)
+  {
+    if (pDurationTickList[ch] != TICK_MISSING)
+    {
+      mask |= 1UL << ch;
+    }
+  }
+
+  const uint8_t *end = v2End(s_v2, sizeof(s_v2));
+  int n = 0;
+  if (s_batchEvents > 0)
+  {
+    n = packetV2::encodeEvent(s_v2 + s_v2Len, end, pDurationTickList, numChannels, mask, s_tickShift);
+    if (n == 0)
+    {
+      // 자리가 없으면 먼저 보낸다.
+      sendPending();
+    }
+  }
+  if (s_batchEvents == 0)
+  {
+    s_batchFormat = BLE_FORMAT_V2;
+    s_batchFirstSeq = seq;
+    s_batchStartMs = millis();
+    s_v2Len = sizeof(S_Ble_V2_Header);
+    n = packetV2::encodeEvent(s_v2 + s_v2Len, end, pDurationTickList, numChannels, mask, s_tickShift);
+    if (n == 0)
+    {
+      // MTU 가 이벤트 하나보다 작음 : 잘려서 나간다. (v1 과 같다)
+      n = packetV2::encodeEvent(s_v2 + s_v2Len, s_v2 + sizeof(s_v2), pDurationTickList, numChannels, mask, s_tickShift);
+    }
+  }
+  s_v2Len += n;
+  s_batchEvents++;
+}
+
+// 시차데이터 전송 (TX 태스크)
+static void txTD(const uint32_t *pDurationTickList, int numChannels, uint32_t seq)
+{
+  if (deviceConnected) // BLE 연결 확인
+  {
+    if (numChannels > CAPTURE_CHANNELS)
+    {
+      numChannels = CAPTURE_CHANNELS;
+    }
+
+    // 묶음 안의 seq 는 연속이어야 한다. (슬롯이 버려져 건너뛰었으면 먼저 보낸다)
+    uint8_t format = s_format;
+    if (s_batchEvents > 0 && (s_batchFormat != format || seq != s_batchFirstSeq + s_batchEvents))
+    {
+      sendPending();
+    }
+
+    if (format == BLE_FORMAT_V2)
+    {
+      queueV2(pDurationTickList, numChannels, seq);
+      int fill = (s_batchFill > 0 && s_batchFill < 255) ? (int)s_batchFill : 255;
+      if (s_batchDeadlineMs == 0 || s_batchEvents >= fill)
+      {
+        sendPending();
+      }
+      return;
+    }
+
+    if (s_batchDeadlineMs == 0)
+    {
+      sendSingle(pDurationTickList, numChannels, 0);
+      return;
+    }
+
+    // 채널 수가 바뀌었거나 (MTU 가 줄어) 자리가 없으면 먼저 보낸다.
+    int capacity = batchCapacity(numChannels);
+    if (s_batchEvents > 0 && (s_batchChannels != numChannels || s_batchEvents >= capacity))
+    {
+      sendPending();
+    }
+
+    if (s_batchEvents == 0)
+    {
+      s_batchFormat = BLE_FORMAT_V1;
+      s_batchFirstSeq = seq;
+      s_batchChannels = numChannels;
+      s_batchStartMs = millis();
+    }
+    memcpy(&s_batch.data[s_batchEvents * numChannels], pDurationTickList, sizeof(uint32_t) * numChannels);
+    s_batchEvents++;
+
+    int fill = (s_batchFill > 0 && (int)s_batchFill < capacity) ? (int)s_batchFill : capacity;
+    if (s_batchEvents >= fill)
+    {
+      sendPending();
+    }
+    return;
+  }
+  s_batchEvents = 0;
+}
+
+// 보낸 이벤트 수, 바이트 수로 bench 한 항목을 채운다.
+static void benchEntry(S_Ble_Bench::Entry &entry, uint32_t us, uint32_t events, uint32_t bytes)
+{
+  entry.eps = us > 0 ? (uint32_t)((uint64_t)events * 1000000 / us) : 0;
+  entry.bytesPerEvent = events > 0 ? (float)bytes / events : 0;
+}
 
-class MyCharateristicCallbacks : public BLECharacteristicCallbacks
+// 전송 방식 비교 (TX 태스크, ble_bench 가 TX_BENCH 슬롯으로 넘긴다)
+// notify 는 TX 태스크만 부르므로 측정 중 다른 전송이 끼지 않고, bytes 차이는 bench 패킷만 센다.
+static void txBench(int events, int numChannels, S_Ble_Bench &result)
 {
-  void onWrite(BLECharacteristic *pCharacteristic)
+  // 1m 배열 정도의 시차 (ns)
+  uint32_t ticks[CAPTURE_CHANNELS];
+  for (int ch = 0; ch < numChannels; ch++)
   {
-    Serial.println("Characteristic write event");
+    ticks[ch] = (ch * 350000) % 2900000;
+  }
+
+  uint32_t bytes = s_stats.bytes;
+  uint32_t start = micros();
+  for (int i = 0; i < events; i++)
+  {
+    sendSingle(ticks, numChannels, 1);
+  }
+  benchEntry(result.single, micros() - start, events, s_stats.bytes - bytes);
+
+  S_Ble_Packet_Batch batch;
+  int capacity = batchCapacity(numChannels);
+  bytes = s_stats.bytes;
+  start = micros();
+  for (int sent = 0; sent < events;)
+  {
+    int n = events - sent < capacity ? events - sent : capacity;
+    for (int i = 0; i < n; i++)
+    {
+      memcpy(&batch.data[i * numChannels], ticks, sizeof(uint32_t) * numChannels);
+    }
+    sendBatch(batch, numChannels, n, 1, 0);
+    sent += n;
+  }
+  benchEntry(result.batch, micros() - start, events, s_stats.bytes - bytes);
 
+  uint8_t v2[sizeof(s_v2)];
+  const uint8_t *end = v2End(v2, sizeof(v2));
+  uint32_t mask = dataCapture::channelMask(numChannels);
+  bytes = s_stats.bytes;
+  start = micros();
+  for (int sent = 0; sent < events;)
+  {
+    int length = sizeof(S_Ble_V2_Header);
+    int n = 0;
+    while (sent + n < events && n < 255)
+    {
+      int w = packetV2::encodeEvent(v2 + length, end, ticks, numChannels, mask, s_tickShift);
+      if (w == 0)
+      {
+        break;
+      }
+      length += w;
+      n++;
+    }
+    if (n == 0)
     {
-      // binary mode
+      // MTU 가 이벤트 하나보다 작음
+      length += packetV2::encodeEvent(v2 + length, v2 + sizeof(v2), ticks, numChannels, mask, s_tickShift);
+      n = 1;
+    }
+    sendV2(v2, length, n, 1, 0);
+    sent += n;
+  }
+  benchEntry(result.v2, micros() - start, events, s_stats.bytes - bytes);
+}
+
+// 위치 전송 (TX 태스크)
+static void txPos(const tdoaSolver::Fix &fix, uint32_t mask)
+{
+  if (deviceConnected)
+  {
+    S_Ble_Packet_Position sendData;
+    sendData.header.checkCode = CHECK_CODE;
+    sendData.header.cmd = 0x0A;
+    sendData.header.parm[0] = fix.dim;
+    sendData.header.parm[1] = fix.used;
+    sendData.header.parm[2] = fix.iterations;
+
+    sendData.pos[0] = fix.pos[0];
+    sendData.pos[1] = fix.pos[1];
+    sendData.pos[2] = fix.pos[2];
+    sendData.residual = fix.residual;
+    sendData.mask = mask;
 
-      std::string value = pCharacteristic->getValue();
+    bleStack::notify((uint8_t *)&sendData, sizeof(sendData));
+  }
+}
 
-      if (value.length() >= sizeof(S_Ble_Header_Packet))
+//------------------------------------------------ history / resume
+// 기록 링에서 seq 항목을 꺼낸다. 덮어써졌으면 false
+static bool historyRead(uint32_t seq, uint32_t *ticks)
+{
+  bool ok = false;
+  portENTER_CRITICAL(&s_historyMux);
+  if (s_history != NULL)
+  {
+    const uint32_t *entry = s_history + (seq % s_historySize) * (1 + s_historyChannels);
+    if (entry[0] == seq && seq < s_nextSeq)
+    {
+      memcpy(ticks, entry + 1, sizeof(uint32_t) * s_historyChannels);
+      ok = true;
+    }
+  }
+  portEXIT_CRITICAL(&s_historyMux);
+  return ok;
+}
+
+// 남아 있는 가장 오래된 seq, 다음 seq
+static void historyRange(uint32_t &oldest, uint32_t &next)
+{
+  portENTER_CRITICAL(&s_historyMux);
+  next = s_nextSeq;
+  oldest = next > s_historySize ? next - s_historySize : 0;
+  portEXIT_CRITICAL(&s_historyMux);
+}
+
+// 재전송 요청 (TX 태스크) : 범위를 기록 링에 맞추고 응답한 뒤 재전송을 시작한다.
+static void txResume(uint32_t from, uint32_t to)
+{
+  uint32_t oldest, next;
+  historyRange(oldest, next);
+  if (to == 0 || to > next)
+  {
+    to = next;
+  }
+
+  uint8_t status = BLE_RESUME_OK;
+  if (s_history == NULL)
+  {
+    status = BLE_RESUME_NONE;
+    from = to;
+  }
+  else if (from < oldest)
+  {
+    // 링보다 오래된 부분은 잃었다.
+    status = BLE_RESUME_PARTIAL;
+    statsAdd(s_stats.historyLost, oldest - from);
+    from = oldest;
+  }
+  if (from > to)
+  {
+    from = to;
+  }
+
+  S_Ble_Packet_Resume resPacket;
+  resPacket.header.checkCode = CHECK_CODE;
+  resPacket.header.cmd = 0x04;
+  resPacket.header.parm[0] = status;
+  resPacket.header.parm[1] = 0;
+  resPacket.header.parm[2] = 0;
+  resPacket.fromSeq = from;
+  resPacket.toSeq = to;
+  bleStack::notify((uint8_t *)&resPacket, sizeof(resPacket));
+  DLOG_I(BLE, "Res resume command : %u ~ %u", from, to);
+
+  s_replayNext = from;
+  s_replayEnd = to;
+  s_replaying = from < to;
+  s_replayAtMs = millis();
+}
+
+// 재전송 패킷 하나 : 지금 형식으로 s_replayNext 부터 연속된 이벤트를 MTU 까지 담는다.
+// 스택이 거절하면 (버퍼 가득) BLE_REPLAY_BACKOFF_MS 뒤 같은 패킷을 다시 만든다.
+static void replayStep()
+{
+  if (!s_replaying || (int32_t)(millis() - s_replayAtMs) < 0)
+  {
+    return;
+  }
+  if (!deviceConnected)
+  {
+    s_replaying = false;
+    return;
+  }
+
+  int numChannels = s_historyChannels;
+  uint32_t ticks[CAPTURE_CHANNELS];
+  int events = 0;
+  bool ok;
+
+  if (s_format == BLE_FORMAT_V2)
+  {
+    const uint8_t *end = v2End(s_replayV2, sizeof(s_replayV2));
+    int length = sizeof(S_Ble_V2_Header);
+    while (s_replayNext + events < s_replayEnd && events < 255 && historyRead(s_replayNext + events, ticks))
+    {
+      uint32_t mask = 0;
+      for (int ch = 0; ch < numChannels; ch++)
       {
-        S_Ble_Header_Packet *packet = (S_Ble_Header_Packet *)value.data();
+        if (ticks[ch] != TICK_MISSING)
+        {
+          mask |= 1UL << ch;
+        }
+      }
+      int w = packetV2::encodeEvent(s_replayV2 + length, events == 0 ? s_replayV2 + sizeof(s_replayV2) : end, ticks, numChannels, mask, s_tickShift);
+      if (w == 0)
+      {
+        break;
+      }
+      length += w;
+      events++;
+    }
+    ok = events == 0 || sendV2(s_replayV2, length, events, BLE_TD_FLAG_REPLAY, s_replayNext);
+  }
+  else
+  {
+    int capacity = batchCapacity(numChannels);
+    while (s_replayNext + events < s_replayEnd && events < capacity &&
+           historyRead(s_replayNext + events, &s_replayBatch.data[events * numChannels]))
+    {
+      events++;
+    }
+    ok = events == 0 || sendBatch(s_replayBatch, numChannels, events, BLE_TD_FLAG_REPLAY, s_replayNext);
+  }
+
+  if (events == 0)
+  {
+    // 재전송 중에 덮어써졌다 : 남아 있는 곳부터
+    uint32_t oldest, next;
+    historyRange(oldest, next);
+    if (oldest > s_replayNext)
+    {
+      statsAdd(s_stats.historyLost, (oldest < s_replayEnd ? oldest : s_replayEnd) - s_replayNext);
+      s_replayNext = oldest;
+    }
+    else
+    {
+      s_replayNext = s_replayEnd;
+    }
+  }
+  else if (ok)
+  {
+    s_replayNext += events;
+    statsAdd(s_stats.replayed, events);
+    s_replayAtMs = millis() + 1; // 다음 틱에 (idle 태스크가 돌 틈)
+  }
+  else
+  {
+    s_replayAtMs = millis() + BLE_REPLAY_BACKOFF_MS;
+  }
+  s_replaying = s_replayNext < s_replayEnd;
+}
+
+static TickType_t replayWaitTicks()
+{
+  if (!s_replaying)
+  {
+    return portMAX_DELAY;
+  }
+  int32_t remain = (int32_t)(s_replayAtMs - millis());
+  return remain <= 0 ? 0 : pdMS_TO_TICKS(remain) + 1;
+}
+
+//------------------------------------------------ broadcast
+// 이벤트 하나를 최근 이벤트 링에 인코딩 (legacy 는 한 광고에 들어가도록 tick 단위를 키운다)
+static void bcastEncode(const uint32_t *ticks, int numChannels, uint32_t mask, uint32_t seq, uint64_t timeNs)
+{
+  s_bcastNewest = (s_bcastNewest + 1) % BLE_BCAST_DEPTH;
+  if (s_bcastCount < BLE_BCAST_DEPTH)
+  {
+    s_bcastCount++;
+  }
+  BcastEvent &ev = s_bcastEvents[s_bcastNewest];
+  ev.header.seq = (uint16_t)seq;
+  ev.header.timeUs = (uint32_t)(timeNs / 1000);
+
+  size_t room = bleStack::broadcastCapacity() - sizeof(S_Ble_Bcast_Header) - sizeof(S_Ble_Bcast_Event);
+  if (room > sizeof(ev.data))
+  {
+    room = sizeof(ev.data);
+  }
+  int n = 0;
+  uint8_t shift = s_tickShift;
+  while ((n = packetV2::encodeEvent(ev.data, ev.data + room, ticks, numChannels, mask, shift)) == 0 && shift < 16)
+  {
+    shift++;
+  }
+  ev.shift = shift;
+  ev.length = n;
+}
+
+// legacy 광고 : 최근에서 index 번째 이벤트 하나, extended : 자리가 되는 만큼 최근 이벤트부터
+static void bcastPublish(int index)
+{
+  uint8_t payload[BLE_BCAST_EXT_MAX];
+  size_t capacity = bleStack::broadcastCapacity();
+  if (capacity > sizeof(payload))
+  {
+    capacity = sizeof(payload);
+  }
+  bool legacy = capacity <= BLE_BCAST_LEGACY_MAX;
+
+  S_Ble_Bcast_Header *header = (S_Ble_Bcast_Header *)payload;
+  header->company = BLE_BCAST_COMPANY;
+  header->format = BLE_BCAST_FORMAT;
+  header->count = 0;
+  size_t length = sizeof(S_Ble_Bcast_Header);
+
+  for (int i = legacy ? index : 0; i < s_bcastCount; i++)
+  {
+    const BcastEvent &ev = s_bcastEvents[(s_bcastNewest - i + BLE_BCAST_DEPTH) % BLE_BCAST_DEPTH];
+    // 한 광고 안의 이벤트는 tick 단위가 같아야 한다.
+    if (ev.length == 0 || (header->count > 0 && ev.shift != header->tickShift) ||
+        length + sizeof(S_Ble_Bcast_Event) + ev.length > capacity)
+    {
+      break;
+    }
+    header->tickShift = ev.shift;
+    memcpy(payload + length, &ev.header, sizeof(S_Ble_Bcast_Event));
+    length += sizeof(S_Ble_Bcast_Event);
+    memcpy(payload + length, ev.data, ev.length);
+    length += ev.length;
+    header->count++;
+    if (legacy)
+    {
+      break;
+    }
+  }
+  if (header->count > 0)
+  {
+    bleStack::setBroadcast(payload, length);
+  }
+  s_bcastShown = index;
+  s_bcastShowMs = millis();
+}
 
-        if (packet->checkCode == CHECK_CODE)
+// legacy 광고 : 최근 이벤트가 BLE_BCAST_HOLD_MS 안이면 최근 이벤트들을 돌려가며 광고한다.
+// (스캐너가 광고 하나를 놓쳐도 다음 차례에 받는다, seq 로 중복 제거)
+static bool bcastRotating()
+{
+  return s_bcast && s_bcastCount > 1 && bleStack::broadcastCapacity() <= BLE_BCAST_LEGACY_MAX &&
+         millis() - s_bcastNewMs < BLE_BCAST_HOLD_MS;
+}
+
+static TickType_t bcastWaitTicks()
+{
+  if (!bcastRotating())
+  {
+    return portMAX_DELAY;
+  }
+  uint32_t elapsed = millis() - s_bcastShowMs;
+  return elapsed >= BLE_BCAST_ROTATE_MS ? 0 : pdMS_TO_TICKS(BLE_BCAST_ROTATE_MS - elapsed) + 1;
+}
+
+static void bcastRotate()
+{
+  if (bcastRotating() && millis() - s_bcastShowMs >= BLE_BCAST_ROTATE_MS)
+  {
+    bcastPublish((s_bcastShown + 1) % s_bcastCount);
+  }
+}
+
+static void txBcast(const TxSlot &slot)
+{
+  bcastEncode(slot.ticks, slot.channels, slot.mask, slot.seq, slot.timeNs);
+  s_bcastNewMs = millis();
+  bcastPublish(0);
+}
+
+//------------------------------------------------ tx task
+// 캡처 태스크(dataLoop)는 미리 잡아 둔 슬롯에 결과를 적고 슬롯 번호만 큐로 넘긴다.
+// BLE 스택(notify, 묶음, 인코딩)은 코어 0 의 TX 태스크만 만지므로
+// 스택이 막혀도 캡처 쪽 재무장 시간이 늘어나지 않는다.
+// 앞 BLE_TX_SLOTS 개는 캡처 결과 (TD, POS, BCAST), 뒤 BLE_TX_REPLY_SLOTS 개는 명령 응답 전용
+#define BLE_TX_ALL_SLOTS (BLE_TX_SLOTS + BLE_TX_REPLY_SLOTS)
+static TxSlot s_txSlots[BLE_TX_ALL_SLOTS];
+// 제어 응답 본문은 MTU 까지라 응답 슬롯에만 따로 둔다.
+static uint8_t s_ctlOut[BLE_TX_REPLY_SLOTS][BLE_LOCAL_MTU - 3];
+static QueueHandle_t s_txFree = NULL;      // 빈 결과 슬롯 번호
+static QueueHandle_t s_txReplyFree = NULL; // 빈 응답 슬롯 번호
+static QueueHandle_t s_txReady = NULL;     // 보낼 슬롯 번호 (오래된 순, 결과 + 응답)
+static TaskHandle_t s_txTask = NULL;
+
+// bench ble : 앱 태스크가 요청하고 TX 태스크가 결과를 채운 뒤 알린다.
+static SemaphoreHandle_t s_benchDone = NULL;
+static S_Ble_Bench s_benchResult;
+
+static void txTask(void *param)
+{
+  while (true)
+  {
+    uint8_t index;
+    // 묶음이 대기 중이면 그 기한까지만, 광고를 돌리는 중이면 다음 차례까지만 기다린다.
+    // 재전송 중이면 실시간 이벤트 사이사이에 보낸다.
+    TickType_t wait = flushWaitTicks();
+    TickType_t rotate = bcastWaitTicks();
+    TickType_t replay = replayWaitTicks();
+    wait = rotate < wait ? rotate : wait;
+    wait = replay < wait ? replay : wait;
+    if (xQueueReceive(s_txReady, &index, wait) == pdTRUE)
+    {
+      TxSlot &slot = s_txSlots[index];
+      if (slot.kind == TX_POS)
+      {
+        txPos(slot.fix, slot.mask);
+      }
+      else if (slot.kind == TX_RAW)
+      {
+        if (deviceConnected)
         {
-          switch (packet->cmd)
-          {
-          case 0x01: // about
-          {
-            S_Ble_Packet_About resPacket;
-            resPacket.header.checkCode = CHECK_CODE;
-            resPacket.header.cmd = 0x01;
-            resPacket.chipId = ESP.getEfuseMac();
-            resPacket.version[0] = g_version[0];
-            resPacket.version[1] = g_version[1];
-            resPacket.version[2] = g_version[2];
-            // resPacket.chennelNum = NUM_CHANNELS;
-            // resPacket.sampleRate = sample_rate;
-
-            Serial.println("Res About command");
-            pCharacteristic->setValue((uint8_t *)&resPacket, sizeof(resPacket));
-
-            pCharacteristic->notify(); // 즉시전송 (notify)
-          }
-          break;
-
-          default:
-            Serial.println("Unknown command");
-            break;
-          }
+          bleStack::notify(slot.raw, slot.channels);
         }
-        else
+      }
+      else if (slot.kind == TX_CONTROL)
+      {
+        if (deviceConnected)
         {
-          Serial.println("Invalid check code");
+          bleStack::notifyControl(s_ctlOut[index - BLE_TX_SLOTS], slot.mask);
         }
       }
+      else if (slot.kind == TX_BCAST)
+      {
+        txBcast(slot);
+      }
+      else if (slot.kind == TX_RESUME)
+      {
+        txResume(slot.seq, slot.mask);
+      }
+      else if (slot.kind == TX_BENCH)
+      {
+        txBench(slot.seq, slot.channels, s_benchResult);
+        xSemaphoreGive(s_benchDone);
+      }
       else
       {
-        Serial.println("Received value too short");
+        txTD(slot.ticks, slot.channels, slot.seq);
       }
+      xQueueSend(index < BLE_TX_SLOTS ? s_txFree : s_txReplyFree, &index, 0);
     }
+    // 기한이 지난 묶음 전송
+    flushTD(false);
+    bcastRotate();
+    replayStep();
   }
-};
+}
+
+static void txCountDropped()
+{
+  portENTER_CRITICAL(&s_statsMux);
+  s_stats.txDropped++;
+  portEXIT_CRITICAL(&s_statsMux);
+}
 
-class MyServerCallbacks : public BLEServerCallbacks
+// 결과 슬롯을 하나 얻는다. 없으면 가장 오래된 대기 결과를 버리고 쓴다. (TX 태스크가 아직 꺼내지 않은 것)
+// 가장 오래된 대기 슬롯이 응답이면 버리지 않고 앞에 되돌려 놓고 새 결과를 버린다.
+static TxSlot *txAcquire(uint8_t &index)
 {
-  void onConnect(BLEServer *pServer)
+  if (s_txFree == NULL)
+  {
+    return NULL;
+  }
+  if (xQueueReceive(s_txFree, &index, 0) == pdTRUE)
   {
-    
-    deviceConnected = true;
+    return &s_txSlots[index];
+  }
 
-    Serial.println("Client connected");
-    pServer->getAdvertising()->stop(); // 클라이언트가 연결되면 광고 중지
+  txCountDropped();
+  if (xQueueReceive(s_txReady, &index, 0) != pdTRUE)
+  {
+    // TX 태스크가 모든 슬롯을 처리 중
+    return NULL;
+  }
+  if (index >= BLE_TX_SLOTS)
+  {
+    xQueueSendToFront(s_txReady, &index, 0);
+    return NULL;
+  }
+  return &s_txSlots[index];
+}
 
-    stopBlink();
-  };
+// 응답 슬롯을 하나 얻는다. 대기 중인 결과를 밀어내지 않고, wait 동안 응답 슬롯이 모두 차 있으면 NULL
+static TxSlot *txAcquireReply(uint8_t &index, TickType_t wait = 0)
+{
+  if (s_txReplyFree == NULL)
+  {
+    return NULL;
+  }
+  if (xQueueReceive(s_txReplyFree, &index, wait) != pdTRUE)
+  {
+    txCountDropped();
+    return NULL;
+  }
+  return &s_txSlots[index];
+}
 
-  void onDisconnect(BLEServer *pServer)
+static void txSubmit(uint8_t index)
+{
+  xQueueSend(s_txReady, &index, 0);
+
+  uint32_t pending = uxQueueMessagesWaiting(s_txReady);
+  portENTER_CRITICAL(&s_statsMux);
+  s_stats.txQueued++;
+  if (pending > s_stats.txHighWater)
   {
-    deviceConnected = false;
+    s_stats.txHighWater = pending;
+  }
+  portEXIT_CRITICAL(&s_statsMux);
+}
 
-    Serial.println("Client disconnected");
-    pServer->getAdvertising()->start(); // 클라이언트가 연결 해제되면 광고 다시 시작
+// 전송 방식 비교 (bench ble), 클라이언트는 bench 표시 패킷을 무시한다.
+// TX 태스크에서 돌리고 끝날 때까지 (최대 BLE_BENCH_TIMEOUT_MS) 기다린다.
+boolean ble_bench(int events, int numChannels, S_Ble_Bench &result)
+{
+  if (!deviceConnected || events <= 0 || s_benchDone == NULL)
+  {
+    return false;
+  }
+  if (numChannels < 1)
+  {
+    numChannels = 1;
+  }
+  if (numChannels > CAPTURE_CHANNELS)
+  {
+    numChannels = CAPTURE_CHANNELS;
+  }
 
-    startBlink();
+  uint8_t index;
+  TxSlot *slot = txAcquireReply(index);
+  if (slot == NULL)
+  {
+    return false;
   }
+  // 앞 bench 가 시간을 넘겨 늦게 끝났으면 남은 알림을 버린다.
+  xSemaphoreTake(s_benchDone, 0);
+  slot->kind = TX_BENCH;
+  slot->seq = events;
+  slot->channels = numChannels;
+  txSubmit(index);
 
-  // void onMtuChanged(BLEServer* pServer,uint16_t mtu) {
-  //   Serial.print("MTU size updated: ");
-  //   Serial.println(mtu);
-  // }
-};
+  if (xSemaphoreTake(s_benchDone, pdMS_TO_TICKS(BLE_BENCH_TIMEOUT_MS)) != pdTRUE)
+  {
+    return false;
+  }
+  result = s_benchResult;
+  return true;
+}
 
-//------------------------------------------------ ble end
-// 시차데이터 전송
-boolean ble_sendTD(int* pDurationTickList, int numChannels)
+// 이벤트에 seq 를 매기고 기록 링에 넣는다. (연결과 상관없이, dataLoop 에서만)
+uint32_t ble_recordTD(const uint32_t *pDurationTickList, int numChannels)
 {
-  if (deviceConnected) // BLE 연결 확인
+  uint32_t seq = s_nextSeq;
+  portENTER_CRITICAL(&s_historyMux);
+  if (s_history != NULL)
   {
-    S_Ble_Packet_Data sendData;
-    sendData.header.checkCode = CHECK_CODE;
-    sendData.header.cmd = 0x09; // 0x09 명령어
-    sendData.header.parm[0] = 0;
-    sendData.header.parm[1] = 0;
-    sendData.header.parm[2] = 0;
-
-    // (2) 채널별 데이터 복사 (최대 8개)
-    for (int ch = 0; ch < 8; ch++)
+    uint32_t *entry = s_history + (seq % s_historySize) * (1 + s_historyChannels);
+    entry[0] = seq;
+    for (int ch = 0; ch < s_historyChannels; ch++)
     {
-      if (ch < numChannels)
-        sendData.data[ch] = pDurationTickList[ch];  // 센서 데이터 채우기
-      else
-        sendData.data[ch] = 0; // 초과 채널은 0으로
+      entry[1 + ch] = ch < numChannels ? pDurationTickList[ch] : TICK_MISSING;
     }
+  }
+  s_nextSeq = seq + 1;
+  portEXIT_CRITICAL(&s_historyMux);
+  return seq;
+}
+
+void ble_setHistory(uint32_t events, int numChannels)
+{
+  if (events == 0 || numChannels < 1)
+  {
+    return;
+  }
+  if (numChannels > CAPTURE_CHANNELS)
+  {
+    numChannels = CAPTURE_CHANNELS;
+  }
+  size_t bytes = sizeof(uint32_t) * (1 + numChannels) * events;
+  uint32_t *history = (uint32_t *)malloc(bytes);
+  if (history == NULL)
+  {
+    DLOG_E(BLE, "Ble history : %u events (%u bytes) alloc failed", events, (unsigned)bytes);
+    return;
+  }
+  // seq 0 항목과 헷갈리지 않도록 비어 있는 항목은 seq 를 맞지 않게
+  for (uint32_t i = 0; i < events; i++)
+  {
+    history[i * (1 + numChannels)] = i + 1;
+  }
+  portENTER_CRITICAL(&s_historyMux);
+  s_history = history;
+  s_historySize = events;
+  s_historyChannels = numChannels;
+  portEXIT_CRITICAL(&s_historyMux);
+  DLOG_I(BLE, "Ble history : %u events (%u bytes)", events, (unsigned)bytes);
+}
 
-    // (3) BLECharacteristic에 값 설정 + notify
-    pCharacteristic->setValue((uint8_t *)&sendData, sizeof(sendData));
-    pCharacteristic->notify();
+// 시차데이터 전송 : 슬롯에 적고 TX 태스크로 넘긴다. (BLE 스택을 만지지 않는다)
+boolean ble_sendTD(uint32_t seq, const uint32_t *pDurationTickList, int numChannels)
+{
+  if (!deviceConnected)
+  {
+    return false;
+  }
+  uint8_t index;
+  TxSlot *slot = txAcquire(index);
+  if (slot == NULL)
+  {
+    return false;
+  }
+  if (numChannels > CAPTURE_CHANNELS)
+  {
+    numChannels = CAPTURE_CHANNELS;
+  }
+  slot->kind = TX_TD;
+  slot->seq = seq;
+  slot->channels = numChannels;
+  memcpy(slot->ticks, pDurationTickList, sizeof(uint32_t) * numChannels);
+  txSubmit(index);
+  return true;
+}
 
-    return true;
+// 브로드캐스트 : 연결과 상관없이 광고로 내보낸다. (ble_broadcast 1 일 때)
+boolean ble_broadcastTD(uint32_t seq, const uint32_t *pDurationTickList, int numChannels, uint32_t mask, uint64_t timeNs)
+{
+  if (!s_bcast)
+  {
+    return false;
   }
-  return false;
+  uint8_t index;
+  TxSlot *slot = txAcquire(index);
+  if (slot == NULL)
+  {
+    return false;
+  }
+  if (numChannels > CAPTURE_CHANNELS)
+  {
+    numChannels = CAPTURE_CHANNELS;
+  }
+  slot->kind = TX_BCAST;
+  slot->seq = seq;
+  slot->channels = numChannels;
+  slot->mask = mask;
+  slot->timeNs = timeNs;
+  memcpy(slot->ticks, pDurationTickList, sizeof(uint32_t) * numChannels);
+  txSubmit(index);
+  return true;
 }
 
+void ble_setBroadcast(bool enable)
+{
+  s_bcast = enable;
+  if (enable)
+  {
+    // 빈 묶음으로 광고 모드를 먼저 바꿔 둔다. (첫 이벤트 전에 연결되어도 광고가 계속되도록, setup 중이라 TX 태스크와 겹치지 않는다)
+    S_Ble_Bcast_Header header = {BLE_BCAST_COMPANY, BLE_BCAST_FORMAT, s_tickShift, 0};
+    bleStack::setBroadcast((const uint8_t *)&header, sizeof(header));
 
-void ble_setup(String strDeviceName)
+    DLOG_I(BLE, "Ble broadcast : %s advertising, %u bytes",
+                  bleStack::broadcastCapacity() > BLE_BCAST_LEGACY_MAX ? "extended" : "legacy", (unsigned)bleStack::broadcastCapacity());
+  }
+}
+
+// 위치 전송 : 슬롯에 적고 TX 태스크로 넘긴다.
+boolean ble_sendPos(const tdoaSolver::Fix &fix, uint32_t mask)
 {
-  // // print device name and info
-  /////////////////////////////////////////////////////////
-  // ble setup ---------------------------------------------
-  //  Create the BLE Device
-  BLEDevice::init(strDeviceName.c_str());
+  if (!deviceConnected)
+  {
+    return false;
+  }
+  uint8_t index;
+  TxSlot *slot = txAcquire(index);
+  if (slot == NULL)
+  {
+    return false;
+  }
+  slot->kind = TX_POS;
+  slot->fix = fix;
+  slot->mask = mask;
+  txSubmit(index);
+  return true;
+}
+
+const char *ble_stackName()
+{
+  return bleStack::name;
+}
+
+void ble_getStats(S_Ble_Stats &stats)
+{
+  portENTER_CRITICAL(&s_statsMux);
+  stats = s_stats;
+  portEXIT_CRITICAL(&s_statsMux);
+  stats.mtu = s_mtu;
+}
 
-  // Create the BLE Server
-  pServer = BLEDevice::createServer();
-  pServer->setCallbacks(new MyServerCallbacks());
 
-  // Create the BLE Service
-  BLEService *pService = pServer->createService(SERVICE_UUID);
+//------------------------------------------------ stack events
+// 명령 응답도 TX 태스크가 보낸다. (notify 는 한 태스크에서만)
+static void txReply(const void *data, size_t length)
+{
+  if (length > BLE_TX_RAW_MAX)
+  {
+    return;
+  }
+  uint8_t index;
+  TxSlot *slot = txAcquireReply(index);
+  if (slot == NULL)
+  {
+    return;
+  }
+  slot->kind = TX_RAW;
+  slot->channels = length;
+  memcpy(slot->raw, data, length);
+  txSubmit(index);
+}
 
-  // Create a BLE Characteristic
-  pCharacteristic = pService->createCharacteristic(
-      CHARACTERISTIC_UUID,
-      BLECharacteristic::PROPERTY_READ |
-          BLECharacteristic::PROPERTY_WRITE |
-          BLECharacteristic::PROPERTY_NOTIFY |
-          BLECharacteristic::PROPERTY_INDICATE);
+void ble_onWrite(const uint8_t *data, size_t length)
+{
+  DLOG_D(BLE, "Characteristic write event");
 
-  pCharacteristic->addDescriptor(new BLE2902()); // 알람 표시 기능활성화
-  pCharacteristic->setCallbacks(new MyCharateristicCallbacks());
+  // binary mode
+  if (length < sizeof(S_Ble_Header_Packet))
+  {
+    DLOG_W(BLE, "Received value too short");
+    return;
+  }
 
-  // Start the service
-  pService->start();
+  const S_Ble_Header_Packet *packet = (const S_Ble_Header_Packet *)data;
+  if (packet->checkCode != CHECK_CODE)
+  {
+    DLOG_W(BLE, "Invalid check code");
+    return;
+  }
 
-  // Start advertising
-  pServer->getAdvertising()->start();
-  // Serial.printf("Waiting a client connection to notify...%s \n", getChipID().c_str());
+  switch (packet->cmd)
+  {
+  case 0x01: // about
+  {
+    S_Ble_Packet_About resPacket;
+    resPacket.header.checkCode = CHECK_CODE;
+    resPacket.header.cmd = 0x01;
+    resPacket.header.parm[0] = BLE_FORMAT_V1 | BLE_FORMAT_V2; // 지원 형식
+    resPacket.header.parm[1] = 0;
+    resPacket.header.parm[2] = 0;
+    resPacket.chipId = ESP.getEfuseMac();
+    resPacket.version[0] = g_version[0];
+    resPacket.version[1] = g_version[1];
+    resPacket.version[2] = g_version[2];
+    resPacket.chennelNum = dataCapture::channels_num;
+    resPacket.sampleRate = 1000000000; // 시차 데이터 단위 : 1ns (ticks/sec)
 
-  Serial.println("Ble Ready , Device name: " + strDeviceName);
-}
\ No newline at end of file
+    DLOG_I(BLE, "Res About command");
+    txReply(&resPacket, sizeof(resPacket));
+  }
+  break;
+
+  case 0x02: // 시차 패킷 형식 선택 (parm[0] : BLE_FORMAT_*)
+  {
+    s_format = packet->parm[0] == BLE_FORMAT_V2 ? BLE_FORMAT_V2 : BLE_FORMAT_V1;
+
+    S_Ble_Header_Packet resPacket;
+    resPacket.checkCode = CHECK_CODE;
+    resPacket.cmd = 0x02;
+    resPacket.parm[0] = s_format;
+    resPacket.parm[1] = s_tickShift;
+    resPacket.parm[2] = 0;
+
+    DLOG_I(BLE, "Res format command : v%d", s_format == BLE_FORMAT_V2 ? 2 : 1);
+    txReply(&resPacket, sizeof(resPacket));
+  }
+  break;
+
+  case 0x03: // ping : 받은 패킷을 그대로 돌려준다. (클라이언트가 write -> notify 왕복 시간을 잰다)
+  {
+    S_Ble_Packet_Ping resPacket = {};
+    memcpy(&resPacket, data, length < sizeof(resPacket) ? length : sizeof(resPacket));
+    txReply(&resPacket, sizeof(resPacket));
+  }
+  break;
+
+  case 0x04: // resume : fromSeq 부터 toSeq 전까지 (0 이면 지금까지) 기록 링에서 다시 보낸다.
+  {
+    if (length < sizeof(S_Ble_Packet_Resume))
+    {
+      DLOG_W(BLE, "Received value too short");
+      break;
+    }
+    const S_Ble_Packet_Resume *request = (const S_Ble_Packet_Resume *)data;
+    uint8_t index;
+    TxSlot *slot = txAcquireReply(index);
+    if (slot != NULL)
+    {
+      slot->kind = TX_RESUME;
+      slot->seq = request->fromSeq;
+      slot->mask = request->toSeq;
+      txSubmit(index);
+    }
+  }
+  break;
+
+  default:
+    DLOG_W(BLE, "Unknown command");
+    break;
+  }
+}
+
+void ble_onControl(const uint8_t *data, size_t length)
+{
+  bleControl::receive(data, length);
+}
+
+boolean ble_sendControl(const uint8_t *data, size_t length, uint32_t waitMs)
+{
+  if (!deviceConnected || length == 0)
+  {
+    return false;
+  }
+  uint16_t mtu = s_mtu;
+  size_t limit = mtu > 3 ? mtu - 3 : 0;
+  if (length > limit)
+  {
+    length = limit;
+  }
+
+  // 앞 응답이 나가 슬롯이 빌 때까지는 큐에서 막혀 기다린다. (이어지는 응답 패킷을 버리지 않도록)
+  uint8_t index;
+  TxSlot *slot = txAcquireReply(index, pdMS_TO_TICKS(waitMs));
+  if (slot == NULL)
+  {
+    return false;
+  }
+  memcpy(s_ctlOut[index - BLE_TX_SLOTS], data, length);
+  slot->kind = TX_CONTROL;
+  slot->mask = length;
+  txSubmit(index);
+  return true;
+}
+
+uint16_t ble_mtu()
+{
+  return s_mtu;
+}
+
+void ble_onConnect()
+{
+  deviceConnected = true;
+  DLOG_I(BLE, "Client connected");
+  stopBlink();
+}
+
+void ble_onDisconnect()
+{
+  deviceConnected = false;
+  s_mtu = 23;
+  s_format = BLE_FORMAT_V1;
+  DLOG_I(BLE, "Client disconnected");
+  startBlink();
+}
+
+void ble_onMtu(uint16_t mtu)
+{
+  s_mtu = mtu;
+  DLOG_I(BLE, "MTU size updated: %d", mtu);
+}
+
+void ble_setup(String strDeviceName)
+{
+  // TX 슬롯 큐와 TX 태스크 (코어 0, BLE 스택과 같은 코어)
+  s_txFree = xQueueCreate(BLE_TX_SLOTS, sizeof(uint8_t));
+  s_txReplyFree = xQueueCreate(BLE_TX_REPLY_SLOTS, sizeof(uint8_t));
+  s_txReady = xQueueCreate(BLE_TX_ALL_SLOTS, sizeof(uint8_t));
+  s_benchDone = xSemaphoreCreateBinary();
+  for (uint8_t i = 0; i < BLE_TX_ALL_SLOTS; i++)
+  {
+    xQueueSend(i < BLE_TX_SLOTS ? s_txFree : s_txReplyFree, &i, 0);
+  }
+  xTaskCreatePinnedToCore(txTask, "bleTx", 4096, NULL, 1, &s_txTask, 0);
+
+  // 스택 초기화 전후 힙 차이 : 백엔드별 힙 사용량 비교 (stats ble_heap)
+  uint32_t freeHeap = ESP.getFreeHeap();
+  bleStack::setup(strDeviceName.c_str());
+  statsAdd(s_stats.stackHeap, freeHeap - ESP.getFreeHeap());
+
+  Serial.printf("Ble Ready (%s, heap %u), Device name: %s\n", bleStack::name, s_stats.stackHeap, strDeviceName.c_str());
+}
@@ -0,0 +1,101 @@
+#ifndef BLE_HPP
+#define BLE_HPP
+
+#include <Arduino.h>
+
+#include "tdoaSolver.hpp"
+
+// 브로드캐스트 : legacy 광고에서 돌려가며 보여 줄 최근 이벤트 수, 한 이벤트를 보여 주는 시간
+// 마지막 이벤트 뒤 BLE_BCAST_HOLD_MS 가 지나면 돌리지 않고 가장 최근 이벤트만 광고한다.
+#ifndef BLE_BCAST_DEPTH
+#define BLE_BCAST_DEPTH 4
+#endif
+#define BLE_BCAST_ROTATE_MS 100
+#define BLE_BCAST_HOLD_MS 2000
+
+// 재전송 중 스택이 notify 를 거절하면 (버퍼 가득) 이만큼 쉬고 다시
+#define BLE_REPLAY_BACKOFF_MS 5
+
+// 캡처 -> TX 태스크 슬롯 수 (가득 차면 가장 오래된 슬롯을 버린다)
+#ifndef BLE_TX_SLOTS
+#define BLE_TX_SLOTS 16
+#endif
+// bench ble 이 TX 태스크에서 끝나기를 기다리는 최대 시간
+#ifndef BLE_BENCH_TIMEOUT_MS
+#define BLE_BENCH_TIMEOUT_MS 30000
+#endif
+// 명령 응답 (about, format, ping, resume, 제어 특성) 전용 슬롯 수 : 이벤트가 몰려도 응답은 버려지지 않는다.
+#ifndef BLE_TX_REPLY_SLOTS
+#define BLE_TX_REPLY_SLOTS 4
+#endif
+
+// BLE 전송 통계 (serial stats 명령으로 출력)
+struct S_Ble_Stats
+{
+  uint16_t mtu;        // 협상된 ATT MTU
+  uint32_t packets;    // 보낸 시차 패킷 수 (0x09 + 0x0B)
+  uint32_t events;     // 보낸 이벤트 수
+  uint32_t bytes;      // 보낸 시차 패킷 바이트 수
+  uint32_t txQueued;   // TX 태스크로 넘긴 슬롯 수 (시차 + 위치)
+  uint32_t txDropped;  // 슬롯이 모자라 버린 결과 / 응답 수 (결과는 가장 오래된 것부터)
+  uint32_t txHighWater; // TX 큐 최대 대기 수
+  uint32_t stackHeap;  // BLE 스택 초기화에 든 힙 (바이트)
+  uint32_t notifyFailed; // 스택이 거절한 시차 notify 수 (버퍼 가득)
+  uint32_t replayed;   // resume 으로 다시 보낸 이벤트 수
+  uint32_t historyLost; // resume 요청 범위 중 기록 링에서 이미 밀려난 이벤트 수
+};
+
+// 사용 중인 BLE 스택 이름 (bluedroid / nimble)
+const char *ble_stackName();
+
+extern bool deviceConnected;
+
+void ble_setup(String strDeviceName);
+
+// 묶음 전송 정책 : 첫 이벤트 뒤 deadline_ms 가 지나거나 fill_events 개가 모이면 보낸다.
+// fill_events 0 은 MTU 가 찰 때까지, deadline_ms 0 은 묶지 않고 이벤트마다 0x09 로 보낸다.
+void ble_setBatch(uint32_t deadline_ms, uint32_t fill_events);
+// v2 형식의 tick 단위 (2^shift ns, 0 이면 손실 없음)
+void ble_setTickShift(uint8_t shift);
+// 이벤트 기록 링 (config ble_history 개), 연결이 끊긴 동안의 이벤트를 resume(cmd 0x04) 으로 다시 보낸다.
+void ble_setHistory(uint32_t events, int numChannels);
+// 이벤트에 seq 를 매기고 기록 링에 넣는다. (연결과 상관없이 모든 이벤트, dataLoop 에서만)
+uint32_t ble_recordTD(const uint32_t *pDurationTickList, int numChannels);
+// 시차/위치 전송 : 슬롯에 적어 TX 태스크(코어 0)로 넘기고 바로 돌아온다. (BLE 스택을 만지지 않음)
+boolean ble_sendTD(uint32_t seq, const uint32_t *pDurationTickList, int numChannels); // 시차데이터 전송 (정책에 따라 묶음)
+boolean ble_sendPos(const tdoaSolver::Fix &fix, uint32_t mask); // 위치 전송
+
+// 연결 없이 광고로 이벤트 전송 (seq, 시각 포함, packet.hpp S_Ble_Bcast_*), GATT 서비스와 같이 동작한다.
+void ble_setBroadcast(bool enable);
+boolean ble_broadcastTD(uint32_t seq, const uint32_t *pDurationTickList, int numChannels, uint32_t mask, uint64_t timeNs);
+
+// bench ble 결과 : 전송 방식별 초당 이벤트 수, 이벤트당 바이트 수
+struct S_Ble_Bench
+{
+  struct Entry
+  {
+    uint32_t eps;
+    float bytesPerEvent;
+  };
+  Entry single; // 이벤트마다 0x09
+  Entry batch;  // v1 묶음 0x0B
+  Entry v2;     // v2 묶음 0x0C
+};
+
+// 같은 합성 이벤트를 세 방식으로 보내 비교한다. (bench 표시 패킷, TX 태스크에서 돌고 끝날 때까지 기다린다)
+boolean ble_bench(int events, int numChannels, S_Ble_Bench &result);
+
+void ble_getStats(S_Ble_Stats &stats);
+
+// 제어 응답이 빈 응답 슬롯을 기다리는 최대 시간 (dump 처럼 여러 notify 로 이어지는 응답)
+#ifndef BLE_CTL_WAIT_MS
+#define BLE_CTL_WAIT_MS 200
+#endif
+
+// 제어 특성 응답 (MTU - 3 까지 잘림) : 응답 슬롯에 복사해 TX 태스크로 넘긴다. 순서는 유지된다.
+// 응답 슬롯이 모두 대기 중이면 waitMs 까지 기다린다. (BT 콜백에서는 0) 넘기지 못하면 false
+boolean ble_sendControl(const uint8_t *data, size_t length, uint32_t waitMs = BLE_CTL_WAIT_MS);
+// 협상된 ATT MTU
+uint16_t ble_mtu();
+
+#endif // BLE_HPP
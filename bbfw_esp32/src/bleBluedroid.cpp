@@ -0,0 +1,161 @@
+#if !defined(BLE_NIMBLE)
+
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLEUtils.h>
+#include <BLE2902.h>
+
+#include "packet.hpp"
+#include "bleStack.hpp"
+
+// Arduino BLE (Bluedroid) 백엔드
+
+namespace bleStack {
+
+const char *const name = "bluedroid";
+
+static BLEServer *pServer = NULL;
+static BLECharacteristic *pCharacteristic = NULL;
+static BLECharacteristic *pControl = NULL;
+static std::string s_name;
+static bool s_notifyOk = true;   // 마지막 notify 결과 (onStatus 가 notify() 안에서 불린다)
+static bool s_broadcast = false; // 브로드캐스트 광고 중 (연결 중에도 연결 불가 광고로 계속)
+
+class MyCharateristicCallbacks : public BLECharacteristicCallbacks
+{
+  void onWrite(BLECharacteristic *pCharacteristic)
+  {
+    std::string value = pCharacteristic->getValue();
+    ble_onWrite((const uint8_t *)value.data(), value.length());
+  }
+
+  void onStatus(BLECharacteristic *pCharacteristic, Status s, uint32_t code)
+  {
+    if (s == ERROR_GATT)
+      s_notifyOk = false;
+  }
+};
+
+class ControlCallbacks : public BLECharacteristicCallbacks
+{
+  void onWrite(BLECharacteristic *pCharacteristic)
+  {
+    std::string value = pCharacteristic->getValue();
+    ble_onControl((const uint8_t *)value.data(), value.length());
+  }
+};
+
+class MyServerCallbacks : public BLEServerCallbacks
+{
+  void onConnect(BLEServer *pServer)
+  {
+    pServer->getAdvertising()->stop(); // 클라이언트가 연결되면 광고 중지
+    if (s_broadcast)
+    {
+      // 브로드캐스트는 계속 (다른 클라이언트가 연결하지 못하게 연결 불가로)
+      pServer->getAdvertising()->setAdvertisementType(ADV_TYPE_NONCONN_IND);
+      pServer->getAdvertising()->start();
+    }
+    ble_onConnect();
+  };
+
+  void onDisconnect(BLEServer *pServer)
+  {
+    ble_onDisconnect();
+    pServer->getAdvertising()->stop();
+    pServer->getAdvertising()->setAdvertisementType(ADV_TYPE_IND);
+    pServer->getAdvertising()->start(); // 클라이언트가 연결 해제되면 광고 다시 시작
+  }
+
+  // MTU 교환은 클라이언트가 시작한다. 로컬 MTU(BLE_LOCAL_MTU) 이하에서 상대가 요청한 값이 정해진다.
+  void onMtuChanged(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+  {
+    ble_onMtu(param->mtu.mtu);
+  }
+};
+
+bool notify(const uint8_t *data, size_t length)
+{
+  s_notifyOk = true;
+  pCharacteristic->setValue((uint8_t *)data, length);
+  pCharacteristic->notify();
+  return s_notifyOk;
+}
+
+void notifyControl(const uint8_t *data, size_t length)
+{
+  pControl->setValue((uint8_t *)data, length);
+  pControl->notify();
+}
+
+// ESP32 (Bluedroid, BLE 4.2) 는 legacy 광고만
+size_t broadcastCapacity()
+{
+  return BLE_BCAST_LEGACY_MAX;
+}
+
+void setBroadcast(const uint8_t *data, size_t length)
+{
+  BLEAdvertising *pAdvertising = pServer->getAdvertising();
+  if (!s_broadcast)
+  {
+    // 광고 데이터는 제조사 데이터가 차지하므로 이름은 scan response 로 옮긴다.
+    // 연결 불가 광고는 간격이 100ms 이상이어야 한다.
+    BLEAdvertisementData scanResponse;
+    scanResponse.setName(s_name);
+    pAdvertising->setScanResponseData(scanResponse);
+    pAdvertising->setMinInterval(0xA0);
+    pAdvertising->setMaxInterval(0xA0);
+    s_broadcast = true;
+  }
+
+  BLEAdvertisementData advertisement;
+  advertisement.setFlags(ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT);
+  advertisement.setManufacturerData(std::string((const char *)data, length));
+  pAdvertising->setAdvertisementData(advertisement);
+}
+
+void setup(const char *deviceName)
+{
+  s_name = deviceName;
+
+  //  Create the BLE Device
+  BLEDevice::init(deviceName);
+  // 큰 MTU 를 허락해 두면 클라이언트의 MTU 교환 요청에 그만큼 응한다.
+  BLEDevice::setMTU(BLE_LOCAL_MTU);
+
+  // Create the BLE Server
+  pServer = BLEDevice::createServer();
+  pServer->setCallbacks(new MyServerCallbacks());
+
+  // Create the BLE Service
+  BLEService *pService = pServer->createService(SERVICE_UUID);
+
+  // Create a BLE Characteristic
+  pCharacteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_READ |
+          BLECharacteristic::PROPERTY_WRITE |
+          BLECharacteristic::PROPERTY_NOTIFY |
+          BLECharacteristic::PROPERTY_INDICATE);
+
+  pCharacteristic->addDescriptor(new BLE2902()); // 알람 표시 기능활성화
+  pCharacteristic->setCallbacks(new MyCharateristicCallbacks());
+
+  pControl = pService->createCharacteristic(
+      CONTROL_UUID,
+      BLECharacteristic::PROPERTY_WRITE |
+          BLECharacteristic::PROPERTY_NOTIFY);
+  pControl->addDescriptor(new BLE2902());
+  pControl->setCallbacks(new ControlCallbacks());
+
+  // Start the service
+  pService->start();
+
+  // Start advertising
+  pServer->getAdvertising()->start();
+}
+
+} // namespace bleStack
+
+#endif
@@ -0,0 +1,408 @@
+#include "bleControl.hpp"
+
+
+#include "config.hpp"
+#include "configSchema.hpp"
+#include "packet.hpp"
+#include "ble.hpp"
+
+#include "dataCapture.hpp"
+#include "adcCapture.hpp"
+#include "dlog.hpp"
+
+extern Config g_config;
+
+namespace bleControl
+{
+
+// key id, 타입, 범위는 설정 스키마 (configSchema.hpp) 를 그대로 쓴다.
+using configSchema::Key;
+
+// 요청 한 개 (BT 태스크가 쓰고 앱 태스크가 처리 후 비운다)
+static uint8_t s_req[BLE_LOCAL_MTU - 3];
+static volatile size_t s_reqLen = 0;
+
+//------------------------------------------------ reply
+// MTU 를 넘으면 parm[1] = 1 (이어짐) 로 나눠 보낸다.
+struct Reply
+{
+    uint8_t buf[BLE_LOCAL_MTU - 3];
+    size_t len;
+    size_t limit;
+    uint8_t cmd;
+    uint8_t count;
+    bool failed; // TX 로 넘기지 못한 패킷이 있다. (이후 패킷도 보내지 않는다)
+};
+
+static void replyBegin(Reply &reply, uint8_t cmd)
+{
+    uint16_t mtu = ble_mtu();
+    reply.limit = mtu > 3 ? mtu - 3 : 0;
+    if (reply.limit > sizeof(reply.buf))
+    {
+        reply.limit = sizeof(reply.buf);
+    }
+    reply.len = sizeof(S_Ble_Header_Packet);
+    reply.cmd = cmd;
+    reply.count = 0;
+    reply.failed = false;
+}
+
+static void replySend(Reply &reply, uint8_t status, uint8_t more, uint8_t parm2)
+{
+    if (reply.failed)
+    {
+        return;
+    }
+    S_Ble_Header_Packet *header = (S_Ble_Header_Packet *)reply.buf;
+    header->checkCode = CHECK_CODE;
+    header->cmd = reply.cmd;
+    header->parm[0] = status;
+    header->parm[1] = more;
+    header->parm[2] = parm2;
+    // 중간 패킷이 빠지면 클라이언트가 이어 붙일 수 없으므로 나머지도 보내지 않는다. (연결 끊김, TX 가 막힘)
+    if (!ble_sendControl(reply.buf, reply.len))
+    {
+        reply.failed = true;
+        DLOG_W(BLE, "control : reply 0x%02x dropped", reply.cmd);
+    }
+}
+
+static void replyEnd(Reply &reply, uint8_t status = BLE_CTL_OK, uint8_t keyId = 0)
+{
+    replySend(reply, status, 0, status == BLE_CTL_OK ? reply.count : keyId);
+}
+
+// TLV 하나 추가, 자리가 없으면 지금까지를 보내고 새 패킷에
+static bool replyPut(Reply &reply, uint8_t key, BleTlvType type, const void *value, size_t length)
+{
+    size_t need = 3 + length;
+    if (sizeof(S_Ble_Header_Packet) + need > reply.limit || length > 255)
+    {
+        return false;
+    }
+    if (reply.len + need > reply.limit)
+    {
+        replySend(reply, BLE_CTL_OK, 1, reply.count);
+        reply.len = sizeof(S_Ble_Header_Packet);
+        reply.count = 0;
+    }
+    uint8_t *p = reply.buf + reply.len;
+    p[0] = key;
+    p[1] = type;
+    p[2] = length;
+    memcpy(p + 3, value, length);
+    reply.len += need;
+    reply.count++;
+    return true;
+}
+
+//------------------------------------------------ config -> TLV
+static void putKey(Reply &reply, const Key &key, bool skipMissing)
+{
+    if (!g_config.has(key.id))
+    {
+        if (!skipMissing)
+        {
+            replyPut(reply, key.id, TLV_NONE, NULL, 0);
+        }
+        return;
+    }
+
+    // 저장 형식이 곧 TLV 값 (좌표는 차원 1 + 센서 순서 좌표)
+    uint8_t value[CONFIG_VALUE_MAX];
+    size_t length = g_config.copyValue(key, value);
+    replyPut(reply, key.id, key.type, value, length);
+}
+
+//------------------------------------------------ TLV -> config
+static int32_t readI32(const uint8_t *p)
+{
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static float readF32(const uint8_t *p)
+{
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 타입, 길이, 범위 확인
+static bool checkValue(const Key &key, uint8_t type, const uint8_t *value, size_t length)
+{
+    if (type != key.type)
+    {
+        return false;
+    }
+
+    switch (key.type)
+    {
+    case TLV_I32:
+    {
+        if (length != sizeof(int32_t))
+        {
+            return false;
+        }
+        int32_t v = readI32(value);
+        return v >= key.min && v <= key.max;
+    }
+
+    case TLV_F32:
+    {
+        if (length != sizeof(float))
+        {
+            return false;
+        }
+        float v = readF32(value);
+        return v >= key.min && v <= key.max;
+    }
+
+    case TLV_STR:
+        return (int32_t)length >= key.min && (int32_t)length <= key.max;
+
+    case TLV_I32A:
+    {
+        int32_t n = length / sizeof(int32_t);
+        return length % sizeof(int32_t) == 0 && n >= key.min && n <= key.max;
+    }
+
+    case TLV_POS:
+    {
+        if (length < 1 || (value[0] != 2 && value[0] != 3))
+        {
+            return false;
+        }
+        size_t row = sizeof(float) * value[0];
+        int32_t n = (length - 1) / row;
+        return (length - 1) % row == 0 && n >= key.min && n <= key.max;
+    }
+
+    default:
+        return false;
+    }
+}
+
+// checkValue 를 통과한 값만 들어온다. 저장은 BLE_CTL_SAVE / BLE_SET_SAVE 에서 한 번
+static void applyValue(const Key &key, const uint8_t *value, size_t length)
+{
+    switch (key.type)
+    {
+    case TLV_I32:
+        g_config.setInt(key.id, readI32(value), false);
+        break;
+
+    case TLV_F32:
+        g_config.setFloat(key.id, readF32(value), false);
+        break;
+
+    case TLV_STR:
+    {
+        char text[CONFIG_TEXT_MAX + 1];
+        memcpy(text, value, length);
+        text[length] = 0;
+        g_config.setText(key.id, text, false);
+    }
+    break;
+
+    case TLV_I32A:
+    {
+        int32_t values[CONFIG_LIST_MAX];
+        memcpy(values, value, length);
+        g_config.setInts(key.id, values, length / sizeof(int32_t), false);
+    }
+    break;
+
+    case TLV_POS:
+    {
+        float values[CONFIG_LIST_MAX * 3];
+        memcpy(values, value + 1, length - 1);
+        g_config.setPos(key.id, value[0], values, (length - 1) / (sizeof(float) * value[0]), false);
+    }
+    break;
+
+    default:
+        break;
+    }
+}
+
+// 모든 TLV 를 먼저 확인하고 (하나라도 틀리면 아무것도 바꾸지 않는다) 적용
+static void handleSet(const S_Ble_Header_Packet *header, const uint8_t *body, size_t length)
+{
+    Reply reply;
+    replyBegin(reply, BLE_CTL_SET);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        size_t pos = 0;
+        while (pos < length)
+        {
+            if (pos + 3 > length || pos + 3 + body[pos + 2] > length)
+            {
+                replyEnd(reply, BLE_CTL_BAD_VALUE, pos < length ? body[pos] : 0);
+                return;
+            }
+            uint8_t id = body[pos];
+            uint8_t type = body[pos + 1];
+            uint8_t size = body[pos + 2];
+            const uint8_t *value = body + pos + 3;
+
+            const Key *key = configSchema::find(id);
+            if (key == NULL)
+            {
+                replyEnd(reply, BLE_CTL_BAD_KEY, id);
+                return;
+            }
+            if (pass == 0)
+            {
+                if (!checkValue(*key, type, value, size))
+                {
+                    replyEnd(reply, BLE_CTL_BAD_VALUE, id);
+                    return;
+                }
+            }
+            else
+            {
+                applyValue(*key, value, size);
+                reply.count++;
+            }
+            pos += 3 + size;
+        }
+    }
+
+    if (header->parm[0] & (BLE_SET_SAVE | BLE_SET_RESTART))
+    {
+        g_config.save();
+    }
+    replyEnd(reply);
+
+    if (header->parm[0] & BLE_SET_RESTART)
+    {
+        // 응답이 나갈 시간
+        delay(200);
+        ESP.restart();
+    }
+}
+
+static void putStat(Reply &reply, uint8_t id, uint32_t value)
+{
+    replyPut(reply, id, TLV_I32, &value, sizeof(value));
+}
+
+static void handle(const uint8_t *data, size_t length)
+{
+    const S_Ble_Header_Packet *header = (const S_Ble_Header_Packet *)data;
+    const uint8_t *body = data + sizeof(S_Ble_Header_Packet);
+    size_t bodyLength = length - sizeof(S_Ble_Header_Packet);
+
+    Reply reply;
+    replyBegin(reply, header->cmd);
+
+    switch (header->cmd)
+    {
+    case BLE_CTL_GET:
+        for (size_t i = 0; i < bodyLength; i++)
+        {
+            const Key *key = configSchema::find(body[i]);
+            if (key == NULL)
+            {
+                replyEnd(reply, BLE_CTL_BAD_KEY, body[i]);
+                return;
+            }
+            putKey(reply, *key, false);
+        }
+        replyEnd(reply);
+        break;
+
+    case BLE_CTL_SET:
+        handleSet(header, body, bodyLength);
+        break;
+
+    case BLE_CTL_SAVE:
+        g_config.save();
+        replyEnd(reply);
+        break;
+
+    case BLE_CTL_DUMP:
+        for (const Key &key : configSchema::keys)
+        {
+            putKey(reply, key, true);
+        }
+        replyEnd(reply);
+        break;
+
+    case BLE_CTL_CAPTURE:
+        dataCapture::setPaused(header->parm[0] == 0);
+        DLOG_I(BLE, "capture %s (ble)", dataCapture::paused() ? "stop" : "start");
+        replySend(reply, BLE_CTL_OK, 0, dataCapture::paused() ? 0 : 1);
+        break;
+
+    case BLE_CTL_STATS:
+    {
+        dataCapture::Stats stats;
+        dataCapture::getStats(stats);
+        S_Ble_Stats ble;
+        ble_getStats(ble);
+
+        putStat(reply, STAT_EDGES, stats.edges);
+        putStat(reply, STAT_COMPLETE, stats.complete);
+        putStat(reply, STAT_PARTIAL, stats.partial);
+        putStat(reply, STAT_DROPPED, stats.dropped);
+        putStat(reply, STAT_OVERFLOW, stats.overflow);
+        putStat(reply, STAT_BLE_EVENTS, ble.events);
+        putStat(reply, STAT_BLE_TX_DROPPED, ble.txDropped);
+        putStat(reply, STAT_FREE_HEAP, ESP.getFreeHeap());
+        putStat(reply, STAT_CAPTURE, dataCapture::paused() ? 0 : 1);
+        replyEnd(reply);
+    }
+    break;
+
+    default:
+        replyEnd(reply, BLE_CTL_BAD_CMD, header->cmd);
+        break;
+    }
+}
+
+void receive(const uint8_t *data, size_t length)
+{
+    if (length < sizeof(S_Ble_Header_Packet) || length > sizeof(s_req))
+    {
+        DLOG_W(BLE, "control : bad length");
+        return;
+    }
+    if (((const S_Ble_Header_Packet *)data)->checkCode != CHECK_CODE)
+    {
+        DLOG_W(BLE, "control : invalid check code");
+        return;
+    }
+    if (s_reqLen != 0)
+    {
+        // 앞 요청 처리 중 : 조용히 버리지 않고 BUSY 로 알린다. (BT 태스크라 응답 슬롯을 기다리지 않는다)
+        S_Ble_Header_Packet busy = *(const S_Ble_Header_Packet *)data;
+        busy.parm[0] = BLE_CTL_BUSY;
+        busy.parm[1] = 0;
+        busy.parm[2] = 0;
+        if (!ble_sendControl((const uint8_t *)&busy, sizeof(busy), 0))
+        {
+            DLOG_W(BLE, "control : busy");
+        }
+        return;
+    }
+    memcpy(s_req, data, length);
+    s_reqLen = length;
+}
+
+void poll()
+{
+    size_t length = s_reqLen;
+    if (length == 0)
+    {
+        return;
+    }
+    handle(s_req, length);
+    s_reqLen = 0;
+}
+
+} // namespace bleControl
@@ -0,0 +1,20 @@
+#ifndef BLECONTROL_HPP
+#define BLECONTROL_HPP
+
+#include <Arduino.h>
+
+// BLE 제어 특성 (packet.hpp BLE_CTL_*)
+// 설정 key 를 id 로 받아 타입/범위를 확인하고 config 에 바로 넣는다. (JSON 텍스트 파싱 없음)
+// 요청은 BT 태스크에서 복사만 하고, 처리와 응답은 시리얼 명령과 같은 앱 태스크에서 한다.
+namespace bleControl
+{
+
+// BT 태스크 : 요청 하나를 복사해 둔다. (앞 요청 처리 중이면 BLE_CTL_BUSY 로 바로 응답하고 버린다)
+void receive(const uint8_t *data, size_t length);
+
+// 앱 태스크 : 대기 중인 요청을 처리하고 응답한다.
+void poll();
+
+} // namespace bleControl
+
+#endif // BLECONTROL_HPP
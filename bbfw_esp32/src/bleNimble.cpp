@@ -0,0 +1,210 @@
+#if defined(BLE_NIMBLE)
+
+#include <NimBLEDevice.h>
+
+#include "packet.hpp"
+#include "bleStack.hpp"
+
+// NimBLE-Arduino 백엔드 (-D BLE_NIMBLE)
+// Bluedroid 보다 힙을 적게 쓰고, notify 가 값을 특성에 복사하지 않고 바로 mbuf 로 나간다.
+// 연결되면 최소 연결 간격과 (지원하는 칩에서) 2M PHY 를 요청해 notify 지연을 줄인다.
+
+// 연결 간격 1.25ms 단위 : 6 = 7.5ms (BLE 최소), supervision timeout 10ms 단위
+#define NIMBLE_CONN_INTERVAL 6
+#define NIMBLE_CONN_TIMEOUT 400
+
+namespace bleStack {
+
+const char *const name = "nimble";
+
+static NimBLEServer *s_server = NULL;
+static NimBLECharacteristic *s_characteristic = NULL;
+static NimBLECharacteristic *s_control = NULL;
+static std::string s_name;
+static bool s_notifyOk = true;   // 마지막 notify 결과 (onStatus 가 notify() 안에서 불린다)
+static bool s_broadcast = false;
+
+#if defined(CONFIG_BT_NIMBLE_EXT_ADV)
+// extended 광고 (BLE 5 칩, nimconfig CONFIG_BT_NIMBLE_EXT_ADV)
+// 인스턴스 0 : 연결용 legacy 광고 (이름), 인스턴스 1 : 이벤트 브로드캐스트 (연결 불가, 2M 보조 PHY)
+#define ADV_CONNECTABLE 0
+#define ADV_BROADCAST 1
+
+static void startAdvertising()
+{
+  NimBLEExtAdvertisement advertisement;
+  advertisement.setLegacyAdvertising(true);
+  advertisement.setConnectable(true);
+  advertisement.setScannable(true);
+  advertisement.setName(s_name);
+  NimBLEExtAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+  pAdvertising->setInstanceData(ADV_CONNECTABLE, advertisement);
+  pAdvertising->start(ADV_CONNECTABLE);
+}
+#else
+static void startAdvertising()
+{
+  // 브로드캐스트 중이면 연결 불가 광고가 돌고 있다.
+  NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+  pAdvertising->stop();
+  pAdvertising->setAdvertisementType(BLE_GAP_CONN_MODE_UND);
+  pAdvertising->start();
+}
+#endif
+
+class CharacteristicCallbacks : public NimBLECharacteristicCallbacks
+{
+  void onWrite(NimBLECharacteristic *pCharacteristic) override
+  {
+    NimBLEAttValue value = pCharacteristic->getValue();
+    ble_onWrite(value.data(), value.length());
+  }
+
+  void onStatus(NimBLECharacteristic *pCharacteristic, Status s, int code) override
+  {
+    if (s == ERROR_GATT)
+      s_notifyOk = false;
+  }
+};
+
+class ControlCallbacks : public NimBLECharacteristicCallbacks
+{
+  void onWrite(NimBLECharacteristic *pCharacteristic) override
+  {
+    NimBLEAttValue value = pCharacteristic->getValue();
+    ble_onControl(value.data(), value.length());
+  }
+};
+
+class ServerCallbacks : public NimBLEServerCallbacks
+{
+  void onConnect(NimBLEServer *pServer, ble_gap_conn_desc *desc) override
+  {
+    // 간격 7.5ms 고정, slave latency 0 : 모든 연결 이벤트에서 notify 가 나갈 수 있다.
+    // 최종 값은 central 이 정한다. (휴대폰은 보통 15ms 이상으로 올린다)
+    pServer->updateConnParams(desc->conn_handle, NIMBLE_CONN_INTERVAL, NIMBLE_CONN_INTERVAL, 0, NIMBLE_CONN_TIMEOUT);
+#if defined(CONFIG_IDF_TARGET_ESP32C3) || defined(CONFIG_IDF_TARGET_ESP32S3)
+    // BLE 5 칩만 2M PHY 가 있다. (ESP32 는 1M 만)
+    ble_gap_set_prefered_le_phy(desc->conn_handle, BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_CODED_ANY);
+#endif
+#if !defined(CONFIG_BT_NIMBLE_EXT_ADV)
+    if (s_broadcast)
+    {
+      // legacy 브로드캐스트는 연결 불가 광고로 계속 (extended 는 인스턴스 1 이 따로 돈다)
+      NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+      pAdvertising->stop();
+      pAdvertising->setAdvertisementType(BLE_GAP_CONN_MODE_NON);
+      pAdvertising->start();
+    }
+#endif
+    ble_onConnect();
+  }
+
+  void onDisconnect(NimBLEServer *pServer) override
+  {
+    ble_onDisconnect();
+    startAdvertising();
+  }
+
+  void onMTUChange(uint16_t MTU, ble_gap_conn_desc *desc) override
+  {
+    ble_onMtu(MTU);
+  }
+};
+
+bool notify(const uint8_t *data, size_t length)
+{
+  s_notifyOk = true;
+  s_characteristic->notify(data, length);
+  return s_notifyOk;
+}
+
+void notifyControl(const uint8_t *data, size_t length)
+{
+  s_control->notify(data, length);
+}
+
+#if defined(CONFIG_BT_NIMBLE_EXT_ADV)
+size_t broadcastCapacity()
+{
+  return BLE_BCAST_EXT_MAX;
+}
+
+void setBroadcast(const uint8_t *data, size_t length)
+{
+  NimBLEExtAdvertisement advertisement(BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M);
+  advertisement.setConnectable(false);
+  advertisement.setScannable(false);
+  advertisement.setManufacturerData(std::string((const char *)data, length));
+
+  NimBLEExtAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+  pAdvertising->setInstanceData(ADV_BROADCAST, advertisement);
+  if (!s_broadcast)
+  {
+    pAdvertising->start(ADV_BROADCAST);
+    s_broadcast = true;
+  }
+}
+#else
+size_t broadcastCapacity()
+{
+  return BLE_BCAST_LEGACY_MAX;
+}
+
+void setBroadcast(const uint8_t *data, size_t length)
+{
+  NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
+  if (!s_broadcast)
+  {
+    // 이름은 scan response 로, 연결 불가 광고는 간격 100ms 이상
+    NimBLEAdvertisementData scanResponse;
+    scanResponse.setName(s_name);
+    pAdvertising->setScanResponseData(scanResponse);
+    pAdvertising->setMinInterval(0xA0);
+    pAdvertising->setMaxInterval(0xA0);
+    s_broadcast = true;
+  }
+
+  NimBLEAdvertisementData advertisement;
+  advertisement.setFlags(BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP);
+  advertisement.setManufacturerData(std::string((const char *)data, length));
+  pAdvertising->setAdvertisementData(advertisement);
+}
+#endif
+
+void setup(const char *deviceName)
+{
+  s_name = deviceName;
+  NimBLEDevice::init(deviceName);
+  NimBLEDevice::setMTU(BLE_LOCAL_MTU);
+
+  s_server = NimBLEDevice::createServer();
+  s_server->setCallbacks(new ServerCallbacks());
+
+  NimBLEService *pService = s_server->createService(SERVICE_UUID);
+
+  // CCCD(0x2902) 는 NOTIFY/INDICATE 속성이면 NimBLE 가 만든다.
+  s_characteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID,
+      NIMBLE_PROPERTY::READ |
+          NIMBLE_PROPERTY::WRITE |
+          NIMBLE_PROPERTY::NOTIFY |
+          NIMBLE_PROPERTY::INDICATE);
+  s_characteristic->setCallbacks(new CharacteristicCallbacks());
+
+  s_control = pService->createCharacteristic(
+      CONTROL_UUID,
+      NIMBLE_PROPERTY::WRITE |
+          NIMBLE_PROPERTY::NOTIFY);
+  s_control->setCallbacks(new ControlCallbacks());
+
+  pService->start();
+
+  // 연결이 끊기면 onDisconnect 에서 직접 다시 시작한다.
+  s_server->advertiseOnDisconnect(false);
+  startAdvertising();
+}
+
+} // namespace bleStack
+
+#endif
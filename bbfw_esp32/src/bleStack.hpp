@@ -0,0 +1,45 @@
+#ifndef BLESTACK_HPP
+#define BLESTACK_HPP
+
+#include <Arduino.h>
+
+// BLE 스택 백엔드 (ble.cpp 내부용)
+// 외부 모듈은 ble.hpp 만 사용한다.
+//  - 기본        : Arduino BLE (Bluedroid), bleBluedroid.cpp
+//  - BLE_NIMBLE  : NimBLE-Arduino, bleNimble.cpp (platformio.ini env:lolin_d32_nimble)
+// 두 백엔드는 같은 서비스/특성 UUID 와 같은 패킷을 쓴다. (클라이언트는 구분하지 않는다)
+
+// UUID for service and characteristic
+#define SERVICE_UUID "30f3eb7b-1d42-422f-9e40-4ac00754ab3d"
+#define CHARACTERISTIC_UUID "8ae845a8-019d-4509-b05d-938694f346d3"
+// 바이너리 제어 (설정/명령, packet.hpp BLE_CTL_*)
+#define CONTROL_UUID "8ae845a9-019d-4509-b05d-938694f346d3"
+
+namespace bleStack {
+
+// 장치/서버/특성 생성 후 광고 시작
+void setup(const char *deviceName);
+
+// 특성 notify (TX 태스크에서만 호출)
+// 스택 버퍼가 가득 차 거절되면 false (연결이 없거나 구독 전이면 true, 보낼 곳이 없을 뿐이다)
+bool notify(const uint8_t *data, size_t length);
+void notifyControl(const uint8_t *data, size_t length);
+
+// 브로드캐스트 광고 (TX 태스크에서만 호출)
+// 제조사 데이터 최대 크기 : BLE_BCAST_LEGACY_MAX 또는 (extended 광고가 되면) BLE_BCAST_EXT_MAX
+size_t broadcastCapacity();
+// 광고 제조사 데이터를 바꾼다. 켜져 있으면 연결 중에도 (연결 불가 광고로) 계속 광고한다.
+void setBroadcast(const uint8_t *data, size_t length);
+
+extern const char *const name;
+
+} // namespace bleStack
+
+// 스택 -> ble.cpp 이벤트 (스택의 BT 태스크에서 호출된다)
+void ble_onConnect();
+void ble_onDisconnect();
+void ble_onMtu(uint16_t mtu);
+void ble_onWrite(const uint8_t *data, size_t length);
+void ble_onControl(const uint8_t *data, size_t length);
+
+#endif // BLESTACK_HPP
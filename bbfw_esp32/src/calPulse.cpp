@@ -0,0 +1,168 @@
+#include "calPulse.hpp"
+
+#include <driver/rmt.h>
+
+#include "dlog.hpp"
+
+namespace calPulse
+{
+
+// RMT 1 tick = 1us (APB 80MHz / 80)
+static const uint8_t CLK_DIV = 80;
+// item 반쪽 하나의 최대 길이 (15비트)
+static const uint32_t MAX_HALF = 32767;
+// rmt_write_items 한 번에 넣는 펄스 수
+static const uint32_t BURST = 16;
+// 펄스 하나의 반쪽 수 상한 : high 1 + low 최대 7 (간격 약 229ms)
+static const uint32_t HALVES_PER_PULSE = 8;
+
+// 송신 중에는 RMT 드라이버가 s_items 를 읽으므로 묶음 송신이 끝나기 전에는 고치지 않는다.
+static rmt_item32_t s_items[BURST * HALVES_PER_PULSE / 2 + 1];
+static uint32_t s_halves = 0;
+static bool s_ready = false;
+
+static uint32_t s_remaining = 0; // 아직 RMT 에 넣지 않은 펄스 수
+static uint32_t s_periodUs = 0;
+static bool s_sending = false;   // 묶음 송신 중
+static bool s_failed = false;
+
+// (level, duration) 반쪽을 item 에 차례로 채운다. (item 하나 = 반쪽 두 개)
+static void putHalf(uint32_t level, uint32_t duration)
+{
+    rmt_item32_t &item = s_items[s_halves / 2];
+    if ((s_halves & 1) == 0)
+    {
+        item.val = 0;
+        item.level0 = level;
+        item.duration0 = duration;
+    }
+    else
+    {
+        item.level1 = level;
+        item.duration1 = duration;
+    }
+    s_halves++;
+}
+
+static void putLevel(uint32_t level, uint32_t duration)
+{
+    while (duration > 0)
+    {
+        uint32_t d = duration > MAX_HALF ? MAX_HALF : duration;
+        putHalf(level, d);
+        duration -= d;
+    }
+}
+
+bool setup(int pin)
+{
+    if (s_ready)
+    {
+        end();
+    }
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, CAL_RMT_CHANNEL);
+    config.clk_div = CLK_DIV;
+    config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+    config.tx_config.idle_output_en = true;
+
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(CAL_RMT_CHANNEL, 0, 0) != ESP_OK)
+    {
+        DLOG_E(CAPTURE, "calPulse : rmt setup failed");
+        return false;
+    }
+    s_ready = true;
+    return true;
+}
+
+uint32_t maxPeriodUs()
+{
+    return CAL_PULSE_US + (HALVES_PER_PULSE - 1) * MAX_HALF;
+}
+
+// 짧은 간격만 늘린다. 긴 간격은 start 가 거절한다. (item 자리가 모자라 줄이면 간격이 달라진다)
+static uint32_t clampPeriod(uint32_t periodUs)
+{
+    if (periodUs <= CAL_PULSE_US)
+    {
+        return CAL_PULSE_US * 2;
+    }
+    return periodUs;
+}
+
+// 다음 묶음 (최대 BURST 펄스) 을 item 으로 만들어 넣는다. (wait_tx_done false : 바로 돌아온다)
+static bool sendBurst()
+{
+    uint32_t n = s_remaining > BURST ? BURST : s_remaining;
+    s_halves = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        putLevel(1, CAL_PULSE_US);
+        putLevel(0, s_periodUs - CAL_PULSE_US);
+    }
+    // 반쪽 수가 홀수면 마지막 item 의 뒷 반쪽은 길이 0 (송신 끝 표시)
+    if (s_halves & 1)
+    {
+        putHalf(0, 0);
+    }
+
+    if (rmt_write_items(CAL_RMT_CHANNEL, s_items, s_halves / 2, false) != ESP_OK)
+    {
+        DLOG_E(CAPTURE, "calPulse : rmt write failed");
+        s_failed = true;
+        s_sending = false;
+        s_remaining = 0;
+        return false;
+    }
+    s_remaining -= n;
+    s_sending = true;
+    return true;
+}
+
+bool start(uint32_t count, uint32_t periodUs)
+{
+    if (!s_ready || s_sending || periodUs > maxPeriodUs())
+    {
+        return false;
+    }
+    s_periodUs = clampPeriod(periodUs);
+    s_remaining = count;
+    s_failed = false;
+    return count == 0 || sendBurst();
+}
+
+bool poll()
+{
+    if (s_sending && rmt_wait_tx_done(CAL_RMT_CHANNEL, 0) == ESP_OK)
+    {
+        s_sending = false;
+    }
+    if (!s_sending && s_remaining > 0)
+    {
+        sendBurst();
+    }
+    return s_sending || s_remaining > 0;
+}
+
+bool failed()
+{
+    return s_failed;
+}
+
+uint32_t durationMs(uint32_t count, uint32_t periodUs)
+{
+    return (uint32_t)((uint64_t)count * clampPeriod(periodUs) / 1000);
+}
+
+void end()
+{
+    if (s_ready)
+    {
+        rmt_driver_uninstall(CAL_RMT_CHANNEL);
+        s_ready = false;
+    }
+    s_sending = false;
+    s_remaining = 0;
+}
+
+} // namespace calPulse
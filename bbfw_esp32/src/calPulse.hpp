@@ -0,0 +1,51 @@
+#ifndef CALPULSE_HPP
+#define CALPULSE_HPP
+
+#include <Arduino.h>
+
+// 채널 지연 보정용 루프백 펄스 발생기 (calibrate 명령)
+// RMT 송신 채널로 cal_pin 에 펄스 열을 낸다. cal_pin 을 모든 센서 입력에 같이 물려 두면
+// 모든 채널이 같은 순간의 에지를 받으므로, 이벤트 안 채널별 시각 차가 곧 채널 지연이다.
+// 펄스 폭과 간격은 RMT 하드웨어가 만들므로 소프트웨어 지터(인터럽트, 태스크 전환)가 끼지 않는다.
+
+namespace calPulse {
+
+// 사용할 RMT 송신 채널 (Arduino RMT 할당은 0 번부터 쓰므로 끝 채널)
+#ifndef CAL_RMT_CHANNEL
+#define CAL_RMT_CHANNEL RMT_CHANNEL_7
+#endif
+
+// 펄스 폭 (us)
+#define CAL_PULSE_US 10
+
+bool setup(int pin);
+
+// start 가 받는 가장 긴 펄스 간격 (us, 약 229ms)
+uint32_t maxPeriodUs();
+
+/**
+ * @brief 펄스 count 개 송신을 시작한다. 기다리지 않는다. (첫 묶음만 RMT 에 넣고 나머지는 poll)
+ *
+ * @param count    펄스 수
+ * @param periodUs 펄스 시작 간격 (us, 상관 창 + detect_delay 보다 길어야 한다, maxPeriodUs 이하)
+ * @return false 준비 전, 송신 중, 간격이 너무 길거나 RMT 오류
+ */
+bool start(uint32_t count, uint32_t periodUs);
+
+/**
+ * @brief 앞 묶음 송신이 끝났으면 다음 묶음을 넣는다. 주기적으로 호출 (기다리지 않음)
+ * @return true 아직 보낼 펄스가 있거나 송신 중
+ */
+bool poll();
+
+// 송신 중 RMT 오류가 났는지
+bool failed();
+
+// start 에 쓸 간격으로 펄스 count 개에 걸리는 시간 (ms)
+uint32_t durationMs(uint32_t count, uint32_t periodUs);
+
+void end();
+
+} // namespace calPulse
+
+#endif // CALPULSE_HPP
@@ -0,0 +1,109 @@
+#ifndef CAPTUREBACKEND_HPP
+#define CAPTUREBACKEND_HPP
+
+#include "dataCapture.hpp"
+
+#include <spscRing.hpp>
+
+#include "timeBase.hpp"
+
+// dataCapture 내부에서 백엔드(ISR 쪽)와 공유하는 상태
+// 외부 모듈은 dataCapture.hpp 만 사용한다.
+
+namespace dataCapture {
+
+// ISR -> 캡처 태스크로 전달되는 에지 레코드
+struct EdgeRecord
+{
+    timeBase::stamp_t ns; // 에지 시각 (64비트 ns), 하드웨어 래치 백엔드는 ISR 시각 -> resolve() 에서 보정
+    uint32_t raw;         // 백엔드 원시 래치 값 (사용하지 않으면 0)
+    uint8_t channel;
+};
+
+typedef SpscRing<EdgeRecord, EDGE_RING_SIZE> EdgeRing;
+
+// 코어별 링 : 같은 코어의 ISR 끼리는 중첩되지 않으므로 코어당 생산자는 하나
+extern EdgeRing g_edgeRings[portNUM_PROCESSORS];
+
+// 캡처 태스크 깨우기 : ISR 은 이벤트의 첫 에지와 마지막 채널 에지에서만 알림을 보낸다.
+extern TaskHandle_t g_notifyTask;
+extern std::atomic<uint32_t> g_pendingMask; // 소비자가 마지막으로 본 이후 에지가 들어온 채널
+extern uint32_t g_expectMask;               // 설정된 전체 채널 마스크
+
+// 에지를 링에 넣고 캡처 태스크를 깨워야 하는지 판단 (이벤트의 첫 에지, 마지막 채널 에지)
+SPSC_ALWAYS_INLINE bool queueEdge(uint8_t channel, timeBase::stamp_t ns, uint32_t raw)
+{
+    EdgeRecord rec = {ns, raw, channel};
+    g_edgeRings[xPortGetCoreID()].push(rec);
+
+    uint32_t bit = 1UL << channel;
+    uint32_t prev = g_pendingMask.fetch_or(bit);
+    uint32_t now = prev | bit;
+
+    bool first = (prev == 0);
+    bool complete = ((now & g_expectMask) == g_expectMask) && ((prev & g_expectMask) != g_expectMask);
+    return (first || complete) && g_notifyTask != NULL;
+}
+
+/**
+ * @brief ISR 에서 호출. 에지를 링에 넣고 필요하면 캡처 태스크를 깨운다.
+ * @return 더 높은 우선순위 태스크가 깨어났으면 true (호출한 ISR 에서 yield)
+ */
+SPSC_ALWAYS_INLINE bool pushEdge(uint8_t channel, timeBase::stamp_t ns, uint32_t raw = 0)
+{
+    BaseType_t woken = pdFALSE;
+    if (queueEdge(channel, ns, raw))
+    {
+        vTaskNotifyGiveFromISR(g_notifyTask, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+// 태스크에서 에지를 공급하는 캡처 엔진용 (같은 코어에서 생산자는 하나여야 한다)
+inline void pushEdgeFromTask(uint8_t channel, timeBase::stamp_t ns)
+{
+    if (queueEdge(channel, ns, 0))
+    {
+        xTaskNotifyGive(g_notifyTask);
+    }
+}
+
+namespace backend {
+
+// 핀 설정 및 캡처 시작, 실제로 설정된 채널 수를 반환
+int setup(const int* pins, int num_channels);
+
+// 태스크 쪽에서 레코드의 ns 를 최종 에지 시각으로 확정 (ISR 에서 못 하는 64비트 연산)
+void resolve(EdgeRecord &edge);
+
+extern const char* const name;
+
+} // namespace backend
+
+#if !defined(CAPTURE_BACKEND_MCPWM)
+// GPIO 뱅크 전체에 ISR 하나 (captureBank.cpp), 에지 시각은 ISR 에서 확정되므로 resolve() 는 gpio 와 같다.
+namespace bank {
+
+int setup(const int* pins, int num_channels);
+
+extern const char* const name;
+
+} // namespace bank
+
+// 코어 1 전용 폴링 루프 (capturePoll.cpp), 에지 시각은 루프에서 확정된다.
+namespace poll {
+
+int setup(const int* pins, int num_channels, uint32_t burst_us);
+// 폴링 태스크 시작 (코어 1 을 점유하므로 setup() 마지막에)
+void start();
+uint32_t loopNs();
+uint32_t missed();
+
+extern const char* const name;
+
+} // namespace poll
+#endif
+
+} // namespace dataCapture
+
+#endif // CAPTUREBACKEND_HPP
@@ -0,0 +1,98 @@
+#if !defined(CAPTURE_BACKEND_MCPWM)
+
+#include <driver/gpio.h>
+#include <soc/gpio_struct.h>
+#include <soc/soc_caps.h>
+
+#include "captureBackend.hpp"
+#include "dlog.hpp"
+
+// GPIO 뱅크 캡처 (config set capture_mode bank)
+// 핀마다 ISR 을 두면 거의 동시에 들어온 에지가 인터럽트 디스패치를 차례로 거치면서
+// 뒤 채널에 앞 ISR 실행 시간이 거짓 시차로 더해진다. (어레이 중앙 근처 음원에서 가장 크다)
+// 여기서는 저수준 GPIO 인터럽트 핸들러 하나만 등록해 인터럽트 상태를 한 번 읽고,
+// 한 번 찍은 시각을 비트가 선 모든 채널에 같이 준다.
+
+namespace dataCapture {
+namespace bank {
+
+const char* const name = "bank";
+
+static gpio_isr_handle_t s_handle = NULL;
+
+// GPIO 번호 -> 채널 (-1 : 사용하지 않음)
+static int8_t s_pinChannel[SOC_GPIO_PIN_COUNT];
+static uint32_t s_maskLow = 0;  // GPIO 0~31
+static uint32_t s_maskHigh = 0; // GPIO 32~
+
+static inline bool IRAM_ATTR pushBits(uint32_t bits, int base, timeBase::stamp_t t) {
+    bool woken = false;
+    while (bits) {
+        int pin = base + __builtin_ctz(bits);
+        bits &= bits - 1;
+        woken |= pushEdge((uint8_t)s_pinChannel[pin], t);
+    }
+    return woken;
+}
+
+static void IRAM_ATTR bankIsr(void* arg) {
+    // 시각을 먼저 찍고 상태를 한 번 읽는다. 이후 들어온 에지는 다음 인터럽트에서 따로 찍힌다.
+    timeBase::stamp_t t = timeBase::now();
+
+    uint32_t low = GPIO.status;
+    GPIO.status_w1tc = low;
+#if SOC_GPIO_PIN_COUNT > 32
+    uint32_t high = GPIO.status1.intr_st;
+    GPIO.status1_w1tc.intr_st = high;
+#endif
+
+    bool woken = pushBits(low & s_maskLow, 0, t);
+#if SOC_GPIO_PIN_COUNT > 32
+    woken |= pushBits(high & s_maskHigh, 32, t);
+#endif
+
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+int setup(const int* pins, int num_channels) {
+    for (int i = 0; i < SOC_GPIO_PIN_COUNT; i++) {
+        s_pinChannel[i] = -1;
+    }
+    s_maskLow = 0;
+    s_maskHigh = 0;
+
+    uint64_t pinMask = 0;
+    for (int i = 0; i < num_channels; i++) {
+        if (pins[i] < 0 || pins[i] >= SOC_GPIO_PIN_COUNT) {
+            DLOG_E(CAPTURE, "bank capture : invalid pin %d", pins[i]);
+            return i;
+        }
+        s_pinChannel[pins[i]] = i;
+        pinMask |= 1ULL << pins[i];
+    }
+    s_maskLow = (uint32_t)pinMask;
+    s_maskHigh = (uint32_t)(pinMask >> 32);
+
+    // 상승 에지, 내부 풀다운 (핀 ISR 백엔드의 INPUT_PULLDOWN/RISING 과 같은 조건)
+    gpio_config_t conf = {};
+    conf.pin_bit_mask = pinMask;
+    conf.mode = GPIO_MODE_INPUT;
+    conf.pull_up_en = GPIO_PULLUP_DISABLE;
+    conf.pull_down_en = GPIO_PULLDOWN_ENABLE;
+    conf.intr_type = GPIO_INTR_POSEDGE;
+    gpio_config(&conf);
+
+    // gpio_install_isr_service (attachInterrupt) 대신 뱅크 전체에 핸들러 하나
+    if (gpio_isr_register(bankIsr, NULL, ESP_INTR_FLAG_IRAM, &s_handle) != ESP_OK) {
+        DLOG_E(CAPTURE, "gpio_isr_register failed");
+        return 0;
+    }
+    return num_channels;
+}
+
+} // namespace bank
+} // namespace dataCapture
+
+#endif // !CAPTURE_BACKEND_MCPWM
@@ -0,0 +1,97 @@
+#if defined(CAPTURE_BACKEND_MCPWM)
+
+#include <driver/gpio.h>
+#include <driver/mcpwm.h>
+#include <soc/mcpwm_struct.h>
+
+#include "captureBackend.hpp"
+#include "dlog.hpp"
+
+// MCPWM 캡처 백엔드
+// 에지가 들어오는 순간 캡처 타이머(APB 80MHz) 값을 하드웨어가 래치하므로
+// ISR 진입 지연/지터가 측정값에 섞이지 않는다.
+// ESP32 는 MCPWM 유닛 2개 x 캡처 채널 3개 = 최대 6채널.
+
+namespace dataCapture {
+namespace backend {
+
+const char* const name = "mcpwm";
+
+static const int CAP_PER_UNIT = 3;
+static const int MAX_CAP_CHANNELS = 2 * CAP_PER_UNIT;
+
+static const mcpwm_io_signals_t s_capSignals[CAP_PER_UNIT] = {MCPWM_CAP_0, MCPWM_CAP_1, MCPWM_CAP_2};
+
+static portMUX_TYPE s_syncMux = portMUX_INITIALIZER_UNLOCKED;
+
+// 캡처 타이머를 0 으로 맞춘 시각 (timeBase ns)
+static timeBase::stamp_t s_zeroNs = 0;
+
+static bool IRAM_ATTR onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t cap_channel,
+                                const cap_event_data_t *edata, void *user_data)
+{
+    // 래치 값은 32비트(53.7초 랩)라 ISR 시각을 같이 넣고 resolve() 에서 64비트로 확장한다.
+    // 반환값이 true 이면 드라이버가 ISR 종료 시 yield 한다.
+    return pushEdge((uint8_t)(intptr_t)user_data, timeBase::now(), edata->cap_value);
+}
+
+/**
+ * @brief 두 MCPWM 유닛의 캡처 타이머를 소프트웨어 동기로 동시에 0 으로 맞춘다.
+ *        유닛이 달라도 같은 시간축의 틱을 비교할 수 있게 된다. (레지스터 쓰기 사이 스큐 수십 ns)
+ */
+static void syncCaptureTimers()
+{
+    portENTER_CRITICAL(&s_syncMux);
+    MCPWM0.cap_timer_phase = 0;
+    MCPWM1.cap_timer_phase = 0;
+    MCPWM0.cap_timer_cfg.synci_en = 1;
+    MCPWM1.cap_timer_cfg.synci_en = 1;
+    MCPWM0.cap_timer_cfg.sync_sw = 1;
+    MCPWM1.cap_timer_cfg.sync_sw = 1;
+    s_zeroNs = timeBase::now();
+    portEXIT_CRITICAL(&s_syncMux);
+}
+
+int setup(const int* pins, int num_channels) {
+    if (num_channels > MAX_CAP_CHANNELS) {
+        DLOG_W(CAPTURE, "mcpwm capture supports %d channels, %d ignored", MAX_CAP_CHANNELS, num_channels - MAX_CAP_CHANNELS);
+        num_channels = MAX_CAP_CHANNELS;
+    }
+
+    for (int i = 0; i < num_channels; i++) {
+        mcpwm_unit_t unit = (i < CAP_PER_UNIT) ? MCPWM_UNIT_0 : MCPWM_UNIT_1;
+        int cap = i % CAP_PER_UNIT;
+
+        mcpwm_gpio_init(unit, s_capSignals[cap], pins[i]);
+        gpio_pulldown_en((gpio_num_t)pins[i]);
+
+        mcpwm_capture_config_t conf = {};
+        conf.cap_edge = MCPWM_POS_EDGE;
+        conf.cap_prescale = 1;
+        conf.capture_cb = onCapture;
+        conf.user_data = (void *)(intptr_t)i;
+        mcpwm_capture_enable_channel(unit, (mcpwm_capture_channel_id_t)cap, &conf);
+    }
+
+    syncCaptureTimers();
+
+    return num_channels;
+}
+
+/**
+ * @brief 32비트 래치 값을 timeBase 시간축의 64비트 ns 로 바꾼다.
+ *        ISR 시각으로 경과 틱을 추정하고, 래치 값과 하위 32비트가 일치하는 가장 가까운 값을 고른다.
+ *        (래치~ISR 지연은 수 us 라 ±26초 범위 안에서 항상 유일)
+ *        APB 80MHz : 1 tick = 12.5ns
+ */
+void resolve(EdgeRecord &edge) {
+    uint64_t est = (edge.ns - s_zeroNs) * 2 / 25;
+    int32_t lag = (int32_t)((uint32_t)est - edge.raw);
+    uint64_t ticks = est - (int64_t)lag;
+    edge.ns = s_zeroNs + ticks * 25 / 2;
+}
+
+} // namespace backend
+} // namespace dataCapture
+
+#endif // CAPTURE_BACKEND_MCPWM
@@ -0,0 +1,177 @@
+#if !defined(CAPTURE_BACKEND_MCPWM)
+
+#include <driver/gpio.h>
+#include <soc/gpio_struct.h>
+#include <soc/soc_caps.h>
+#include <xtensa/core-macros.h>
+
+#include "captureBackend.hpp"
+#include "dlog.hpp"
+
+// 코어 1 전용 폴링 캡처 (config set capture_mode poll)
+// 코어 1 을 통째로 써서 인터럽트를 막은 채 GPIO 입력 레지스터와 CCOUNT 를 매 반복 읽고,
+// 모든 채널의 상승 에지를 비트 연산으로 한꺼번에 찾는다. ISR 진입 지연/디스패치 순서가 없어
+// 분해능은 루프 한 바퀴 (수십 ns) 이고 지연이 일정하다.
+// - 에지는 코어별 SPSC 링으로 코어 0 의 dataLoop 에 넘긴다.
+// - burst(poll_burst_us) 마다 잠깐 인터럽트를 열어 틱, IPC(timeBase 앵커 갱신, 플래시 접근),
+//   dataLoop 알림을 처리한다. 그 사이에 올라온 에지는 시각을 모르므로 버리고 missed 로 센다.
+
+namespace dataCapture {
+namespace poll {
+
+const char* const name = "poll";
+
+static int s_pinChannel[SOC_GPIO_PIN_COUNT];
+static uint32_t s_maskLow = 0;
+static uint32_t s_maskHigh = 0;
+static uint32_t s_burstUs = 1000;
+
+static TaskHandle_t s_task = NULL;
+
+static volatile uint32_t s_loopCycles = 0; // 최근 burst 의 반복당 사이클 (x16)
+static volatile uint32_t s_missed = 0;
+
+static inline void IRAM_ATTR pushRising(uint32_t rise, int base, timeBase::stamp_t t, EdgeRing &ring) {
+    while (rise) {
+        int pin = base + __builtin_ctz(rise);
+        rise &= rise - 1;
+        EdgeRecord rec = {t, 0, (uint8_t)s_pinChannel[pin]};
+        ring.push(rec);
+    }
+}
+
+/**
+ * @brief burst 하나 : 인터럽트를 막고 burstCycles 동안 폴링
+ *        HIGH_BANK 이면 GPIO 32~ 도 읽는다. (레지스터 읽기가 한 번 늘어남)
+ *        prevLow/prevHigh 는 앞 burst 끝의 입력 상태
+ *
+ * @return 에지를 하나라도 넣었으면 true
+ */
+template <bool HIGH_BANK>
+static bool IRAM_ATTR burst(uint32_t burstCycles, EdgeRing &ring, uint32_t &prevLow, uint32_t &prevHigh) {
+    const uint32_t maskLow = s_maskLow;
+    const uint32_t maskHigh = s_maskHigh;
+
+    portDISABLE_INTERRUPTS();
+
+    // 인터럽트를 열어 둔 동안 올라온 입력은 시각을 모르므로 버리고 missed 로 센다.
+    uint32_t low = GPIO.in & maskLow;
+    uint32_t high = HIGH_BANK ? (GPIO.in1.data & maskHigh) : 0;
+    uint32_t missed = __builtin_popcount(low & ~prevLow) + __builtin_popcount(high & ~prevHigh);
+    prevLow = low;
+    prevHigh = high;
+
+    bool pushed = false;
+    uint32_t iterations = 0;
+    const uint32_t start = XTHAL_GET_CCOUNT();
+    uint32_t cc;
+    do {
+        cc = XTHAL_GET_CCOUNT();
+        low = GPIO.in & maskLow;
+        uint32_t riseLow = low & ~prevLow;
+        prevLow = low;
+
+        uint32_t riseHigh = 0;
+        if (HIGH_BANK) {
+            high = GPIO.in1.data & maskHigh;
+            riseHigh = high & ~prevHigh;
+            prevHigh = high;
+        }
+
+        if (riseLow | riseHigh) {
+            // 같은 반복에서 올라온 채널은 같은 시각 (CCOUNT -> ns 변환은 에지가 있을 때만)
+            timeBase::stamp_t t = timeBase::fromCycles(cc);
+            pushRising(riseLow, 0, t, ring);
+            if (HIGH_BANK) {
+                pushRising(riseHigh, 32, t, ring);
+            }
+            pushed = true;
+        }
+        iterations++;
+    } while (cc - start < burstCycles);
+
+    portENABLE_INTERRUPTS();
+
+    s_missed += missed;
+    s_loopCycles = (uint32_t)(((uint64_t)(cc - start) << 4) / iterations);
+    return pushed;
+}
+
+static void pollTask(void* param) {
+    EdgeRing &ring = g_edgeRings[xPortGetCoreID()];
+    uint32_t burstCycles = s_burstUs * getCpuFrequencyMhz();
+
+    uint32_t prevLow = GPIO.in & s_maskLow;
+    uint32_t prevHigh = s_maskHigh ? (GPIO.in1.data & s_maskHigh) : 0;
+
+    while (true) {
+        bool pushed;
+        if (s_maskHigh) {
+            pushed = burst<true>(burstCycles, ring, prevLow, prevHigh);
+        }
+        else {
+            pushed = burst<false>(burstCycles, ring, prevLow, prevHigh);
+        }
+
+        // 알림은 burst 밖에서만 보낸다. (루프 안 지연 없음, 최대 지연 = burst 길이)
+        if (pushed && g_notifyTask != NULL) {
+            xTaskNotifyGive(g_notifyTask);
+        }
+        // 틱, IPC 태스크(우선순위 더 높음) 처리
+        taskYIELD();
+    }
+}
+
+int setup(const int* pins, int num_channels, uint32_t burst_us) {
+    for (int i = 0; i < SOC_GPIO_PIN_COUNT; i++) {
+        s_pinChannel[i] = -1;
+    }
+
+    uint64_t pinMask = 0;
+    for (int i = 0; i < num_channels; i++) {
+        if (pins[i] < 0 || pins[i] >= SOC_GPIO_PIN_COUNT) {
+            DLOG_E(CAPTURE, "poll capture : invalid pin %d", pins[i]);
+            num_channels = i;
+            break;
+        }
+        s_pinChannel[pins[i]] = i;
+        pinMask |= 1ULL << pins[i];
+    }
+    s_maskLow = (uint32_t)pinMask;
+    s_maskHigh = (uint32_t)(pinMask >> 32);
+    s_burstUs = burst_us > 0 ? burst_us : 1000;
+
+    gpio_config_t conf = {};
+    conf.pin_bit_mask = pinMask;
+    conf.mode = GPIO_MODE_INPUT;
+    conf.pull_up_en = GPIO_PULLUP_DISABLE;
+    conf.pull_down_en = GPIO_PULLDOWN_ENABLE;
+    conf.intr_type = GPIO_INTR_DISABLE;
+    gpio_config(&conf);
+
+    return num_channels;
+}
+
+void start() {
+    if (s_task != NULL) {
+        return;
+    }
+    // 코어 1 의 idle 태스크가 돌지 못하므로 태스크 워치독에서 뺀다.
+    disableCore1WDT();
+    // IPC 태스크(configMAX_PRIORITIES - 1) 보다 한 단계 낮게 : burst 사이에 IPC 가 끼어들 수 있어야 한다.
+    xTaskCreatePinnedToCore(pollTask, "capturePoll", 4096, NULL, configMAX_PRIORITIES - 2, &s_task, 1);
+}
+
+uint32_t loopNs() {
+    uint32_t mhz = getCpuFrequencyMhz();
+    return mhz > 0 ? (s_loopCycles * 1000 / mhz) >> 4 : 0;
+}
+
+uint32_t missed() {
+    return s_missed;
+}
+
+} // namespace poll
+} // namespace dataCapture
+
+#endif // !CAPTURE_BACKEND_MCPWM
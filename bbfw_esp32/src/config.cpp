@@ -1,148 +1,873 @@
-#include "Config.hpp"
+#include "config.hpp"
 
-bool isNumber(String str)
+#include "dlog.hpp"
+#include "poolAllocator.hpp"
+
+using configSchema::Key;
+
+// config set 의 값 문서 : 명령 응답과 같은 풀 (parseCmd.cpp)
+extern PoolAllocator<CMD_JSON_POOL_BYTES> g_cmdJsonPool;
+
+//------------------------------------------------ defaults
+void Config::setDefault(const Key &key)
+{
+    switch (key.type)
+    {
+    case TLV_I32:
+        field<int32_t>(key) = (int32_t)key.def;
+        break;
+    case TLV_F32:
+        field<float>(key) = key.def;
+        break;
+    case TLV_STR:
+        memset(&field<char>(key), 0, CONFIG_TEXT_MAX + 1);
+        strncpy(&field<char>(key), key.text, CONFIG_TEXT_MAX);
+        break;
+    case TLV_I32A:
+        // 배열은 비어 있음 (count 0)
+        memset(&field<configSchema::IntList>(key), 0, sizeof(configSchema::IntList));
+        break;
+    case TLV_POS:
+        memset(&field<configSchema::PosList>(key), 0, sizeof(configSchema::PosList));
+        break;
+    default:
+        break;
+    }
+}
+
+void Config::defaults()
+{
+    for (const Key &key : configSchema::keys)
+    {
+        setDefault(key);
+    }
+    m_present = 0;
+}
+
+//------------------------------------------------ NVS
+// 스키마의 모든 key id 비트
+static uint32_t allKeys()
 {
-    for (int i = 0; i < str.length(); i++)
+    uint32_t mask = 0;
+    for (const Key &key : configSchema::keys)
     {
-        if (!isDigit(str[i]))
+        mask |= 1UL << key.id;
+    }
+    return mask;
+}
+
+bool Config::openNvs()
+{
+    if (!m_nvsOpen)
+    {
+        esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &m_nvs);
+        if (err != ESP_OK)
         {
+            DLOG_E(CONFIG, "nvs_open failed (%s)", esp_err_to_name(err));
             return false;
         }
+        m_nvsOpen = true;
     }
     return true;
 }
 
+// NVS 값 하나 -> values (값 확인은 타입별 setter 가 한다)
+bool Config::readKey(const Key &key)
+{
+    if (key.type == TLV_I32)
+    {
+        int32_t v;
+        if (nvs_get_i32(m_nvs, key.name, &v) != ESP_OK)
+        {
+            return true; // 설정 없음
+        }
+        return setInt(key.id, v, false);
+    }
+
+    uint8_t buf[CONFIG_VALUE_MAX];
+    size_t length = sizeof(buf);
+    if (nvs_get_blob(m_nvs, key.name, buf, &length) != ESP_OK)
+    {
+        return true;
+    }
+
+    switch (key.type)
+    {
+    case TLV_F32:
+    {
+        float v;
+        if (length != sizeof(v))
+        {
+            return false;
+        }
+        memcpy(&v, buf, sizeof(v));
+        return setFloat(key.id, v, false);
+    }
 
-// parseCmd 함수 구현
-void Config::parseCmd(std::vector<String> &tokens, JsonDocument &_res_doc)
+    case TLV_STR:
+    {
+        char text[CONFIG_TEXT_MAX + 1];
+        if (length > CONFIG_TEXT_MAX)
+        {
+            return false;
+        }
+        memcpy(text, buf, length);
+        text[length] = 0;
+        return setText(key.id, text, false);
+    }
+
+    case TLV_I32A:
+    {
+        int32_t values[CONFIG_LIST_MAX];
+        if (length % sizeof(int32_t) != 0 || length > sizeof(values))
+        {
+            return false;
+        }
+        memcpy(values, buf, length);
+        return setInts(key.id, values, length / sizeof(int32_t), false);
+    }
+
+    case TLV_POS:
+    {
+        float values[CONFIG_LIST_MAX * 3];
+        if (length < 1 || (buf[0] != 2 && buf[0] != 3) || (length - 1) % (sizeof(float) * buf[0]) != 0)
+        {
+            return false;
+        }
+        memcpy(values, buf + 1, length - 1);
+        return setPos(key.id, buf[0], values, (length - 1) / (sizeof(float) * buf[0]), false);
+    }
+
+    default:
+        return false;
+    }
+}
+
+// values -> NVS 값 (BLE 제어 TLV 값과 같은 인코딩), m_mux 안에서 부른다.
+size_t Config::encode(const Key &key, uint8_t *out) const
 {
-    int _tokienCount = tokens.size();
+    switch (key.type)
+    {
+    case TLV_I32:
+    case TLV_F32:
+        memcpy(out, &field<int32_t>(key), sizeof(int32_t));
+        return sizeof(int32_t);
+
+    case TLV_STR:
+    {
+        size_t length = strlen(&field<char>(key));
+        memcpy(out, &field<char>(key), length);
+        return length;
+    }
+
+    case TLV_I32A:
+    {
+        const configSchema::IntList &list = field<configSchema::IntList>(key);
+        memcpy(out, list.v, sizeof(int32_t) * list.count);
+        return sizeof(int32_t) * list.count;
+    }
 
-    if (_tokienCount > 1)
+    case TLV_POS:
     {
-        String subCmd = tokens[1];
-        if (subCmd == "load")
+        const configSchema::PosList &list = field<configSchema::PosList>(key);
+        size_t length = 1;
+        out[0] = list.dim;
+        for (int i = 0; i < list.count; i++)
         {
-            load();
-            _res_doc["result"] = "ok";
-            _res_doc["ms"] = "config loaded";
+            memcpy(out + length, list.v[i], sizeof(float) * list.dim);
+            length += sizeof(float) * list.dim;
         }
-        else if (subCmd == "save")
+        return length;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+// 예전 EEPROM JSON 을 NVS 로 한 번 옮긴다. (EEPROM 은 그대로 둔다)
+bool Config::migrateEeprom()
+{
+    char buffer[EEPROM_SIZE + 1];
+    for (size_t i = 0; i < EEPROM_SIZE; ++i)
+    {
+        buffer[i] = EEPROM.read(i);
+    }
+    buffer[EEPROM_SIZE] = 0;
+
+#ifdef DEBUG
+    Serial.println("data length: " + String(strlen(buffer))); // debug
+    Serial.println("data: " + String(buffer));                // debug
+#endif
+
+    // if empty, set default
+    int migrated = 0;
+    if (buffer[0] == '{')
+    {
+        JsonDocument doc;
+        DeserializationError error = deserializeJson(doc, (const char *)buffer);
+        if (error)
         {
-            save();
-            _res_doc["result"] = "ok";
-            _res_doc["ms"] = "config saved";
+            DLOG_E(CONFIG, "eeprom json : deserializeJson() failed: %s", error.c_str());
         }
-        else if (subCmd == "dump")
+        else
         {
-            String jsonStr = dump();
-            DeserializationError error = deserializeJson(_res_doc["ms"], jsonStr);
-            if (error)
+            for (JsonPair kv : doc.as<JsonObject>())
             {
-                _res_doc["result"] = "fail";
-                _res_doc["ms"] = "json parse error";
+                const Key *key = configSchema::find(kv.key().c_str());
+                if (key == NULL || !setJson(*key, kv.value(), false))
+                {
+                    // JSON 안 문자열은 로그가 나갈 때 없으므로 스키마 이름만
+                    DLOG_W(CONFIG, "eeprom %s ignored", key != NULL ? key->name : "unknown key");
+                }
+                else
+                {
+                    migrated++;
+                }
             }
-            else
+        }
+    }
+
+    // 설정한 key 를 쓰고 버전 표시 (다음 부팅부터는 NVS 만 읽는다)
+    nvs_set_i32(m_nvs, CONFIG_NVS_VERSION_KEY, SystemVersion);
+    bool ok = flush();
+    DLOG_I(CONFIG, "%d keys migrated from EEPROM", migrated);
+    return ok;
+}
+
+void Config::load()
+{
+    uint32_t start = micros();
+
+    portENTER_CRITICAL(&m_mux);
+    defaults();
+    m_dirty = 0;
+    portEXIT_CRITICAL(&m_mux);
+
+    if (openNvs())
+    {
+        int32_t version = 0;
+        if (nvs_get_i32(m_nvs, CONFIG_NVS_VERSION_KEY, &version) != ESP_OK)
+        {
+            migrateEeprom();
+        }
+        else
+        {
+            for (const Key &key : configSchema::keys)
             {
-                _res_doc["result"] = "ok";
+                if (!readKey(key))
+                {
+                    DLOG_W(CONFIG, "%s ignored", key.name);
+                }
             }
+            // 읽은 값은 이미 저장된 값
+            portENTER_CRITICAL(&m_mux);
+            m_dirty = 0;
+            portEXIT_CRITICAL(&m_mux);
+        }
+    }
+
+    m_loadUs = micros() - start;
+}
+
+// dirty key 를 NVS 에 쓰고 commit 한 번 (commit 태스크, 또는 태스크 시작 전 호출한 태스크)
+bool Config::flush()
+{
+    if (!openNvs())
+    {
+        return false;
+    }
+
+    portENTER_CRITICAL(&m_mux);
+    uint32_t dirty = m_dirty;
+    m_dirty = 0;
+    portEXIT_CRITICAL(&m_mux);
+    if (dirty == 0)
+    {
+        return true;
+    }
+
+    uint32_t start = micros();
+    uint32_t failed = 0;
+    for (const Key &key : configSchema::keys)
+    {
+        uint32_t bit = 1UL << key.id;
+        if ((dirty & bit) == 0)
+        {
+            continue;
         }
-        else if (subCmd == "clear")
+
+        // 값만 복사하고 플래시 쓰기는 락 밖에서
+        uint8_t buf[CONFIG_VALUE_MAX];
+        size_t length = 0;
+        portENTER_CRITICAL(&m_mux);
+        bool present = has(key.id);
+        if (present)
         {
-            clear();
-            _res_doc["result"] = "ok";
-            _res_doc["ms"] = "config cleared";
+            length = encode(key, buf);
         }
-        else if (subCmd == "set")
+        portEXIT_CRITICAL(&m_mux);
+
+        esp_err_t err;
+        if (!present)
         {
-            if (_tokienCount > 2)
+            err = nvs_erase_key(m_nvs, key.name);
+            if (err == ESP_ERR_NVS_NOT_FOUND)
             {
-                String key = tokens[2];
-                String value = tokens[3];
+                err = ESP_OK;
+            }
+        }
+        else if (key.type == TLV_I32)
+        {
+            int32_t v;
+            memcpy(&v, buf, sizeof(v));
+            err = nvs_set_i32(m_nvs, key.name, v);
+        }
+        else
+        {
+            err = nvs_set_blob(m_nvs, key.name, buf, length);
+        }
 
-                if(isNumber(value)){
-                    set(key.c_str(), value.toInt());
-                } else{
-                    set(key.c_str(), value);
-                }
+        if (err != ESP_OK)
+        {
+            DLOG_E(CONFIG, "%s write failed (%s)", key.name, esp_err_to_name(err));
+            failed |= bit;
+        }
+        else
+        {
+            portENTER_CRITICAL(&m_mux);
+            m_stats.keysWritten++;
+            portEXIT_CRITICAL(&m_mux);
+        }
+    }
+
+    esp_err_t err = nvs_commit(m_nvs);
+    if (err != ESP_OK)
+    {
+        DLOG_E(CONFIG, "nvs_commit failed (%s)", esp_err_to_name(err));
+        failed = dirty;
+    }
+    if (failed != 0)
+    {
+        // 다음 commit 에 다시
+        portENTER_CRITICAL(&m_mux);
+        m_dirty |= failed;
+        m_stats.failed += __builtin_popcount(failed);
+        portEXIT_CRITICAL(&m_mux);
+    }
 
-                // set(key.c_str(), value);
+    uint32_t us = micros() - start;
+    portENTER_CRITICAL(&m_mux);
+    m_stats.commits++;
+    m_stats.lastUs = us;
+    if (us > m_stats.maxUs)
+    {
+        m_stats.maxUs = us;
+    }
+    portEXIT_CRITICAL(&m_mux);
+    return failed == 0;
+}
 
-                _res_doc["result"] = "ok";
-                _res_doc["ms"] = "config set";
-            }
-            else
+static void commitTask(void *param)
+{
+    ((Config *)param)->commitLoop();
+}
+
+void Config::commitLoop()
+{
+    while (true)
+    {
+        // 예약된 commit 이 있으면 그 시각까지만 기다린다. (그 사이 set 이 오면 다시 미뤄진다)
+        TickType_t wait = portMAX_DELAY;
+        if (m_commitPending)
+        {
+            int32_t remain = (int32_t)(m_commitAtMs - millis());
+            wait = remain <= 0 ? 0 : pdMS_TO_TICKS(remain) + 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        bool forced = m_forced;
+        if (forced || (m_commitPending && (int32_t)(millis() - m_commitAtMs) >= 0))
+        {
+            m_forced = false;
+            m_commitPending = false;
+            m_flushOk = flush();
+            if (forced)
             {
-                _res_doc["result"] = "fail";
-                _res_doc["ms"] = "need key and value";
+                xSemaphoreGive(m_saved);
             }
         }
-        else if (subCmd == "setA")
-        { // set json array
-            if (_tokienCount > 2)
-            {
-                String key = tokens[2];
-                String value = tokens[3];
+    }
+}
+
+void Config::startCommitTask()
+{
+    if (m_commitTask != NULL)
+    {
+        return;
+    }
+    m_saved = xSemaphoreCreateBinary();
+    // 코어 0, 낮은 우선순위 : 플래시 쓰기가 캡처(코어 1) 와 BLE 전송보다 뒤
+    xTaskCreatePinnedToCore(commitTask, "cfgCommit", 4096, this, 1, &m_commitTask, 0);
+    if (m_commitPending)
+    {
+        xTaskNotifyGive(m_commitTask);
+    }
+}
 
-                // parse json value
-                //  JSON 문자열 파싱을 위한 임시 객체
-                JsonDocument tempDoc; // 임시 JSON 문서
+bool Config::save()
+{
+    if (m_commitTask == NULL || xTaskGetCurrentTaskHandle() == m_commitTask)
+    {
+        return flush();
+    }
 
-                // JSON 문자열 파싱
-                DeserializationError error = deserializeJson(tempDoc, value);
+    // 남아 있는 신호를 비우고 바로 commit 요청
+    xSemaphoreTake(m_saved, 0);
+    m_forced = true;
+    xTaskNotifyGive(m_commitTask);
+    if (xSemaphoreTake(m_saved, pdMS_TO_TICKS(2000)) != pdTRUE)
+    {
+        DLOG_E(CONFIG, "save timeout");
+        return false;
+    }
+    return m_flushOk;
+}
 
-                if (error)
-                {
-                    _res_doc["result"] = "fail";
-                    _res_doc["ms"] = "json parse error";
-                }
-                else
+void Config::clear()
+{
+    portENTER_CRITICAL(&m_mux);
+    defaults();
+    m_dirty = allKeys();
+    portEXIT_CRITICAL(&m_mux);
+    save();
+}
+
+void Config::getCommitStats(CommitStats &stats) const
+{
+    portENTER_CRITICAL(&m_mux);
+    stats = m_stats;
+    stats.dirty = m_dirty;
+    portEXIT_CRITICAL(&m_mux);
+}
+
+size_t Config::copyValue(const Key &key, uint8_t *out) const
+{
+    portENTER_CRITICAL(&m_mux);
+    size_t length = encode(key, out);
+    portEXIT_CRITICAL(&m_mux);
+    return length;
+}
+
+//------------------------------------------------ typed set
+// 조용한 시간 뒤 commit (그 사이 또 바뀌면 다시 미룬다)
+void Config::schedule()
+{
+    m_commitAtMs = millis() + CONFIG_COMMIT_QUIET_MS;
+    m_commitPending = true;
+    if (m_commitTask != NULL)
+    {
+        xTaskNotifyGive(m_commitTask);
+    }
+}
+
+// 값은 m_mux 안에서 바꾼다. (commit 태스크가 다른 코어에서 복사 중일 수 있다)
+void Config::mark(const Key &key, bool commit)
+{
+    portENTER_CRITICAL(&m_mux);
+    m_present |= 1UL << key.id;
+    m_dirty |= 1UL << key.id;
+    portEXIT_CRITICAL(&m_mux);
+    if (commit)
+    {
+        schedule();
+    }
+}
+
+bool Config::setInt(uint8_t id, int32_t value, bool commit)
+{
+    const Key *key = configSchema::find(id);
+    if (key == NULL || key->type != TLV_I32 || value < key->min || value > key->max)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&m_mux);
+    field<int32_t>(*key) = value;
+    portEXIT_CRITICAL(&m_mux);
+    mark(*key, commit);
+    return true;
+}
+
+bool Config::setFloat(uint8_t id, float value, bool commit)
+{
+    const Key *key = configSchema::find(id);
+    if (key == NULL || key->type != TLV_F32 || !(value >= key->min && value <= key->max))
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&m_mux);
+    field<float>(*key) = value;
+    portEXIT_CRITICAL(&m_mux);
+    mark(*key, commit);
+    return true;
+}
+
+bool Config::setText(uint8_t id, const char *text, bool commit)
+{
+    const Key *key = configSchema::find(id);
+    int32_t length = text != NULL ? strlen(text) : 0;
+    if (key == NULL || key->type != TLV_STR || length < key->min || length > key->max)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&m_mux);
+    char *out = &field<char>(*key);
+    memcpy(out, text, length);
+    out[length] = 0;
+    portEXIT_CRITICAL(&m_mux);
+    mark(*key, commit);
+    return true;
+}
+
+bool Config::setInts(uint8_t id, const int32_t *values, int count, bool commit)
+{
+    const Key *key = configSchema::find(id);
+    if (key == NULL || key->type != TLV_I32A || count < key->min || count > key->max)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&m_mux);
+    configSchema::IntList &list = field<configSchema::IntList>(*key);
+    memcpy(list.v, values, sizeof(int32_t) * count);
+    list.count = count;
+    portEXIT_CRITICAL(&m_mux);
+    mark(*key, commit);
+    return true;
+}
+
+bool Config::setPos(uint8_t id, uint8_t dim, const float *values, int rows, bool commit)
+{
+    const Key *key = configSchema::find(id);
+    if (key == NULL || key->type != TLV_POS || (dim != 2 && dim != 3) || rows < key->min || rows > key->max)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&m_mux);
+    configSchema::PosList &list = field<configSchema::PosList>(*key);
+    memset(list.v, 0, sizeof(list.v));
+    for (int i = 0; i < rows; i++)
+    {
+        memcpy(list.v[i], values + i * dim, sizeof(float) * dim);
+    }
+    list.count = rows;
+    list.dim = dim;
+    portEXIT_CRITICAL(&m_mux);
+    mark(*key, commit);
+    return true;
+}
+
+void Config::reset(uint8_t id, bool commit)
+{
+    const Key *key = configSchema::find(id);
+    if (key == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&m_mux);
+    setDefault(*key);
+    m_present &= ~(1UL << key->id);
+    m_dirty |= 1UL << key->id;
+    portEXIT_CRITICAL(&m_mux);
+    if (commit)
+    {
+        schedule();
+    }
+}
+
+//------------------------------------------------ JSON import / export
+static bool isNumber(JsonVariantConst value)
+{
+    return value.is<int>() || value.is<float>();
+}
+
+bool Config::setJson(const Key &key, JsonVariantConst value, bool commit)
+{
+    switch (key.type)
+    {
+    case TLV_I32:
+        return isNumber(value) && setInt(key.id, value.as<int32_t>(), commit);
+
+    case TLV_F32:
+        return isNumber(value) && setFloat(key.id, value.as<float>(), commit);
+
+    case TLV_STR:
+        return value.is<const char *>() && setText(key.id, value.as<const char *>(), commit);
+
+    case TLV_I32A:
+    {
+        if (!value.is<JsonArrayConst>())
+        {
+            return false;
+        }
+        int32_t values[CONFIG_LIST_MAX];
+        int count = 0;
+        for (JsonVariantConst v : value.as<JsonArrayConst>())
+        {
+            if (count >= CONFIG_LIST_MAX || !isNumber(v))
+            {
+                return false;
+            }
+            values[count++] = v.as<int32_t>();
+        }
+        return setInts(key.id, values, count, commit);
+    }
+
+    case TLV_POS:
+    {
+        // [[x,y],...] 또는 [[x,y,z],...], 2차원 좌표가 섞여 있으면 z = 0
+        if (!value.is<JsonArrayConst>())
+        {
+            return false;
+        }
+        float values[CONFIG_LIST_MAX][3] = {};
+        int rows = 0;
+        uint8_t dim = 2;
+        for (JsonVariantConst row : value.as<JsonArrayConst>())
+        {
+            if (rows >= CONFIG_LIST_MAX || !row.is<JsonArrayConst>())
+            {
+                return false;
+            }
+            int k = 0;
+            for (JsonVariantConst v : row.as<JsonArrayConst>())
+            {
+                if (k >= 3 || !isNumber(v))
                 {
-                    // JsonArray array = tempDoc[key].as<JsonArray>();
-                    set(key.c_str(), tempDoc);
-                    _res_doc["result"] = "ok";
-                    _res_doc["ms"] = tempDoc;
+                    return false;
                 }
+                values[rows][k++] = v.as<float>();
             }
-            else
+            if (k < 2)
             {
-                _res_doc["result"] = "fail";
-                _res_doc["ms"] = "need key and value";
+                return false;
             }
+            if (k == 3)
+            {
+                dim = 3;
+            }
+            rows++;
         }
-        else if (subCmd == "get")
+        if (dim == 2)
         {
-            if (_tokienCount > 2)
+            // setPos 는 dim 개씩 붙어 있는 배열을 받는다.
+            float packed[CONFIG_LIST_MAX * 2];
+            for (int i = 0; i < rows; i++)
             {
-                String key = tokens[2];
-
-                // check key exist
-                if (!hasKey(key.c_str()))
-                {
-                    _res_doc["result"] = "fail";
-                    _res_doc["ms"] = "key not exist";
-                }
-                else
-                {
-                    _res_doc["result"] = "ok";
-                    _res_doc["value"] = get<String>(key.c_str());
-                }
+                packed[i * 2] = values[i][0];
+                packed[i * 2 + 1] = values[i][1];
             }
-            else
+            return setPos(key.id, 2, packed, rows, commit);
+        }
+        return setPos(key.id, 3, &values[0][0], rows, commit);
+    }
+
+    default:
+        return false;
+    }
+}
+
+void Config::getJson(const Key &key, JsonVariant out) const
+{
+    switch (key.type)
+    {
+    case TLV_I32:
+        out.set(field<int32_t>(key));
+        break;
+
+    case TLV_F32:
+        out.set(field<float>(key));
+        break;
+
+    case TLV_STR:
+        out.set((const char *)&field<char>(key));
+        break;
+
+    case TLV_I32A:
+    {
+        const configSchema::IntList &list = field<configSchema::IntList>(key);
+        JsonArray array = out.to<JsonArray>();
+        for (int i = 0; i < list.count; i++)
+        {
+            array.add(list.v[i]);
+        }
+    }
+    break;
+
+    case TLV_POS:
+    {
+        const configSchema::PosList &list = field<configSchema::PosList>(key);
+        JsonArray array = out.to<JsonArray>();
+        for (int i = 0; i < list.count; i++)
+        {
+            JsonArray row = array.add<JsonArray>();
+            for (int k = 0; k < list.dim; k++)
             {
-                _res_doc["result"] = "fail";
-                _res_doc["ms"] = "need key";
+                row.add(list.v[i][k]);
             }
         }
-        else
+    }
+    break;
+
+    default:
+        break;
+    }
+}
+
+void Config::dump(JsonObject out) const
+{
+    for (const Key &key : configSchema::keys)
+    {
+        if (has(key.id))
         {
-            _res_doc["result"] = "fail";
-            _res_doc["ms"] = "unknown sub command";
+            getJson(key, out[key.name].to<JsonVariant>());
         }
     }
+}
+
+//------------------------------------------------ serial command
+// config <sub> ... : 하위 명령 표 (이름순)
+typedef void (*ConfigHandler)(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc);
+
+static void configClear(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    config.clear();
+    _res_doc["result"] = "ok";
+    _res_doc["ms"] = "config cleared";
+}
+
+static void configDump(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    config.dump(_res_doc["ms"].to<JsonObject>());
+    _res_doc["result"] = "ok";
+}
+
+static void configGet(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    if (tokens.count() <= 2)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "need key";
+        return;
+    }
+
+    // check key exist
+    const Key *key = configSchema::find(tokens.get(2));
+    if (key == NULL || !config.has(key->id))
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "key not exist";
+        return;
+    }
+    _res_doc["result"] = "ok";
+    config.getJson(*key, _res_doc["value"].to<JsonVariant>());
+}
+
+static void configLoad(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    config.load();
+    _res_doc["result"] = "ok";
+    _res_doc["ms"] = "config loaded";
+}
+
+static void configSave(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    if (config.save())
+    {
+        _res_doc["result"] = "ok";
+        _res_doc["ms"] = "config saved";
+    }
+    else
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "nvs write failed";
+    }
+}
+
+// set : 숫자 또는 문자열, setA : JSON 배열 (set 도 JSON 배열을 받는다)
+static void configSet(Config &config, const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    if (tokens.count() <= 3)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "need key and value";
+        return;
+    }
+
+    const Key *key = configSchema::find(tokens.get(2));
+    const char *value = tokens.get(3);
+    if (key == NULL)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "unknown key";
+        return;
+    }
+
+    // 문자열은 토큰 그대로, 나머지는 JSON 으로 읽는다.
+    bool ok;
+    if (key->type == TLV_STR)
+    {
+        ok = config.setText(key->id, value);
+    }
     else
+    {
+        JsonDocument tempDoc(&g_cmdJsonPool);
+        if (deserializeJson(tempDoc, value))
+        {
+            _res_doc["result"] = "fail";
+            _res_doc["ms"] = "json parse error";
+            return;
+        }
+        ok = config.setJson(*key, tempDoc.as<JsonVariantConst>());
+    }
+
+    if (!ok)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "bad value";
+        _res_doc["min"] = key->min;
+        _res_doc["max"] = key->max;
+        return;
+    }
+    _res_doc["result"] = "ok";
+    _res_doc["ms"] = "config set";
+}
+
+static constexpr CmdEntry<ConfigHandler> s_configCommands[] = {
+    {"clear", configClear},
+    {"dump", configDump},
+    {"get", configGet},
+    {"load", configLoad},
+    {"save", configSave},
+    {"set", configSet},
+    {"setA", configSet},
+};
+CMD_TABLE_SORTED(s_configCommands);
+
+void Config::parseCmd(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    if (tokens.count() <= 1)
     {
         _res_doc["result"] = "fail";
         _res_doc["ms"] = "need sub command";
+        return;
+    }
+
+    const CmdEntry<ConfigHandler> *cmd = cmdFind(s_configCommands, tokens.get(1));
+    if (cmd == NULL)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "unknown sub command";
+        return;
     }
+    cmd->handler(*this, tokens, _res_doc);
 }
@@ -4,10 +4,25 @@
 #include <ArduinoJson.h>
 #include <EEPROM.h>
 
-#include <vector>
-
 #ifdef ESP32
 #include <nvs_flash.h>
+#include <nvs.h>
+#endif
+
+#include "configSchema.hpp"
+#include "cmdLine.hpp"
+
+// 설정 : 값은 configSchema::Values 에 타입 그대로 들고 있다. (읽기는 values().필드)
+// 저장은 NVS (namespace CONFIG_NVS_NAMESPACE) 에 key 마다 따로 한다.
+// 바뀐 key 는 dirty 비트만 켜고, 코어 0 의 낮은 우선순위 태스크가 조용한 시간(CONFIG_COMMIT_QUIET_MS) 뒤
+// 모아서 쓴다. save() 는 기다리지 않고 바로 쓰게 한다. 캡처 태스크는 플래시 쓰기를 기다리지 않는다.
+// 예전 EEPROM JSON 은 NVS 가 비어 있을 때 한 번 옮겨 온다.
+
+#define CONFIG_NVS_NAMESPACE "bbcfg"
+#define CONFIG_NVS_VERSION_KEY "_ver"
+// 마지막 set 뒤 이만큼 조용하면 commit
+#ifndef CONFIG_COMMIT_QUIET_MS
+#define CONFIG_COMMIT_QUIET_MS 2000
 #endif
 
 class Config
@@ -25,7 +40,6 @@ public:
     static const size_t EEPROM_SIZE = 512;
     static const int EEPROM_START_ADDRESS = 0;
 #endif
-    String jsonDoc;
 
     Config()
     {
@@ -46,159 +60,116 @@ public:
         EEPROM.begin(EEPROM_SIZE);
 #endif
 
-        load();
+        // 읽기는 setup() 의 load() 한 번 (loadUs 가 부팅 때 읽은 시간), 그 전에는 스키마 기본값
+        defaults();
     }
 
-    void load()
-    {
-        char buffer[EEPROM_SIZE];
-        for (size_t i = 0; i < EEPROM_SIZE; ++i)
-        {
-            buffer[i] = EEPROM.read(i);
-#ifdef DEBUG
-            Serial.print(buffer[i]); // debug
-#endif
-        }
+    // NVS -> values (없거나 범위 밖 값은 기본값), 저장하지 않은 변경은 버린다. 부팅 때는 setup() 에서 한 번
+    void load();
+    // dirty key 를 지금 NVS 에 쓴다. commit 태스크가 돌고 있으면 그 태스크가 쓰고 끝날 때까지 기다린다.
+    bool save();
+    // 코어 0 commit 태스크 시작 (setup 에서 한 번, 그 전의 save() 는 호출한 태스크가 직접 쓴다)
+    void startCommitTask();
 
-#ifdef DEBUG
-        Serial.println("data length: " + String(strlen(buffer))); // debug
-        Serial.println("data: " + String(buffer));                // debug
-#endif
-        // if empty, set default
-        if (buffer[0] != '{' && buffer[0] != '[')
-        {
-            jsonDoc = "{}";
-        }
-        else
-        {
-            jsonDoc = String(buffer);
-        }
-    }
-
-    void save()
+    // commit 통계 (serial stats 명령으로 출력)
+    struct CommitStats
     {
-        for (size_t i = 0; i < EEPROM_SIZE; ++i)
-        {
-            if (i < jsonDoc.length())
-            {
-                EEPROM.write(i, jsonDoc[i]);
-            }
-            else
-            {
-                EEPROM.write(i, 0);
-            }
-        }
-
-#ifdef DEBUG
-        Serial.println("data length: " + String(jsonDoc.length())); // debug
-        Serial.println("data: " + jsonDoc);                         // debug
-#endif
-
-#ifdef AVR
-
-#else
-
-        EEPROM.commit();
-#endif
-    }
-
-    // Generic set and get
-    template <typename T>
-    void set(const char *key, T value)
+        uint32_t commits;     // nvs_commit 수
+        uint32_t keysWritten; // 쓰거나 지운 key 수
+        uint32_t lastUs;      // 마지막 commit 시간
+        uint32_t maxUs;
+        uint32_t failed;      // 실패한 key 쓰기 (dirty 로 남겨 다음에 다시)
+        uint32_t dirty;       // 아직 쓰지 않은 key (id 비트마스크)
+    };
+    void getCommitStats(CommitStats &stats) const;
+
+    // 타입 있는 설정 값 (잠금 없음)
+    // - 정수/실수 key 는 한 워드라 어느 태스크에서든 hot path 에서 읽어도 된다.
+    // - 배열/문자열 key 는 설정하는 앱 태스크(시리얼 명령, BLE 제어)에서만 바로 읽는다.
+    //   다른 태스크는 copyValue 로 잠금 안에서 복사한다. (쓰는 중간 값을 보지 않게)
+    inline const configSchema::Values &values() const
     {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, jsonDoc);
-        if (error)
-        {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            return;
-        }
-
-        doc[key] = value;
-        serializeJson(doc, jsonDoc);
-        save();
+        return m_values;
     }
 
-    template <typename T>
-    T get(const char *key, T defaultValue = T()) const
-    {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, jsonDoc);
-        if (error)
-        {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            return defaultValue;
-        }
+    // key 값 하나를 저장/TLV 형식으로 잠금 안에서 복사한다. (out 은 CONFIG_VALUE_MAX 바이트, 반환 = 길이)
+    size_t copyValue(const configSchema::Key &key, uint8_t *out) const;
 
-        // Use the new API to check if the key exists and has the correct type
-        if (!doc[key].is<T>())
-        {
-            return defaultValue;
-        }
-
-        return doc[key].as<T>();
-    }
-
-    // check key exist
-    inline bool hasKey(const char *key) const
+    // key 가 설정되어 있는지 (아니면 values() 는 스키마 기본값)
+    inline bool has(uint8_t id) const
     {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, jsonDoc);
-        if (error)
-        {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            return false;
-        }
-
-        // return doc.containsKey(key);
-        return doc[key].is<JsonVariant>(); // 원하는 타입으로 변경 가능 (예: is<int>(), is<char*>(), is<String>(), 등)
+        return id < 32 && (m_present & (1UL << id)) != 0;
     }
 
-    inline void getArray(const char *key, JsonDocument &_doc) const
+    // 타입별 설정 : 스키마의 타입/범위와 맞지 않으면 false (바꾸지 않음)
+    // commit 이 true 면 조용한 시간 뒤 commit 태스크가 저장, false 면 메모리에만 (save() 나 다음 commit 때 같이)
+    bool setInt(uint8_t id, int32_t value, bool commit = true);
+    bool setFloat(uint8_t id, float value, bool commit = true);
+    bool setText(uint8_t id, const char *text, bool commit = true);
+    bool setInts(uint8_t id, const int32_t *values, int count, bool commit = true);
+    bool setPos(uint8_t id, uint8_t dim, const float *values, int rows, bool commit = true);
+    // 기본값으로 (설정 없음)
+    void reset(uint8_t id, bool commit = true);
+
+    // JSON 입출력 (config set / setA / get / dump, 저장 형식)
+    bool setJson(const configSchema::Key &key, JsonVariantConst value, bool commit = true);
+    void getJson(const configSchema::Key &key, JsonVariant out) const;
+    void dump(JsonObject out) const;
+
+    // 모든 key 를 기본값으로 (NVS 에서도 지운다)
+    void clear();
+
+    // 마지막 load() 에 걸린 시간 (NVS 읽기, 처음 한 번은 EEPROM JSON 옮기기 포함, us)
+    inline uint32_t loadUs() const
     {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, jsonDoc);
-
-        Serial.println(doc[key].as<String>());
-
-        if (error)
-        {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            // return JsonArray();
-        }
-
-        JsonDocument tempDoc;
-
-        error = deserializeJson(_doc, doc[key].as<String>());
-        if (error)
-        {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            // return JsonArray();
-        }
-
-        Serial.println(_doc.as<JsonArray>().size());
+        return m_loadUs;
     }
 
-    inline String dump() const
+    // 시리얼 config 명령 (tokens[0] = "config", tokens[1] = 하위 명령)
+    void parseCmd(const CmdTokens &tokens, JsonDocument &_res_doc);
+
+    // commit 태스크 본체 (startCommitTask 전용)
+    void commitLoop();
+
+private:
+    configSchema::Values m_values;
+    uint32_t m_present = 0;
+    uint32_t m_loadUs = 0;
+
+    // dirty 비트, 값 복사, commit 통계는 m_mux 안에서 (설정하는 앱 태스크와 commit 태스크가 다른 코어)
+    mutable portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+    volatile uint32_t m_dirty = 0;
+    volatile uint32_t m_commitAtMs = 0;
+    volatile bool m_commitPending = false; // 조용한 시간 뒤 commit 예약
+    volatile bool m_forced = false;        // save() : 바로
+    volatile bool m_flushOk = true;        // 마지막 commit 결과 (save() 반환값)
+    TaskHandle_t m_commitTask = NULL;
+    SemaphoreHandle_t m_saved = NULL;      // save() 에 commit 끝을 알림
+    nvs_handle_t m_nvs = 0;
+    bool m_nvsOpen = false;
+    CommitStats m_stats = {};
+
+    void defaults();
+    void setDefault(const configSchema::Key &key);
+    void mark(const configSchema::Key &key, bool commit);
+    void schedule();
+    bool openNvs();
+    bool migrateEeprom();
+    bool readKey(const configSchema::Key &key);
+    size_t encode(const configSchema::Key &key, uint8_t *out) const;
+    bool flush();
+
+    template <typename T>
+    inline T &field(const configSchema::Key &key)
     {
-        return jsonDoc;
+        return *(T *)((uint8_t *)&m_values + key.offset);
     }
 
-    inline void clear()
+    template <typename T>
+    inline const T &field(const configSchema::Key &key) const
     {
-        jsonDoc = "{}";
-        save();
+        return *(const T *)((const uint8_t *)&m_values + key.offset);
     }
-
-    // 토크나이저를 인자로 받아 명령어를 파싱하고 처리하는 함수
-    void parseCmd(std::vector<String> &tokens, JsonDocument &_res_doc);
-    
-
 };
 
 #endif // CONFIG_HPP
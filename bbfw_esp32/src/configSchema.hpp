@@ -0,0 +1,172 @@
+#ifndef CONFIGSCHEMA_HPP
+#define CONFIGSCHEMA_HPP
+
+#include <Arduino.h>
+
+#include <stddef.h>
+
+#include "packet.hpp"
+#include "dataCapture.hpp"
+#include "adcCapture.hpp"
+#include "serialStream.hpp"
+
+// 설정 스키마 : key 이름, 타입, 기본값, 범위를 컴파일 시간 표 하나로 정한다.
+// 값은 RAM 의 Values 구조체에 타입 그대로 들어 있고 읽기는 필드 로드 한 번이다. (g_config.values())
+// 저장은 key 이름으로 NVS 에 따로 (config.hpp), JSON 은 config dump / set / setA 의 입출력에만 쓴다.
+//
+// key id 는 BLE 제어 특성의 key id (packet.hpp BleCtlKey) 와 같고, 타입은 TLV 타입을 그대로 쓴다.
+// key 를 추가하려면 Values 필드, BleCtlKey, keys[] 에 한 줄씩.
+
+namespace configSchema {
+
+// 배열 key 의 최대 개수 (센서 핀, ADC 핀, 보정값, 좌표)
+#define CONFIG_LIST_MAX (MAX_CHANNELS > ADC_MAX_CHANNELS ? MAX_CHANNELS : ADC_MAX_CHANNELS)
+// 문자열 key 의 최대 길이 (널 제외)
+#define CONFIG_TEXT_MAX 15
+// 저장/TLV 형식 값 하나의 최대 바이트 (좌표 : 차원 1 + float 3 x 개수)
+#define CONFIG_VALUE_MAX (1 + sizeof(float) * 3 * CONFIG_LIST_MAX)
+
+struct IntList
+{
+    uint8_t count; // 0 = 설정 없음
+    int32_t v[CONFIG_LIST_MAX];
+};
+
+struct PosList
+{
+    uint8_t count; // 0 = 설정 없음
+    uint8_t dim;   // 2 또는 3 (2차원이면 z = 0)
+    float v[CONFIG_LIST_MAX][3];
+};
+
+// 필드 이름 = config key 이름
+struct Values
+{
+    int32_t ch_num;
+    IntList sensorPins;
+    int32_t detect_delay;
+    float aperture_mm;
+    float sound_speed;
+    char capture_mode[CONFIG_TEXT_MAX + 1];
+    int32_t poll_burst_us;
+    IntList adcPins;
+    int32_t adc_rate;
+    int32_t adc_pre;
+    int32_t adc_post;
+    int32_t adc_threshold;
+    int32_t gcc_phat;
+    PosList sensorPos;
+    IntList cal_offsets;
+    int32_t cal_pin;
+    int32_t bench_pin;
+    int32_t ble_batch_ms;
+    int32_t ble_batch_fill;
+    int32_t ble_tick_shift;
+    int32_t ble_broadcast;
+    int32_t ble_history;
+    int32_t stream_binary;
+    int32_t stream_baud;
+    int32_t ring_holdoff_us;
+};
+
+// 범위 : 숫자는 값, 문자열은 길이, 배열은 개수
+struct Key
+{
+    uint8_t id;
+    const char *name;
+    BleTlvType type;
+    int32_t min;
+    int32_t max;
+    float def;        // 숫자 기본값 (배열은 기본 없음)
+    const char *text; // 문자열 기본값
+    uint16_t offset;  // Values 안 위치
+};
+
+#define CONFIG_KEY(id, field, type, lo, hi, def) {id, #field, type, lo, hi, def, NULL, offsetof(Values, field)}
+#define CONFIG_TEXT(id, field, hi, text) {id, #field, TLV_STR, 1, hi, 0, text, offsetof(Values, field)}
+
+constexpr Key keys[] = {
+    CONFIG_KEY(KEY_CH_NUM, ch_num, TLV_I32, 1, MAX_CHANNELS, 2),
+    CONFIG_KEY(KEY_SENSOR_PINS, sensorPins, TLV_I32A, 1, MAX_CHANNELS, 0),
+    CONFIG_KEY(KEY_DETECT_DELAY, detect_delay, TLV_I32, 0, 60000, 0),
+    CONFIG_KEY(KEY_APERTURE_MM, aperture_mm, TLV_F32, 1, 100000, DEFAULT_APERTURE_M * 1000.0f),
+    CONFIG_KEY(KEY_SOUND_SPEED, sound_speed, TLV_F32, 100, 2000, DEFAULT_SOUND_SPEED),
+    CONFIG_TEXT(KEY_CAPTURE_MODE, capture_mode, CONFIG_TEXT_MAX, "edge"),
+    CONFIG_KEY(KEY_POLL_BURST_US, poll_burst_us, TLV_I32, 0, 100000, 1000),
+    CONFIG_KEY(KEY_ADC_PINS, adcPins, TLV_I32A, 1, ADC_MAX_CHANNELS, 0),
+    CONFIG_KEY(KEY_ADC_RATE, adc_rate, TLV_I32, 1000, 2000000, 50000),
+    CONFIG_KEY(KEY_ADC_PRE, adc_pre, TLV_I32, 0, 65536, 512),
+    CONFIG_KEY(KEY_ADC_POST, adc_post, TLV_I32, 1, 65536, 1536),
+    CONFIG_KEY(KEY_ADC_THRESHOLD, adc_threshold, TLV_I32, 0, 4095, 50),
+    CONFIG_KEY(KEY_GCC_PHAT, gcc_phat, TLV_I32, 0, 1, 1),
+    CONFIG_KEY(KEY_SENSOR_POS, sensorPos, TLV_POS, 1, MAX_CHANNELS, 0),
+    CONFIG_KEY(KEY_CAL_OFFSETS, cal_offsets, TLV_I32A, 1, MAX_CHANNELS, 0),
+    CONFIG_KEY(KEY_CAL_PIN, cal_pin, TLV_I32, -1, 39, -1),
+    CONFIG_KEY(KEY_BENCH_PIN, bench_pin, TLV_I32, -1, 39, -1),
+    CONFIG_KEY(KEY_BLE_BATCH_MS, ble_batch_ms, TLV_I32, 0, 1000, 20),
+    CONFIG_KEY(KEY_BLE_BATCH_FILL, ble_batch_fill, TLV_I32, 0, 255, 0),
+    CONFIG_KEY(KEY_BLE_TICK_SHIFT, ble_tick_shift, TLV_I32, 0, 16, 8),
+    CONFIG_KEY(KEY_BLE_BROADCAST, ble_broadcast, TLV_I32, 0, 1, 0),
+    CONFIG_KEY(KEY_BLE_HISTORY, ble_history, TLV_I32, 0, 8192, 256),
+    CONFIG_KEY(KEY_STREAM_BINARY, stream_binary, TLV_I32, 0, 1, 0),
+    CONFIG_KEY(KEY_STREAM_BAUD, stream_baud, TLV_I32, STREAM_MIN_BAUD, STREAM_MAX_BAUD, STREAM_DEFAULT_BAUD),
+    CONFIG_KEY(KEY_RING_HOLDOFF_US, ring_holdoff_us, TLV_I32, 0, 10000, DEFAULT_RING_HOLDOFF_US),
+};
+
+#undef CONFIG_KEY
+#undef CONFIG_TEXT
+
+constexpr int count = sizeof(keys) / sizeof(keys[0]);
+
+// 설정 여부는 key id 비트 (Config::has)
+constexpr bool idsFit(int i = 0)
+{
+    return i >= count || (keys[i].id < 32 && idsFit(i + 1));
+}
+static_assert(idsFit(), "config key ids must be < 32 (presence mask)");
+
+// 배열 key 의 개수는 IntList / PosList 에 들어가야 한다.
+constexpr bool listsFit(int i = 0)
+{
+    return i >= count || (((keys[i].type != TLV_I32A && keys[i].type != TLV_POS) || keys[i].max <= CONFIG_LIST_MAX) && listsFit(i + 1));
+}
+static_assert(listsFit(), "config list key max exceeds CONFIG_LIST_MAX");
+
+// key 이름이 NVS key 이름이 된다. (15자까지)
+constexpr int nameLength(const char *name)
+{
+    return *name ? 1 + nameLength(name + 1) : 0;
+}
+constexpr bool namesFit(int i = 0)
+{
+    return i >= count || (nameLength(keys[i].name) <= 15 && namesFit(i + 1));
+}
+static_assert(namesFit(), "config key names must fit NVS key length (15)");
+
+inline const Key *find(uint8_t id)
+{
+    for (const Key &key : keys)
+    {
+        if (key.id == id)
+        {
+            return &key;
+        }
+    }
+    return NULL;
+}
+
+inline const Key *find(const char *name)
+{
+    for (const Key &key : keys)
+    {
+        if (strcmp(key.name, name) == 0)
+        {
+            return &key;
+        }
+    }
+    return NULL;
+}
+
+} // namespace configSchema
+
+#endif // CONFIGSCHEMA_HPP
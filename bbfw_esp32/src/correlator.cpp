@@ -0,0 +1,253 @@
+#include "correlator.hpp"
+
+namespace dataCapture {
+
+// 창이 지난 뒤 ISR 지연으로 늦게 링에 들어오는 에지를 기다리는 기본 여유 (ns)
+static const uint64_t EXPIRE_MARGIN_NS = 200000;
+
+static inline uint64_t distance(timeBase::stamp_t a, timeBase::stamp_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static inline int bitCount(uint32_t v)
+{
+    return __builtin_popcount(v);
+}
+
+template <int N>
+void CorrelatorT<N>::configure(int channels, uint32_t windowNs, uint64_t holdoffNs, uint32_t ringNs)
+{
+    mChannels = channels > N ? N : channels;
+    mFullMask = channelMask(mChannels);
+    mWindowNs = windowNs;
+    mHoldoffNs = holdoffNs;
+    mRingNs = ringNs;
+    if (mLatencyNs == 0)
+    {
+        mLatencyNs = EXPIRE_MARGIN_NS;
+    }
+
+    for (int i = 0; i < EVENT_SLOTS; i++)
+    {
+        mUsed[i] = false;
+    }
+    mDoneHead = 0;
+    mDoneCount = 0;
+    mCh.hasLast = 0;
+    mOpenedOnce = false;
+}
+
+template <int N>
+int CorrelatorT<N>::oldestSlot() const
+{
+    int oldest = -1;
+    for (int i = 0; i < EVENT_SLOTS; i++)
+    {
+        if (mUsed[i] && (oldest < 0 || mOpen[i].seq < mOpen[oldest].seq))
+        {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+template <int N>
+void CorrelatorT<N>::close(int slot)
+{
+    Event &ev = mOpen[slot];
+    mUsed[slot] = false;
+
+    if (bitCount(ev.mask) < 2)
+    {
+        orphan++;
+        return;
+    }
+
+    if (ev.mask == mFullMask)
+    {
+        complete++;
+    }
+    else
+    {
+        partial++;
+    }
+
+    if (mDoneCount == EVENT_DONE_SLOTS)
+    {
+        // 가장 오래된 것을 버린다.
+        mDoneHead = (mDoneHead + 1) % EVENT_DONE_SLOTS;
+        mDoneCount--;
+        dropped++;
+    }
+    mDone[(mDoneHead + mDoneCount) % EVENT_DONE_SLOTS] = ev;
+    mDoneCount++;
+}
+
+template <int N>
+void CorrelatorT<N>::addEdge(const EdgeRecord &edge)
+{
+    int ch = edge.channel;
+    if (ch >= mChannels)
+    {
+        return;
+    }
+    uint32_t bit = 1UL << ch;
+    timeBase::stamp_t t = edge.ns;
+
+    // 같은 채널이 링잉 hold-off 안에서 다시 들어오면 링잉(ringing)으로 보고 버린다.
+    // 그보다 늦은 에지는 다음 충격음일 수 있으므로 아래에서 이 채널이 빈 이벤트에 합치거나 새 이벤트를 연다.
+    if ((mCh.hasLast & bit) && distance(t, mCh.lastNs[ch]) < mRingNs)
+    {
+        ringing++;
+        return;
+    }
+    mCh.lastNs[ch] = t;
+    mCh.hasLast |= bit;
+
+    // 열린 이벤트 중 가장 오래된 것부터, 이 채널이 비어 있고 창 안에 드는 이벤트에 합친다.
+    int target = -1;
+    for (int i = 0; i < EVENT_SLOTS; i++)
+    {
+        if (!mUsed[i] || (mOpen[i].mask & bit))
+        {
+            continue;
+        }
+        const Event &ev = mOpen[i];
+        timeBase::stamp_t lo = t < ev.minNs ? t : ev.minNs;
+        timeBase::stamp_t hi = t > ev.maxNs ? t : ev.maxNs;
+        if (hi - lo > mWindowNs)
+        {
+            continue;
+        }
+        if (target < 0 || ev.seq < mOpen[target].seq)
+        {
+            target = i;
+        }
+    }
+
+    if (target >= 0)
+    {
+        Event &ev = mOpen[target];
+        ev.ns[ch] = t;
+        ev.mask |= bit;
+        if (t < ev.minNs)
+        {
+            ev.minNs = t;
+        }
+        if (t > ev.maxNs)
+        {
+            ev.maxNs = t;
+        }
+        if (ev.mask == mFullMask)
+        {
+            close(target);
+        }
+        return;
+    }
+
+    // 새 이벤트 열기
+    if (mOpenedOnce && mHoldoffNs > 0 && t < mLastOpenNs + mHoldoffNs)
+    {
+        holdoff++;
+        return;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < EVENT_SLOTS; i++)
+    {
+        if (!mUsed[i])
+        {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0)
+    {
+        slot = oldestSlot();
+        forced++;
+        close(slot);
+    }
+
+    Event &ev = mOpen[slot];
+    ev.mask = bit;
+    ev.ns[ch] = t;
+    ev.minNs = t;
+    ev.maxNs = t;
+    ev.seq = mSeq++;
+    mUsed[slot] = true;
+
+    mLastOpenNs = t;
+    mOpenedOnce = true;
+
+    if (ev.mask == mFullMask)
+    {
+        close(slot); // 1채널 구성
+    }
+}
+
+template <int N>
+void CorrelatorT<N>::expire(timeBase::stamp_t now)
+{
+    // 오래된 순서대로 닫아야 대기열 순서가 유지된다.
+    int slot;
+    while ((slot = oldestSlot()) >= 0 && now >= mOpen[slot].minNs + mWindowNs + mLatencyNs)
+    {
+        close(slot);
+    }
+}
+
+template <int N>
+void CorrelatorT<N>::setSourceLatency(uint64_t latencyNs)
+{
+    mLatencyNs = latencyNs > EXPIRE_MARGIN_NS ? latencyNs : EXPIRE_MARGIN_NS;
+}
+
+template <int N>
+bool CorrelatorT<N>::pop(Event &event)
+{
+    if (mDoneCount == 0)
+    {
+        return false;
+    }
+    event = mDone[mDoneHead];
+    mDoneHead = (mDoneHead + 1) % EVENT_DONE_SLOTS;
+    mDoneCount--;
+    return true;
+}
+
+template <int N>
+bool CorrelatorT<N>::hasOpen() const
+{
+    return oldestSlot() >= 0;
+}
+
+template <int N>
+uint64_t CorrelatorT<N>::nsUntilDeadline(timeBase::stamp_t now) const
+{
+    int slot = oldestSlot();
+    if (slot < 0)
+    {
+        return UINT64_MAX;
+    }
+    timeBase::stamp_t deadline = mOpen[slot].minNs + mWindowNs + mLatencyNs;
+    return now >= deadline ? 0 : deadline - now;
+}
+
+template <int N>
+uint32_t CorrelatorT<N>::newestMask() const
+{
+    int newest = -1;
+    for (int i = 0; i < EVENT_SLOTS; i++)
+    {
+        if (mUsed[i] && (newest < 0 || mOpen[i].seq > mOpen[newest].seq))
+        {
+            newest = i;
+        }
+    }
+    return newest < 0 ? 0 : mOpen[newest].mask;
+}
+
+template class CorrelatorT<MAX_CHANNELS>;
+
+} // namespace dataCapture
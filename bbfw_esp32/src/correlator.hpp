@@ -0,0 +1,99 @@
+#ifndef CORRELATOR_HPP
+#define CORRELATOR_HPP
+
+#include "captureBackend.hpp"
+
+// 에지 -> 이벤트 상관(correlation) 단계
+// 같은 음원에서 나온 에지들은 센서 간 최대 거리 / 음속 (최대 TDOA) 안에 모두 도착한다.
+// 이 창(window)으로 에지를 묶고, 창이 닫히면 빠진 채널이 있어도 바로 이벤트를 내보낸다.
+// 여러 이벤트를 동시에 열어 둘 수 있어 수 ms 간격의 충격음도 각각 잡힌다.
+
+namespace dataCapture {
+
+// 동시에 진행할 수 있는 이벤트 수
+#ifndef EVENT_SLOTS
+#define EVENT_SLOTS 4
+#endif
+
+// 닫힌 이벤트 대기열 크기
+#define EVENT_DONE_SLOTS 8
+
+template <int N>
+struct EventT
+{
+    timeBase::stamp_t ns[N];            // 채널별 에지 시각 (ns)
+    timeBase::stamp_t minNs;
+    timeBase::stamp_t maxNs;
+    uint32_t mask;                      // 에지가 들어온 채널
+    uint32_t seq;                       // 열린 순서
+};
+
+// 채널 수 N 은 빌드 시 고정 (CAPTURE_CHANNELS), correlator.cpp 에서 명시적으로 인스턴스화한다.
+template <int N>
+class CorrelatorT
+{
+public:
+    typedef EventT<N> Event;
+
+    uint32_t complete = 0; // 모든 채널이 들어온 이벤트
+    uint32_t partial = 0;  // 창이 닫혀 일부 채널만으로 내보낸 이벤트
+    uint32_t orphan = 0;   // 채널 하나뿐이라 버린 이벤트
+    uint32_t ringing = 0;  // 같은 채널에 링잉 hold-off 안에서 다시 들어와 버린 에지
+    uint32_t holdoff = 0;  // detect_delay 안에 새 이벤트를 열려다 버린 에지
+    uint32_t forced = 0;   // 슬롯이 모자라 창이 닫히기 전에 내보낸 이벤트
+    uint32_t dropped = 0;  // 대기열이 가득 차 버린 이벤트
+
+    // ringNs : 같은 채널의 다음 에지를 링잉으로 보고 버리는 시간 (비교기 링잉, 수십 us)
+    void configure(int channels, uint32_t windowNs, uint64_t holdoffNs, uint32_t ringNs);
+    // 에지 시각과 링에 들어오는 시점 사이 최대 지연 (창이 닫힌 뒤 이만큼 더 기다림)
+    void setSourceLatency(uint64_t latencyNs);
+
+    void addEdge(const EdgeRecord &edge);
+    // 창이 지난 이벤트를 닫는다.
+    void expire(timeBase::stamp_t now);
+    // 닫힌 이벤트를 하나 꺼낸다.
+    bool pop(Event &event);
+
+    bool hasOpen() const;
+    // 가장 먼저 닫힐 이벤트까지 남은 시간 (ns), 열린 이벤트가 없으면 UINT64_MAX
+    uint64_t nsUntilDeadline(timeBase::stamp_t now) const;
+    // 가장 최근에 열린 이벤트의 채널 마스크 (ISR 깨우기 기준)
+    uint32_t newestMask() const;
+
+    uint32_t windowNs() const { return mWindowNs; }
+
+private:
+    int mChannels = 0;
+    uint32_t mFullMask = 0;
+    uint32_t mWindowNs = 0;
+    uint64_t mHoldoffNs = 0;
+    uint32_t mRingNs = 0;
+    uint64_t mLatencyNs = 0;
+
+    Event mOpen[EVENT_SLOTS];
+    bool mUsed[EVENT_SLOTS] = {false};
+    uint32_t mSeq = 0;
+
+    Event mDone[EVENT_DONE_SLOTS];
+    int mDoneHead = 0;
+    int mDoneCount = 0;
+
+    // 채널별 링잉 판정 상태 (채널 배열을 한곳에 모아 둔다)
+    struct Channels
+    {
+        timeBase::stamp_t lastNs[N] = {0};
+        uint32_t hasLast = 0;
+    } mCh;
+    timeBase::stamp_t mLastOpenNs = 0;
+    bool mOpenedOnce = false;
+
+    int oldestSlot() const;
+    void close(int slot);
+};
+
+typedef CorrelatorT<MAX_CHANNELS> Correlator;
+typedef Correlator::Event Event;
+
+} // namespace dataCapture
+
+#endif // CORRELATOR_HPP
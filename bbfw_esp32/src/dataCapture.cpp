@@ -1,4 +1,10 @@
 #include "dataCapture.hpp"
+#include "captureBackend.hpp"
+#include "correlator.hpp"
+#include "dlog.hpp"
+
+#include <array>
+#include <staticFor.hpp>
 
 namespace dataCapture {
 
@@ -7,121 +13,463 @@ namespace dataCapture {
 //   #define MAX_CHANNELS 8
 // #endif
 
-// 각 채널별 측정 시간을 저장하는 배열 (마이크로초 단위)
-volatile unsigned long times[MAX_CHANNELS] = {0};
-// 각 채널의 신호 수신 여부 플래그
-volatile bool flags[MAX_CHANNELS] = {false};
+EdgeRing g_edgeRings[portNUM_PROCESSORS];
+
+TaskHandle_t g_notifyTask = NULL;
+std::atomic<uint32_t> g_pendingMask{0};
+uint32_t g_expectMask = 0;
+
+// 아래 상태는 캡처 태스크(소비자)만 접근한다. ISR 은 링에만 쓴다.
+static Correlator s_correlator;
+static uint32_t s_edgeCount = 0;
+
+// 모든 채널이 들어온 이벤트의 채널 간 시각 폭 (bench skew)
+static uint32_t s_spreadEvents = 0;
+static uint64_t s_spreadSumNs = 0;
+static uint32_t s_spreadMaxNs = 0;
+
+// 채널별 지연 보정 (ns) : 소비자가 링에서 꺼낼 때 빼므로 ISR 경로에는 비용이 없다.
+static int32_t s_offsetNs[MAX_CHANNELS] = {0};
+
+// 보정 측정 상태 (Welford 평균/분산, 캡처 태스크만 갱신)
+struct Welford
+{
+    uint32_t n;
+    double mean;
+    double m2;
+};
+// 시작과 끝은 요청만 하고 캡처 태스크가 적용한다. 끝은 결과를 s_calResult 에 옮긴 뒤 s_calDone 으로 넘긴다.
+static std::atomic<bool> s_calibrating{false};
+static std::atomic<bool> s_calBeginRequest{false};
+static std::atomic<bool> s_calEndRequest{false};
+static std::atomic<bool> s_calDone{false};
+static Welford s_cal[MAX_CHANNELS];
+static uint32_t s_calEvents = 0;
+static int32_t s_savedOffsetNs[MAX_CHANNELS];
+static CalResult s_calResult;
+
+static std::atomic<bool> s_paused{false};
+
+// 창 계산에 쓰는 여유 : 비교기 지연 편차, ISR 지터 (ns)
+static const uint32_t WINDOW_MARGIN_NS = 50000;
 
 int channels_num = 0;
 // uint32_t g_detect_delay; // 250ms
 
-// 인터럽트 서비스 루틴(ISR)을 생성하기 위한 매크로 (채널 번호를 인자로 사용)
-#define DEFINE_ISR(channel)                   \
-    void IRAM_ATTR isr_##channel() {          \
-        if (!flags[channel]) {                \
-            times[channel] = micros();        \
-            flags[channel] = true;            \
-        }                                     \
-    }
-
-// 각 채널별 ISR 정의
-DEFINE_ISR(0)
-DEFINE_ISR(1)
-DEFINE_ISR(2)
-DEFINE_ISR(3)
-DEFINE_ISR(4)
-DEFINE_ISR(5)
-DEFINE_ISR(6)
-DEFINE_ISR(7)
+#if !defined(CAPTURE_BACKEND_MCPWM)
 
+// 채널별 ISR : 채널 번호를 템플릿 인자로 받아 상수로 들어간다.
+template <int CH>
+void IRAM_ATTR edgeIsr() {
+    if (pushEdge(CH, timeBase::now())) {
+        portYIELD_FROM_ISR();
+    }
+}
 
 // ISR 함수 포인터 타입 정의
 typedef void (*ISRFunc)();
-// 각 채널에 해당하는 ISR 함수 포인터 배열
-static ISRFunc isr_funcs[MAX_CHANNELS] = { isr_0, isr_1, isr_2, isr_3, isr_4, isr_5, isr_6, isr_7 };
+
+template <int... CH>
+constexpr std::array<ISRFunc, sizeof...(CH)> makeIsrTable(std::integer_sequence<int, CH...>) {
+    return {{ &edgeIsr<CH>... }};
+}
+
+// 각 채널에 해당하는 ISR 함수 포인터 배열 (CAPTURE_CHANNELS 개를 컴파일 시간에 생성)
+static constexpr std::array<ISRFunc, MAX_CHANNELS> isr_funcs = makeIsrTable(std::make_integer_sequence<int, MAX_CHANNELS>{});
+
+namespace backend {
+
+const char* const name = "gpio";
+
+int setup(const int* pins, int num_channels) {
+    // 각 핀을 내부 풀다운(INPUT_PULLDOWN)으로 설정하고, 상승 에지(RISING)에서 인터럽트 발생하도록 attachInterrupt() 호출
+    for (int i = 0; i < num_channels; i++) {
+        pinMode(pins[i], INPUT_PULLDOWN);
+        attachInterrupt(digitalPinToInterrupt(pins[i]), isr_funcs[i], RISING);
+    }
+    return num_channels;
+}
+
+// ISR 에서 찍은 timeBase 시각이 곧 에지 시각
+void resolve(EdgeRecord &edge) {
+}
+
+} // namespace backend
+
+#endif // !CAPTURE_BACKEND_MCPWM
 
 uint32_t g_ResultTicks[MAX_CHANNELS];
+uint32_t g_ResultMask = 0;
+uint64_t g_ResultTime = 0;
 boolean g_bIsTriggered = false;
 
+static const char* s_sourceName = "";
+
+const char* backendName() {
+    return s_sourceName;
+}
+
+// 백엔드 설정 후 공통 상태 초기화
+static void begin(const char* name, int num_channels) {
+    g_bIsTriggered = false;
+
+    for(int i = 0; i < MAX_CHANNELS; i++) {
+        g_ResultTicks[i] = TICK_MISSING;
+    }
+
+    channels_num = num_channels;
+    s_sourceName = name;
+    g_expectMask = channelMask(channels_num);
+
+    setCorrelation(DEFAULT_APERTURE_M, DEFAULT_SOUND_SPEED, 0, DEFAULT_RING_HOLDOFF_US);
+}
+
 /**
- * @brief 지정한 핀 배열에 대해 내부 풀다운 입력 및 인터럽트를 설정합니다.
- * 
+ * @brief 지정한 핀 배열에 대해 내부 풀다운 입력 및 캡처를 설정합니다.
+ *
  * @param pins         각 채널에 해당하는 핀 번호 배열
- * @param num_channels 채널 수 (MAX_CHANNELS와 같아야 함)
+ * @param num_channels 채널 수 (MAX_CHANNELS 이하)
  */
 void setup(const int* pins, int num_channels) {
-    channels_num = num_channels;
+    if (num_channels > MAX_CHANNELS) {
+        num_channels = MAX_CHANNELS;
+    }
+    begin(backend::name, backend::setup(pins, num_channels));
+}
 
-    g_bIsTriggered = false;
-    // g_detect_delay = detect_delay;
-    
-    for(int i = 0; i < MAX_CHANNELS; i++) {
-        g_ResultTicks[i] = -1;
+/**
+ * @brief 핀별 ISR 대신 GPIO 뱅크 ISR 하나로 모든 채널을 같은 시각에 찍습니다. (capture_mode bank)
+ *        MCPWM 빌드에서는 하드웨어 래치가 이미 채널별이므로 setup() 과 같습니다.
+ */
+void setupBank(const int* pins, int num_channels) {
+#if defined(CAPTURE_BACKEND_MCPWM)
+    DLOG_E(CAPTURE, "bank capture is not available with CAPTURE_BACKEND_MCPWM");
+    setup(pins, num_channels);
+#else
+    if (num_channels > MAX_CHANNELS) {
+        num_channels = MAX_CHANNELS;
     }
+    begin(bank::name, bank::setup(pins, num_channels));
+#endif
+}
 
-    // 각 핀을 내부 풀다운(INPUT_PULLDOWN)으로 설정하고, 상승 에지(RISING)에서 인터럽트 발생하도록 attachInterrupt() 호출
-    for (int i = 0; i < channels_num; i++) {
-        pinMode(pins[i], INPUT_PULLDOWN);
-        attachInterrupt(digitalPinToInterrupt(pins[i]), isr_funcs[i], RISING);
+/**
+ * @brief 코어 1 폴링 루프로 모든 채널을 캡처합니다. (capture_mode poll)
+ *        에지는 burst 가 끝나야 링에 보이므로 상관 창을 burst 길이만큼 늦게 닫습니다.
+ *        폴링 태스크는 start() 에서 시작합니다.
+ */
+void setupPoll(const int* pins, int num_channels, uint32_t burst_us) {
+#if defined(CAPTURE_BACKEND_MCPWM)
+    DLOG_E(CAPTURE, "poll capture is not available with CAPTURE_BACKEND_MCPWM");
+    setup(pins, num_channels);
+#else
+    if (num_channels > MAX_CHANNELS) {
+        num_channels = MAX_CHANNELS;
+    }
+    if (burst_us == 0) {
+        burst_us = 1000;
     }
+    begin(poll::name, poll::setup(pins, num_channels, burst_us));
+    s_correlator.setSourceLatency((uint64_t)burst_us * 1000);
+#endif
 }
 
-void reset() {
-    for (int i = 0; i < channels_num; i++) {
-        flags[i] = false;
-        times[i] = 0;
+void start() {
+#if !defined(CAPTURE_BACKEND_MCPWM)
+    if (s_sourceName == poll::name) {
+        poll::start();
     }
-    g_bIsTriggered = false;
+#endif
 }
 
 /**
- * @brief 모든 채널에 신호가 수신되었을 경우, 가장 빠른 도착 시간을 기준으로 각 채널의 시차를 출력합니다.
- * 
- * @return true  모든 채널이 트리거되었으면 true를 반환
- * @return false 그렇지 않으면 false를 반환
+ * @brief 핀 인터럽트 대신 다른 캡처 엔진(adcCapture 등)이 에지를 넣는 경우의 설정
+ *
+ * @param name         캡처 엔진 이름 (about/stats 출력용)
+ * @param num_channels 채널 수
+ * @param latency_ns   에지 시각과 링에 들어오는 시점 사이 최대 지연
  */
-boolean checkallTriggered() {
-    // 모든 채널의 플래그가 true이면 신호가 모두 수신된 것으로 간주
-    bool allTriggered = true;
-    for (int i = 0; i < channels_num; i++) {
-        if (!flags[i]) {
-            allTriggered = false;
-            break;
+void setupSource(const char* name, int num_channels, uint64_t latency_ns) {
+    if (num_channels > MAX_CHANNELS) {
+        num_channels = MAX_CHANNELS;
+    }
+    begin(name, num_channels);
+    s_correlator.setSourceLatency(latency_ns);
+}
+
+/**
+ * @brief 상관 창을 설정합니다. 창 = 센서 간 최대 거리 / 음속 + 여유
+ *
+ * @param aperture_m      가장 멀리 떨어진 두 센서 사이 거리 (m)
+ * @param sound_speed     음속 (m/s)
+ * @param detect_delay_ms 이벤트를 연 뒤 다음 이벤트를 열지 않는 시간 (ms, 0 이면 중첩 이벤트 허용)
+ * @param ring_holdoff_us 같은 채널의 다음 에지를 링잉으로 버리는 시간 (us)
+ */
+void setCorrelation(float aperture_m, float sound_speed, uint32_t detect_delay_ms, uint32_t ring_holdoff_us) {
+    if (sound_speed <= 0) {
+        sound_speed = DEFAULT_SOUND_SPEED;
+    }
+    uint32_t windowNs = (uint32_t)(aperture_m / sound_speed * 1e9f) + WINDOW_MARGIN_NS;
+    s_correlator.configure(channels_num, windowNs, (uint64_t)detect_delay_ms * 1000000ULL, ring_holdoff_us * 1000UL);
+}
+
+uint32_t windowUs() {
+    return s_correlator.windowNs() / 1000;
+}
+
+void attachTask(TaskHandle_t task) {
+    g_notifyTask = task;
+}
+
+/**
+ * @brief 꺼낸 이벤트를 다 처리했음을 표시합니다.
+ */
+void reset() {
+    g_bIsTriggered = false;
+}
+
+void getStats(Stats &stats) {
+    stats.edges = s_edgeCount;
+    stats.complete = s_correlator.complete;
+    stats.partial = s_correlator.partial;
+    stats.orphan = s_correlator.orphan;
+    stats.ringing = s_correlator.ringing;
+    stats.holdoff = s_correlator.holdoff;
+    stats.forced = s_correlator.forced;
+    stats.dropped = s_correlator.dropped;
+    stats.spreadEvents = s_spreadEvents;
+    stats.spreadAvgNs = s_spreadEvents > 0 ? (uint32_t)(s_spreadSumNs / s_spreadEvents) : 0;
+    stats.spreadMaxNs = s_spreadMaxNs;
+#if !defined(CAPTURE_BACKEND_MCPWM)
+    bool polling = (s_sourceName == poll::name);
+    stats.pollLoopNs = polling ? poll::loopNs() : 0;
+    stats.pollMissed = polling ? poll::missed() : 0;
+#else
+    stats.pollLoopNs = 0;
+    stats.pollMissed = 0;
+#endif
+
+    stats.overflow = 0;
+    stats.ringCapacity = EdgeRing::capacity();
+    stats.ringHighWater = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        stats.overflow += g_edgeRings[core].overflow();
+        if (g_edgeRings[core].highWater() > stats.ringHighWater) {
+            stats.ringHighWater = g_edgeRings[core].highWater();
         }
-        else {
-            if(micros() - times[i] > 500000) { // 500ms 이상 경과하면 false
-                // allTriggered = false;
-                // break;
-                times[i] = 0;
-                flags[i] = false;
-                Serial.printf("Channel %d timeout\n", i);
-            }
+    }
+}
+
+void resetSpread() {
+    s_spreadEvents = 0;
+    s_spreadSumNs = 0;
+    s_spreadMaxNs = 0;
+}
+
+// 채널별 루프는 staticFor 로 빌드 시 채널 수만큼 풀린다. (4 채널 빌드면 4 번)
+void setOffsets(const int* offsets_ns, int num_channels) {
+    staticFor<MAX_CHANNELS>([&](auto ch) {
+        s_offsetNs[ch] = ch < num_channels ? offsets_ns[ch] : 0;
+    });
+}
+
+int32_t offsetNs(int channel) {
+    return (channel >= 0 && channel < MAX_CHANNELS) ? s_offsetNs[channel] : 0;
+}
+
+// 캡처 태스크 : 시작 요청이 있으면 보정값을 비우고 통계를 새로 시작한다.
+static void beginCalibration() {
+    staticFor<MAX_CHANNELS>([&](auto ch) {
+        s_savedOffsetNs[ch] = s_offsetNs[ch];
+        s_offsetNs[ch] = 0;
+        s_cal[ch] = {0, 0, 0};
+    });
+    s_calEvents = 0;
+    s_calibrating.store(true);
+    s_calBeginRequest.store(false);
+}
+
+void requestCalibrationBegin() {
+    s_calDone.store(false);
+    s_calEndRequest.store(false);
+    s_calBeginRequest.store(true);
+    if (g_notifyTask != NULL) {
+        xTaskNotifyGive(g_notifyTask);
+    }
+}
+
+bool calibrating() {
+    return s_calibrating.load();
+}
+
+void requestCalibrationEnd() {
+    s_calEndRequest.store(true);
+    // 열린 이벤트가 없으면 캡처 태스크가 알림까지 잠들어 있으므로 깨운다.
+    if (g_notifyTask != NULL) {
+        xTaskNotifyGive(g_notifyTask);
+    }
+}
+
+bool takeCalibration(CalResult &result) {
+    if (!s_calDone.load()) {
+        return false;
+    }
+    result = s_calResult;
+    s_calDone.store(false);
+    return true;
+}
+
+// 캡처 태스크 : 끝내기 요청이 있으면 통계를 결과로 옮기고 측정 전 보정값으로 되돌린다.
+static void finishCalibration() {
+    s_calibrating.store(false);
+    s_calEndRequest.store(false);
+
+    s_calResult.events = s_calEvents;
+    staticFor<MAX_CHANNELS>([&](auto ch) {
+        const Welford &w = s_cal[ch];
+        s_calResult.offsetNs[ch] = (int32_t)lround(w.mean);
+        s_calResult.jitterNs[ch] = w.n > 1 ? (uint32_t)lround(sqrt(w.m2 / (w.n - 1))) : 0;
+        s_offsetNs[ch] = s_savedOffsetNs[ch];
+    });
+    s_calDone.store(true);
+}
+
+void setPaused(bool paused) {
+    s_paused.store(paused);
+}
+
+bool paused() {
+    return s_paused.load();
+}
+
+// 모든 채널이 들어온 보정 이벤트 : 채널 평균 시각 기준 채널별 지연을 누적
+static void calibrateEvent(const Event &ev) {
+    if (ev.mask != g_expectMask) {
+        return;
+    }
+
+    double mean = 0;
+    for (int ch = 0; ch < channels_num; ch++) {
+        mean += (double)(ev.ns[ch] - ev.minNs);
+    }
+    mean /= channels_num;
+
+    for (int ch = 0; ch < channels_num; ch++) {
+        double d = (double)(ev.ns[ch] - ev.minNs) - mean;
+        Welford &w = s_cal[ch];
+        w.n++;
+        double delta = d - w.mean;
+        w.mean += delta / w.n;
+        w.m2 += delta * (d - w.mean);
+    }
+    s_calEvents++;
+}
+
+static bool ringsEmpty() {
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        if (g_edgeRings[core].size() > 0) {
+            return false;
         }
     }
-    
-    if (allTriggered) {
-        // 가장 빠른 도착 시간을 찾음
-        unsigned long earliest = times[0];
-        for (int i = 1; i < channels_num; i++) {
-            if (times[i] < earliest) {
-                earliest = times[i];
+    return true;
+}
+
+// 코어별 링에 쌓인 에지를 배치로 꺼내 상관 단계로 넘긴다.
+static void drainEdges() {
+    EdgeRecord batch[32];
+    do {
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            uint32_t n;
+            while ((n = g_edgeRings[core].pop(batch, 32)) > 0) {
+                for (uint32_t i = 0; i < n; i++) {
+                    backend::resolve(batch[i]);
+                    batch[i].ns -= (int64_t)s_offsetNs[batch[i].channel];
+                    s_correlator.addEdge(batch[i]);
+                }
+                s_edgeCount += n;
             }
         }
+        // ISR 의 깨우기 판단 기준을 가장 최근 이벤트의 채널 상태로 맞춘다.
+        // 저장 직전에 들어온 에지는 링에 남아 있으므로 다시 한번 비운다.
+        g_pendingMask.store(s_correlator.newestMask());
+    } while (!ringsEmpty());
+}
+
+/**
+ * @brief 캡처 태스크가 다음 알림을 기다릴 최대 시간
+ *        열린 이벤트가 없으면 무기한, 있으면 가장 먼저 닫힐 이벤트의 창이 끝날 때까지
+ */
+TickType_t waitTicks() {
+    uint64_t ns = s_correlator.nsUntilDeadline(timeBase::now());
+    if (ns == UINT64_MAX) {
+        return portMAX_DELAY;
+    }
+    return pdMS_TO_TICKS((uint32_t)(ns / 1000000)) + 1;
+}
+
+/**
+ * @brief 닫힌 이벤트가 있으면 하나 꺼내 가장 빠른 채널 기준 시차를 g_ResultTicks 에 채웁니다.
+ *        에지가 없는 채널은 TICK_MISSING, 들어온 채널은 g_ResultMask 에 표시됩니다.
+ *        닫힌 이벤트가 여러 개일 수 있으므로 false 가 나올 때까지 반복 호출합니다.
+ *
+ * @return true  이벤트를 꺼냈으면 true를 반환
+ * @return false 그렇지 않으면 false를 반환
+ */
+boolean checkallTriggered() {
+    drainEdges();
+    s_correlator.expire(timeBase::now());
+
+    // 보정 시작 : 보정값 배열을 이 태스크만 고치므로 drainEdges 중간에 바뀌지 않는다.
+    if (s_calBeginRequest.load()) {
+        beginCalibration();
+    }
+
+    // 보정 끝 : 이미 닫힌 이벤트까지 넣고 넘긴다.
+    if (s_calEndRequest.load()) {
+        Event pending;
+        while (s_correlator.pop(pending)) {
+            calibrateEvent(pending);
+        }
+        finishCalibration();
+        return false;
+    }
 
-        for(int i = 0; i < channels_num; i++) {
-            g_ResultTicks[i] = (u_int32_t)(times[i] - earliest);
+    Event ev;
+    if (!s_correlator.pop(ev)) {
+        return false;
+    }
+    // 정지 중에는 닫힌 이벤트를 버린다.
+    if (s_paused.load()) {
+        while (s_correlator.pop(ev)) {
         }
+        return false;
+    }
+    // 보정 측정 중에는 이벤트를 내보내지 않는다. (BLE/시리얼 출력 없이 통계만)
+    while (s_calibrating.load()) {
+        calibrateEvent(ev);
+        if (!s_correlator.pop(ev)) {
+            return false;
+        }
+    }
 
-        g_bIsTriggered = true;
-        
-        // for (int i = 0; i < channels_num; i++) {
-        //     flags[i] = false;
-        //     times[i] = 0;
-        // }
+    // 채널 수가 빌드 시 정해지므로 채널별 코드로 풀린다. (사용하지 않는 채널은 mask 가 0)
+    staticFor<MAX_CHANNELS>([&](auto ch) {
+        g_ResultTicks[ch] = (ev.mask & (1UL << ch)) ? (uint32_t)(ev.ns[ch] - ev.minNs) : TICK_MISSING;
+    });
+    g_ResultMask = ev.mask;
+    g_ResultTime = ev.minNs;
 
+    if (ev.mask == g_expectMask) {
+        uint32_t spread = (uint32_t)(ev.maxNs - ev.minNs);
+        s_spreadEvents++;
+        s_spreadSumNs += spread;
+        if (spread > s_spreadMaxNs) {
+            s_spreadMaxNs = spread;
+        }
     }
+    g_bIsTriggered = true;
 
-    return allTriggered;
+    return true;
 }
 
 
@@ -3,26 +3,122 @@
 
 #include <Arduino.h>
 
+// 캡처 백엔드 선택 (platformio.ini 의 build_flags 로 보드 env 별 지정)
+//  - 기본값                 : 채널별 GPIO 인터럽트 + timeBase::now() (CCOUNT 기반, ISR 진입 지터 포함)
+//  - CAPTURE_BACKEND_MCPWM  : MCPWM 캡처 유닛이 APB 80MHz 타이머 값을 하드웨어로 래치 (12.5ns 분해능, 최대 6채널)
+//
+// 어느 백엔드든 에지 시각은 timeBase 64비트 ns 로 맞춰지고, g_ResultTicks 는 나노초 단위로 보고한다.
+
 namespace dataCapture {
 
-// 사용할 채널 수 (예제에서는 4개)
-// constexpr int MAX_CHANNELS = 8;
-#define MAX_CHANNELS 8
+// 빌드 시 정하는 최대 채널 수 (platformio.ini build_flags : -D CAPTURE_CHANNELS=16)
+// 채널별 저장 공간, ISR 표, 결과 배열이 이 크기로 만들어지고 채널 루프는 컴파일 시간에 풀린다.
+// 실제 사용 채널 수(config ch_num)는 이 값 이하에서 런타임에 정한다.
+#ifndef CAPTURE_CHANNELS
+#define CAPTURE_CHANNELS 8
+#endif
+#define MAX_CHANNELS CAPTURE_CHANNELS
+
+static_assert(CAPTURE_CHANNELS >= 1 && CAPTURE_CHANNELS <= 32, "CAPTURE_CHANNELS must be 1..32 (channel masks are 32-bit)");
+
+// n 채널 전체 비트마스크
+constexpr uint32_t channelMask(int n)
+{
+    return n >= 32 ? 0xFFFFFFFFUL : ((1UL << n) - 1);
+}
+
+// ISR -> 캡처 태스크 에지 링 크기 (코어당, 2의 거듭제곱)
+#ifndef EDGE_RING_SIZE
+#define EDGE_RING_SIZE 256
+#endif
+
+// 에지가 들어오지 않은 채널의 g_ResultTicks 값
+#define TICK_MISSING 0xFFFFFFFFUL
 
-// 각 채널별 도착 시간을 저장 (마이크로초 단위)
-// extern volatile unsigned long times[MAX_CHANNELS];
+// 상관 창 기본값 (config : aperture_mm, sound_speed)
+#define DEFAULT_APERTURE_M 1.0f
+#define DEFAULT_SOUND_SPEED 343.0f
+// 링잉 hold-off 기본값 (config : ring_holdoff_us), 비교기 출력이 다시 넘어가는 시간 정도
+#define DEFAULT_RING_HOLDOFF_US 50
 
-// 각 채널별 신호 수신 플래그
-// extern volatile bool flags[MAX_CHANNELS];
+// 캡처 통계 (serial stats 명령으로 출력)
+struct Stats
+{
+    uint32_t edges;          // 링에서 꺼낸 에지 수
+    uint32_t overflow;       // 링이 가득 차 버려진 에지 수 (전체 코어 합)
+    uint32_t complete;       // 모든 채널이 들어온 이벤트 수
+    uint32_t partial;        // 창이 닫혀 빠진 채널과 함께 내보낸 이벤트 수
+    uint32_t orphan;         // 채널 하나뿐이라 버린 이벤트 수
+    uint32_t ringing;        // 같은 채널 ring_holdoff_us 안 재트리거로 버린 에지 수
+    uint32_t holdoff;        // detect_delay 중 새 이벤트를 열려다 버린 에지 수
+    uint32_t forced;         // 이벤트 슬롯 부족으로 일찍 닫힌 이벤트 수
+    uint32_t dropped;        // 이벤트 대기열이 넘쳐 버린 이벤트 수
+    uint32_t spreadEvents;   // 아래 폭 통계에 들어간 (모든 채널) 이벤트 수
+    uint32_t spreadAvgNs;    // 이벤트 안 채널 간 시각 폭 평균 (같은 신호를 모든 입력에 넣으면 채널 간 스큐)
+    uint32_t spreadMaxNs;
+    uint32_t pollLoopNs;     // poll 모드 루프 한 바퀴 시간 (분해능, 다른 모드는 0)
+    uint32_t pollMissed;     // poll 모드 burst 사이에 올라와 버린 에지 수
+    uint32_t ringCapacity;   // 코어당 링 크기
+    uint32_t ringHighWater;  // 링 최대 사용량
+};
+
+// 채널 지연 보정 결과 (calibrate 명령)
+struct CalResult
+{
+    uint32_t events;                  // 통계에 들어간 (모든 채널) 이벤트 수
+    int32_t offsetNs[MAX_CHANNELS];   // 채널별 평균 지연 (이벤트 안 채널 평균 기준)
+    uint32_t jitterNs[MAX_CHANNELS];  // 채널별 지연 표준편차 (보정 후 남는 지터)
+};
 
 
 extern int channels_num;
 extern void setup(const int* pins, int num_channels);
+// 핀별 ISR 대신 GPIO 뱅크 ISR 하나 (capture_mode bank)
+extern void setupBank(const int* pins, int num_channels);
+// 코어 1 이 인터럽트를 막고 GPIO 를 폴링 (capture_mode poll), burst_us 마다 인터럽트 창
+extern void setupPoll(const int* pins, int num_channels, uint32_t burst_us);
+// 캡처 시작이 따로 필요한 모드(poll)의 시작, setup() 의 마지막에 호출 (다른 모드는 아무것도 안 함)
+extern void start();
+// 핀 인터럽트가 아닌 캡처 엔진(adc 등)이 에지를 공급할 때
+extern void setupSource(const char* name, int num_channels, uint64_t latency_ns);
 extern boolean checkallTriggered();
 extern void reset();
 
+// 상관 창 (센서 간 최대 거리 / 음속), 이벤트 홀드오프, 채널 링잉 hold-off 설정
+extern void setCorrelation(float aperture_m, float sound_speed, uint32_t detect_delay_ms, uint32_t ring_holdoff_us);
+// 현재 상관 창 (us)
+extern uint32_t windowUs();
+// ISR 이 깨울 캡처 태스크 등록 (캡처 태스크 자신이 호출)
+extern void attachTask(TaskHandle_t task);
+// 다음 ulTaskNotifyTake() 에 넘길 대기 시간
+extern TickType_t waitTicks();
+
+// 현재 캡처 백엔드 이름 ("gpio", "bank", "poll", "mcpwm", "adc")
+extern const char* backendName();
+
+extern void getStats(Stats &stats);
+// 채널 간 시각 폭 통계 초기화
+extern void resetSpread();
+
+// 채널별 지연 보정값 (ns, config cal_offsets), 링에서 꺼낼 때 에지 시각에서 뺀다.
+extern void setOffsets(const int* offsets_ns, int num_channels);
+extern int32_t offsetNs(int channel);
+// 보정 측정 : 시작하면 보정값을 0 으로 두고 이벤트를 내보내지 않고 채널별 지연 통계에 넣는다.
+// 시작은 requestCalibrationBegin 으로 요청하고, 캡처 태스크가 적용하면 calibrating 이 true 가 된다.
+// 끝낼 때는 requestCalibrationEnd 로 요청하고, 캡처 태스크가 결과를 넘기면 takeCalibration 이 true 를 돌려준다.
+// (보정값과 통계는 캡처 태스크만 만진다) 끝나면 측정 전 보정값으로 되돌린다. (새 값 적용은 호출한 쪽에서 setOffsets)
+extern void requestCalibrationBegin();
+extern bool calibrating();
+extern void requestCalibrationEnd();
+extern bool takeCalibration(CalResult &result);
+// 캡처 정지 : 에지는 계속 받아 상관기를 비우지만 이벤트는 내보내지 않는다. (BLE 제어 capture 명령)
+extern void setPaused(bool paused);
+extern bool paused();
+
 extern boolean g_bIsTriggered;
-extern uint32_t g_ResultTicks[MAX_CHANNELS];
+extern uint32_t g_ResultTicks[MAX_CHANNELS]; // 가장 빠른 채널 기준 시차 (ns), 빠진 채널은 TICK_MISSING
+extern uint32_t g_ResultMask;                // 에지가 들어온 채널 비트마스크
+extern uint64_t g_ResultTime;                // 가장 빠른 채널의 시각 (timeBase ns)
 
 
 } // namespace dataCapture
@@ -0,0 +1,148 @@
+#include "dlog.hpp"
+
+#include <esp_timer.h>
+
+#include "mpscRing.hpp"
+#include "serialStream.hpp"
+
+namespace dlog {
+
+// 생성자 없는 전역 : 다른 전역 객체 생성자(Config::load)에서 넣어도 된다.
+static MpscRing<Record, DLOG_RING_SIZE> s_ring;
+
+static TaskHandle_t s_task = NULL;
+static uint32_t s_written = 0;
+static uint32_t s_suppressed = 0;
+
+static const char *const s_moduleNames[] = {"main", "capture", "ble", "config"};
+static const char s_levelNames[] = {'-', 'E', 'W', 'I', 'D'};
+
+bool IRAM_ATTR push(Record &record)
+{
+    record.timeUs = (uint32_t)esp_timer_get_time();
+    return s_ring.push(record);
+}
+
+//------------------------------------------------ format
+// 변환 지정자 하나씩 인자 타입에 맞춰 snprintf (va_list 없이 저장된 인자로 포맷)
+static size_t format(char *out, size_t size, const Record &record)
+{
+    size_t len = 0;
+    int argIndex = 0;
+    const char *p = record.fmt;
+    while (*p != 0 && len + 1 < size)
+    {
+        if (*p != '%')
+        {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        char spec[16];
+        size_t specLen = 0;
+        spec[specLen++] = *p++;
+        while (*p != 0 && strchr("diouxXcsfFeEgGaAp", *p) == NULL && specLen + 2 < sizeof(spec))
+        {
+            spec[specLen++] = *p++;
+        }
+        if (*p == 0)
+        {
+            break;
+        }
+        spec[specLen++] = *p++;
+        spec[specLen] = 0;
+
+        if (argIndex >= record.argc)
+        {
+            continue;
+        }
+        uint32_t word = record.args[argIndex];
+        uint8_t kind = (record.kinds >> (2 * argIndex)) & 3;
+        argIndex++;
+
+        int n;
+        if (kind == ARG_FLOAT)
+        {
+            float f;
+            memcpy(&f, &word, sizeof(f));
+            n = snprintf(out + len, size - len, spec, (double)f);
+        }
+        else if (kind == ARG_STR)
+        {
+            const char *s = (const char *)(uintptr_t)word;
+            n = snprintf(out + len, size - len, spec, s != NULL ? s : "(null)");
+        }
+        else
+        {
+            n = snprintf(out + len, size - len, spec, word);
+        }
+        if (n > 0)
+        {
+            len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+        }
+    }
+    out[len] = 0;
+    return len;
+}
+
+//------------------------------------------------ flush task
+static void flushLoop(void *param)
+{
+    Record records[16];
+    char line[192];
+    while (true)
+    {
+        uint32_t n;
+        while ((n = s_ring.pop(records, sizeof(records) / sizeof(records[0]))) > 0)
+        {
+            for (uint32_t i = 0; i < n; i++)
+            {
+                const Record &record = records[i];
+                if (serialStream::binary())
+                {
+                    s_suppressed++;
+                    continue;
+                }
+
+                uint8_t level = record.level < sizeof(s_levelNames) ? record.level : 0;
+                const char *module = record.module < sizeof(s_moduleNames) / sizeof(s_moduleNames[0]) ? s_moduleNames[record.module] : "?";
+                int head = snprintf(line, sizeof(line), "[%lu.%03lu] %c %s: ", (unsigned long)(record.timeUs / 1000000),
+                                    (unsigned long)(record.timeUs / 1000 % 1000), s_levelNames[level], module);
+                size_t len = head + format(line + head, sizeof(line) - head - 1, record);
+                line[len++] = '\n';
+                // 줄 하나를 한 번에 (dataLoop 이벤트 줄과 섞이지 않게)
+                Serial.write((const uint8_t *)line, len);
+                s_written++;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(DLOG_FLUSH_MS));
+    }
+}
+
+void start()
+{
+    if (s_task != NULL)
+    {
+        return;
+    }
+    // 코어 0, 가장 낮은 우선순위 (캡처 태스크보다 늦게 돌아도 된다)
+    xTaskCreatePinnedToCore(flushLoop, "dlogFlush", 3072, NULL, 1, &s_task, 0);
+}
+
+void getStats(Stats &stats)
+{
+    stats.written = s_written;
+    stats.dropped = s_ring.overflow();
+    stats.suppressed = s_suppressed;
+    stats.highWater = s_ring.highWater();
+    stats.capacity = s_ring.capacity();
+}
+
+} // namespace dlog
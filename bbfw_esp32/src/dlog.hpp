@@ -0,0 +1,163 @@
+#ifndef DLOG_HPP
+#define DLOG_HPP
+
+#include <Arduino.h>
+
+#include <string.h>
+#include <type_traits>
+
+// 지연 로그 : 부르는 쪽은 포맷 문자열 포인터 + 인자 + 시각만 링에 넣고 (printf 없음, UART 를 기다리지 않음)
+// 코어 0 의 낮은 우선순위 dlogFlush 태스크가 꺼내서 포맷하고 시리얼로 내보낸다.
+// - 태스크, 두 코어, ISR 어디서 불러도 된다. (MpscRing, push 는 IRAM)
+// - 포맷 문자열은 리터럴이어야 하고 (포인터가 곧 id) 인자는 DLOG_MAX_ARGS 개, 32비트 정수 / float / 문자열 포인터.
+//   %s 인자는 나중에 읽으므로 리터럴이나 전역 문자열만 (스택 버퍼 금지)
+// - 링이 차면 버리고 dropped 로 센다. stream binary 모드에서는 내보내지 않는다.
+// - 레벨은 모듈마다 빌드 때 정한다. (-D DLOG_LEVEL_BLE=DLOG_WARN) 레벨보다 자세한 호출은 코드에서 빠진다.
+//
+//   DLOG_I(BLE, "MTU size updated: %d", mtu);   // 줄 끝은 flush 가 붙인다.
+
+#define DLOG_NONE 0
+#define DLOG_ERROR 1
+#define DLOG_WARN 2
+#define DLOG_INFO 3
+#define DLOG_DEBUG 4
+
+// 모듈별 기본 레벨
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_INFO
+#endif
+
+#ifndef DLOG_LEVEL_MAIN
+#define DLOG_LEVEL_MAIN DLOG_LEVEL
+#endif
+#ifndef DLOG_LEVEL_CAPTURE
+#define DLOG_LEVEL_CAPTURE DLOG_LEVEL
+#endif
+#ifndef DLOG_LEVEL_BLE
+#define DLOG_LEVEL_BLE DLOG_LEVEL
+#endif
+#ifndef DLOG_LEVEL_CONFIG
+#define DLOG_LEVEL_CONFIG DLOG_LEVEL
+#endif
+
+// 링 크기 (레코드 수, 2의 거듭제곱), 인자 수, flush 주기
+#ifndef DLOG_RING_SIZE
+#define DLOG_RING_SIZE 128
+#endif
+#define DLOG_MAX_ARGS 4
+#ifndef DLOG_FLUSH_MS
+#define DLOG_FLUSH_MS 20
+#endif
+
+namespace dlog {
+
+enum Module : uint8_t
+{
+    MOD_MAIN,
+    MOD_CAPTURE,
+    MOD_BLE,
+    MOD_CONFIG,
+};
+
+enum ArgKind : uint8_t
+{
+    ARG_INT,   // 32비트 이하 정수 (부호는 포맷이 정한다)
+    ARG_FLOAT, // float / double -> float 로 저장, double 로 포맷
+    ARG_STR,   // 문자열 포인터
+};
+
+struct Record
+{
+    uint32_t timeUs;   // esp_timer (us 하위 32비트)
+    const char *fmt;   // 포맷 문자열 (리터럴, id)
+    uint8_t module;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t kinds;     // 인자마다 2비트 ArgKind
+    uint32_t args[DLOG_MAX_ARGS];
+};
+
+struct Stats
+{
+    uint32_t written;    // 내보낸 레코드
+    uint32_t dropped;    // 링이 차서 버린 레코드
+    uint32_t suppressed; // stream binary 모드라 버린 레코드
+    uint32_t highWater;  // 링 최대 사용량
+    uint32_t capacity;
+};
+
+// 링에 넣기 (시각은 여기서 찍는다, IRAM)
+bool push(Record &record);
+
+// 코어 0 flush 태스크 시작 (Serial.begin 뒤, 그 전에 쌓인 레코드도 이때 나간다)
+void start();
+
+void getStats(Stats &stats);
+
+//------------------------------------------------ 인자 -> 32비트
+template <typename T>
+constexpr uint8_t kindOf()
+{
+    typedef typename std::decay<T>::type D;
+    return std::is_floating_point<D>::value ? ARG_FLOAT : std::is_pointer<D>::value ? ARG_STR : ARG_INT;
+}
+
+template <typename T>
+inline __attribute__((always_inline)) uint32_t wordOf(T value)
+{
+    typedef typename std::decay<T>::type D;
+    if constexpr (std::is_floating_point<D>::value)
+    {
+        float f = (float)value;
+        uint32_t w;
+        memcpy(&w, &f, sizeof(w));
+        return w;
+    }
+    else if constexpr (std::is_pointer<D>::value)
+    {
+        static_assert(std::is_same<typename std::decay<typename std::remove_pointer<D>::type>::type, char>::value,
+                      "dlog pointer args must be strings");
+        return (uint32_t)(uintptr_t)value;
+    }
+    else
+    {
+        static_assert((std::is_integral<D>::value || std::is_enum<D>::value) && sizeof(D) <= 4,
+                      "dlog args must be 32-bit integers, floats or strings");
+        return (uint32_t)value;
+    }
+}
+
+template <typename... A>
+inline __attribute__((always_inline)) void write(uint8_t module, uint8_t level, const char *fmt, A... args)
+{
+    static_assert(sizeof...(A) <= DLOG_MAX_ARGS, "too many dlog args");
+    Record record;
+    record.fmt = fmt;
+    record.module = module;
+    record.level = level;
+    record.argc = sizeof...(A);
+    record.kinds = 0;
+    int i = 0;
+    ((record.kinds |= kindOf<A>() << (2 * i), record.args[i++] = wordOf(args)), ...);
+    (void)i;
+    push(record);
+}
+
+} // namespace dlog
+
+// 레벨이 모듈 레벨보다 자세하면 조건이 상수 false 라 호출과 포맷 문자열이 빌드에서 빠진다.
+#define DLOG_AT(mod, lvl, fmt, ...)                                       \
+    do                                                                    \
+    {                                                                     \
+        if (DLOG_LEVEL_##mod >= (lvl))                                    \
+        {                                                                 \
+            dlog::write(dlog::MOD_##mod, (lvl), fmt, ##__VA_ARGS__);      \
+        }                                                                 \
+    } while (0)
+
+#define DLOG_E(mod, fmt, ...) DLOG_AT(mod, DLOG_ERROR, fmt, ##__VA_ARGS__)
+#define DLOG_W(mod, fmt, ...) DLOG_AT(mod, DLOG_WARN, fmt, ##__VA_ARGS__)
+#define DLOG_I(mod, fmt, ...) DLOG_AT(mod, DLOG_INFO, fmt, ##__VA_ARGS__)
+#define DLOG_D(mod, fmt, ...) DLOG_AT(mod, DLOG_DEBUG, fmt, ##__VA_ARGS__)
+
+#endif // DLOG_HPP
@@ -0,0 +1,310 @@
+#include "gccPhat.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(GCC_PHAT_ESP_DSP)
+#include "esp_dsp.h"
+#endif
+
+namespace gccPhat {
+
+static int s_n = 0;
+static int s_bits = 0;
+static Complex *s_twiddle = NULL; // exp(-j 2 pi k / n), k < n/2
+static float *s_hann = NULL;
+
+// PHAT 정규화에서 0 나눗셈을 막는 최소 크기
+static const float MAG_EPSILON = 1e-12f;
+
+bool init(int n)
+{
+    if (n < 4 || n > GCC_PHAT_MAX_N || (n & (n - 1)) != 0)
+    {
+        return false;
+    }
+    if (n == s_n)
+    {
+        return true;
+    }
+
+    free(s_twiddle);
+    free(s_hann);
+    s_twiddle = (Complex *)malloc(sizeof(Complex) * (n / 2));
+    s_hann = (float *)malloc(sizeof(float) * n);
+    if (s_twiddle == NULL || s_hann == NULL)
+    {
+        free(s_twiddle);
+        free(s_hann);
+        s_twiddle = NULL;
+        s_hann = NULL;
+        s_n = 0;
+        return false;
+    }
+
+    const float PI2 = 6.28318530717958647692f;
+    for (int k = 0; k < n / 2; k++)
+    {
+        s_twiddle[k].re = cosf(PI2 * k / n);
+        s_twiddle[k].im = -sinf(PI2 * k / n);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        s_hann[i] = 0.5f - 0.5f * cosf(PI2 * i / n);
+    }
+
+    s_bits = 0;
+    while ((1 << s_bits) < n)
+    {
+        s_bits++;
+    }
+    s_n = n;
+
+#if defined(GCC_PHAT_ESP_DSP)
+    // 내부 표 (CONFIG_DSP_MAX_FFT_SIZE) 사용
+    if (dsps_fft2r_init_fc32(NULL, n) != ESP_OK)
+    {
+        s_n = 0;
+        return false;
+    }
+#endif
+    return true;
+}
+
+int size()
+{
+    return s_n;
+}
+
+void load(Complex *work, int part, const int16_t *p1, uint32_t n1, const int16_t *p2, uint32_t n2)
+{
+    const int n = s_n;
+    if (n1 > (uint32_t)n)
+    {
+        n1 = n;
+    }
+    if (n1 + n2 > (uint32_t)n)
+    {
+        n2 = n - n1;
+    }
+
+    int32_t sum = 0;
+    for (uint32_t i = 0; i < n1; i++)
+    {
+        sum += p1[i];
+    }
+    for (uint32_t i = 0; i < n2; i++)
+    {
+        sum += p2[i];
+    }
+    float mean = (float)sum / n;
+
+    float *dst = part == 0 ? &work[0].re : &work[0].im;
+    int i = 0;
+    for (uint32_t k = 0; k < n1; k++, i++)
+    {
+        dst[2 * i] = ((float)p1[k] - mean) * s_hann[i];
+    }
+    for (uint32_t k = 0; k < n2; k++, i++)
+    {
+        dst[2 * i] = ((float)p2[k] - mean) * s_hann[i];
+    }
+    for (; i < n; i++)
+    {
+        dst[2 * i] = 0.0f;
+    }
+}
+
+void clear(Complex *work, int part)
+{
+    float *dst = part == 0 ? &work[0].re : &work[0].im;
+    for (int i = 0; i < s_n; i++)
+    {
+        dst[2 * i] = 0.0f;
+    }
+}
+
+#if defined(GCC_PHAT_ESP_DSP)
+
+void fft(Complex *work, bool inverse)
+{
+    // 역변환 = conj(FFT(conj(x))) (1/n 은 peak() 에서 반영)
+    if (inverse)
+    {
+        for (int i = 0; i < s_n; i++)
+        {
+            work[i].im = -work[i].im;
+        }
+    }
+    dsps_fft2r_fc32((float *)work, s_n);
+    dsps_bit_rev_fc32((float *)work, s_n);
+    if (inverse)
+    {
+        for (int i = 0; i < s_n; i++)
+        {
+            work[i].im = -work[i].im;
+        }
+    }
+}
+
+#else
+
+static inline uint32_t reverseBits(uint32_t v, int bits)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < bits; i++)
+    {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+void fft(Complex *work, bool inverse)
+{
+    const int n = s_n;
+
+    for (int i = 0; i < n; i++)
+    {
+        int j = (int)reverseBits(i, s_bits);
+        if (j > i)
+        {
+            Complex t = work[i];
+            work[i] = work[j];
+            work[j] = t;
+        }
+    }
+
+    // 역변환은 회전인자의 켤레를 쓴다. (1/n 은 peak() 에서 반영)
+    const float sign = inverse ? -1.0f : 1.0f;
+    for (int len = 2, step = n / 2; len <= n; len <<= 1, step >>= 1)
+    {
+        int half = len >> 1;
+        for (int k = 0; k < half; k++)
+        {
+            float wr = s_twiddle[k * step].re;
+            float wi = s_twiddle[k * step].im * sign;
+            for (int i = k; i < n; i += len)
+            {
+                Complex &u = work[i];
+                Complex &v = work[i + half];
+                float tr = v.re * wr - v.im * wi;
+                float ti = v.re * wi + v.im * wr;
+                v.re = u.re - tr;
+                v.im = u.im - ti;
+                u.re += tr;
+                u.im += ti;
+            }
+        }
+    }
+}
+
+#endif
+
+void split(const Complex *work, Complex *x, Complex *y)
+{
+    const int n = s_n;
+    for (int k = 0; k <= n / 2; k++)
+    {
+        const Complex &z = work[k];
+        const Complex &c = work[(n - k) & (n - 1)]; // conj 는 아래에서 반영
+        // X = (Z[k] + conj(Z[n-k])) / 2, Y = (Z[k] - conj(Z[n-k])) / 2j
+        x[k].re = 0.5f * (z.re + c.re);
+        x[k].im = 0.5f * (z.im - c.im);
+        if (y != NULL)
+        {
+            y[k].re = 0.5f * (z.im + c.im);
+            y[k].im = -0.5f * (z.re - c.re);
+        }
+    }
+}
+
+static inline Complex phat(const Complex &a, const Complex &b)
+{
+    // a * conj(b) / |a * conj(b)|
+    Complex g;
+    g.re = a.re * b.re + a.im * b.im;
+    g.im = a.im * b.re - a.re * b.im;
+    float mag2 = g.re * g.re + g.im * g.im;
+    if (mag2 < MAG_EPSILON)
+    {
+        g.re = 0.0f;
+        g.im = 0.0f;
+        return g;
+    }
+    float inv = 1.0f / sqrtf(mag2);
+    g.re *= inv;
+    g.im *= inv;
+    return g;
+}
+
+void cross(Complex *work, const Complex *a1, const Complex *b1, const Complex *a2, const Complex *b2)
+{
+    const int n = s_n;
+    for (int k = 0; k <= n / 2; k++)
+    {
+        Complex g1 = phat(a1[k], b1[k]);
+        Complex g2 = {0.0f, 0.0f};
+        if (a2 != NULL)
+        {
+            g2 = phat(a2[k], b2[k]);
+        }
+
+        // W[k] = G1 + j G2, W[n-k] = conj(G1) + j conj(G2)
+        work[k].re = g1.re - g2.im;
+        work[k].im = g1.im + g2.re;
+        if (k > 0 && k < n / 2)
+        {
+            work[n - k].re = g1.re + g2.im;
+            work[n - k].im = -g1.im + g2.re;
+        }
+    }
+}
+
+Lag peak(const Complex *work, int part, int maxLag)
+{
+    const int n = s_n;
+    const int mask = n - 1;
+    if (maxLag > n / 2 - 1)
+    {
+        maxLag = n / 2 - 1;
+    }
+    const float *src = part == 0 ? &work[0].re : &work[0].im;
+
+    int best = 0;
+    float bestValue = src[0];
+    for (int m = -maxLag; m <= maxLag; m++)
+    {
+        float v = src[2 * (m & mask)];
+        if (v > bestValue)
+        {
+            bestValue = v;
+            best = m;
+        }
+    }
+
+    // 포물선 보간
+    float y0 = src[2 * ((best - 1) & mask)];
+    float y2 = src[2 * ((best + 1) & mask)];
+    float denom = y0 - 2.0f * bestValue + y2;
+    float delta = 0.0f;
+    if (denom < 0.0f)
+    {
+        delta = 0.5f * (y0 - y2) / denom;
+        if (delta > 0.5f)
+        {
+            delta = 0.5f;
+        }
+        else if (delta < -0.5f)
+        {
+            delta = -0.5f;
+        }
+    }
+
+    Lag lag;
+    lag.samples = best + delta;
+    lag.peak = bestValue / n;
+    return lag;
+}
+
+} // namespace gccPhat
@@ -0,0 +1,67 @@
+#ifndef GCCPHAT_HPP
+#define GCCPHAT_HPP
+
+#include <stdint.h>
+
+// GCC-PHAT (위상 변환 가중 일반화 상호상관) 커널
+// Arduino/FreeRTOS 에 의존하지 않는 순수 C++ 로, 호스트 g++ 로도 그대로 빌드된다.
+//  - FFT 는 내장 radix-2 (기본) 또는 ESP-DSP dsps_fft2r_fc32 (-D GCC_PHAT_ESP_DSP)
+//  - 실수 신호 두 개를 복소 FFT 하나의 실수부/허수부에 실어 한 번에 변환한다.
+//  - 교차 스펙트럼 두 개도 같은 방법으로 역변환 한 번에 처리한다.
+//  - 피크는 포물선 보간으로 샘플 이하 지연까지 구한다.
+//
+// 사용 순서 : init(n) -> load()/clear() x2 -> fft() -> split() -> ... -> cross() -> fft(inverse) -> peak()
+
+namespace gccPhat {
+
+// 지원하는 최대 FFT 크기
+#ifndef GCC_PHAT_MAX_N
+#define GCC_PHAT_MAX_N 2048
+#endif
+
+struct Complex
+{
+    float re;
+    float im;
+};
+
+struct Lag
+{
+    float samples; // 첫 신호가 둘째 신호보다 늦은 샘플 수 (보간 포함)
+    float peak;    // 정규화된 상관 피크 (0~1, 높을수록 신뢰)
+};
+
+// FFT 크기 n (2의 거듭제곱) 의 회전인자 / Hann 창 표를 만든다.
+bool init(int n);
+int size();
+
+/**
+ * @brief 원형 버퍼의 두 구간(p1, p2)에서 size() 개 샘플을 읽어 평균을 빼고 Hann 창을 씌운다.
+ *
+ * @param work 복소 작업 버퍼 (size() 개)
+ * @param part 0 이면 실수부, 1 이면 허수부에 쓴다.
+ */
+void load(Complex *work, int part, const int16_t *p1, uint32_t n1, const int16_t *p2, uint32_t n2);
+// part 를 0 으로 채운다. (채널 수가 홀수일 때)
+void clear(Complex *work, int part);
+
+void fft(Complex *work, bool inverse);
+
+/**
+ * @brief 실수부/허수부에 실린 두 실수 신호의 스펙트럼을 분리한다. (0 ~ n/2, n/2+1 개)
+ *        y 가 NULL 이면 x 만 구한다.
+ */
+void split(const Complex *work, Complex *x, Complex *y);
+
+/**
+ * @brief PHAT 가중 교차 스펙트럼 a1*conj(b1) 와 a2*conj(b2) 를 실수부/허수부로 묶어 work 에 채운다.
+ *        a2 가 NULL 이면 둘째는 0. 이후 fft(work, true) 하면 실수부/허수부가 각각 상호상관이다.
+ */
+void cross(Complex *work, const Complex *a1, const Complex *b1, const Complex *a2, const Complex *b2);
+
+// 역변환된 상호상관에서 |lag| <= maxLag 범위의 피크를 찾는다.
+Lag peak(const Complex *work, int part, int maxLag);
+
+} // namespace gccPhat
+
+#endif // GCCPHAT_HPP
@@ -9,13 +9,22 @@ bluebyte 프로토콜의 레퍼런스 기기를 위한 펌웨어 입니다.
 #include <ArduinoJson.h>
 
 #include "config.hpp"
+#include "cmdLine.hpp"
 #include "etc.hpp"
 
 #include "context.hpp"
 
 #include "packet.hpp"
+#include "ble.hpp"
+#include "bleControl.hpp"
 
 #include "dataCapture.hpp"
+#include "adcCapture.hpp"
+#include "tdoaRefine.hpp"
+#include "tdoaSolver.hpp"
+#include "timeBase.hpp"
+#include "serialStream.hpp"
+#include "dlog.hpp"
 
 #if not defined(BUILTIN_LED)
 
@@ -35,26 +44,17 @@ Scheduler g_ts;
 Config g_config;
 
 uint32_t g_detect_delay;
+bool g_gcc_phat = false; // adc 모드에서 GCC-PHAT 으로 시차 정밀화
 
-// command parser
-extern String parseCmd(String _strLine);
+// 시리얼 명령 : 받은 만큼만 줄로 모으고 완성된 줄을 처리한다. (줄이 덜 와도 기다리지 않음)
+extern void pollCmd(HardwareSerial &port);
 
-// BLE
-extern void ble_setup(String strDeviceName);
-extern bool deviceConnected;
-extern boolean ble_sendTD(int *pDurationTickList, int numChannels); // 시차데이터 전송
+Task task_Cmd(CMD_POLL_MS, TASK_FOREVER, []()
+              { pollCmd(Serial); }, &g_ts, true);
 
-Task task_Cmd(100, TASK_FOREVER, []()
-              {
-    if (Serial.available() > 0)
-    {
-        String _strLine = Serial.readStringUntil('\n');
-        _strLine.trim();
-        
-        // Serial.println(_strLine);
-
-        Serial.println(parseCmd(_strLine));
-    } }, &g_ts, true);
+// BLE 제어 특성 요청 처리 (시리얼 명령과 같은 앱 태스크 : config 는 이 태스크만 만진다)
+Task task_BleControl(10, TASK_FOREVER, []()
+                     { bleControl::poll(); }, &g_ts, true);
 
 Task task_LedBlink(500, TASK_FOREVER, []()
                    { digitalWrite(BUILTIN_LED, !digitalRead(BUILTIN_LED)); }, &g_ts, true);
@@ -83,47 +83,96 @@ void stopBlink()
 TaskHandle_t taskHandle; // 태스크 핸들
 void dataLoop(void *param)
 {
-  int _results[MAX_CHANNELS];
-  for (int i = 0; i < dataCapture::channels_num; i++)
-  {
-    _results[i] = -1; // 초기화
-  }
+  // ISR 이 이 태스크를 직접 깨운다. (이벤트의 첫 에지, 마지막 채널 에지)
+  dataCapture::attachTask(xTaskGetCurrentTaskHandle());
 
   while (true)
   {
+    // 진행 중인 이벤트가 없으면 알림이 올 때까지 블록, 있으면 채널 타임아웃까지만 대기
+    ulTaskNotifyTake(pdTRUE, dataCapture::waitTicks());
 
-    if (dataCapture::checkallTriggered())
+    // 창이 닫힌 이벤트를 모두 처리
+    while (dataCapture::checkallTriggered())
     {
-
-      // 시차 데이터 전송
-      for (int i = 0; i < dataCapture::channels_num; i++)
+      // 파형 창이 있으면 첫 에지 시차를 GCC-PHAT 결과로 바꾼다.
+      if (g_gcc_phat)
       {
-        _results[i] = dataCapture::g_ResultTicks[i];
-        Serial.printf("%d ", _results[i]);
+        tdoaRefine::refine(dataCapture::g_ResultTime, dataCapture::g_ResultMask, dataCapture::g_ResultTicks);
       }
-      for (int i = dataCapture::channels_num; i < MAX_CHANNELS; i++)
-      {
-        _results[i] = -1;
-      }
-      Serial.println();
 
-      if (ble_sendTD(_results, dataCapture::channels_num))
+      // 모든 이벤트에 seq 를 매겨 기록 링에 남긴다. (연결이 끊겨도 resume 으로 다시 받는다)
+      uint32_t seq = ble_recordTD(dataCapture::g_ResultTicks, dataCapture::channels_num);
+
+      // 시차 데이터 시리얼 전송 : stream binary 면 바이너리 레코드, 아니면 텍스트 줄 (빠진 채널은 -1, UART 를 기다리지 않음)
+      serialStream::sendEvent(seq, dataCapture::g_ResultTicks, dataCapture::channels_num, dataCapture::g_ResultMask, dataCapture::g_ResultTime);
+
+      // TX 태스크로 넘기기만 한다. (BLE 스택 지연이 캡처 재무장을 늦추지 않음)
+      if (ble_sendTD(seq, dataCapture::g_ResultTicks, dataCapture::channels_num))
       {
-        Serial.println("BLE sendTD success");
+        DLOG_D(MAIN, "BLE sendTD queued");
       }
       else
       {
-        Serial.println("BLE sendTD failed");
+        DLOG_W(MAIN, "BLE sendTD failed (seq %u kept)", seq);
       }
+      // 브로드캐스트 광고 (ble_broadcast 1 일 때만, 연결과 상관없이)
+      ble_broadcastTD(seq, dataCapture::g_ResultTicks, dataCapture::channels_num, dataCapture::g_ResultMask, dataCapture::g_ResultTime);
 
-      // vTaskDelay(100 / portTICK_PERIOD_MS);
-      vTaskDelay(g_detect_delay / portTICK_PERIOD_MS);
+      // 센서 좌표가 설정되어 있으면 기기에서 바로 위치를 계산해 보낸다.
+      tdoaSolver::Fix fix;
+      if (tdoaSolver::ready() && tdoaSolver::solve(dataCapture::g_ResultTicks, dataCapture::g_ResultMask, fix))
+      {
+        serialStream::sendPos(seq, fix, dataCapture::g_ResultMask);
+        ble_sendPos(fix, dataCapture::g_ResultMask);
+      }
 
       dataCapture::reset();
     }
+  }
+}
+
+// config 의 핀 배열로 pins 를 덮어쓴다. (설정이 없으면 기본값 유지)
+int loadPins(const char *key, const configSchema::IntList &list, int *pins, int maxPins)
+{
+  if (list.count == 0)
+  {
+    Serial.printf("%s key not exist\n", key);
+    return 0;
+  }
 
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+  Serial.printf("%s key exist\n", key);
+
+  int count = list.count < maxPins ? list.count : maxPins;
+  for (int i = 0; i < count; i++)
+  {
+    pins[i] = list.v[i];
   }
+  return count;
+}
+
+// config 의 sensorPos ([[x,y],...] 또는 [[x,y,z],...], m, 채널 순서)로 위치 계산기를 설정한다.
+bool loadSolver(int channels, float sound_speed)
+{
+  const configSchema::PosList &pos = g_config.values().sensorPos;
+  if (pos.count == 0)
+  {
+    return false;
+  }
+
+  tdoaSolver::Setup solver = {};
+  solver.dim = pos.dim;
+  solver.soundSpeed = sound_speed;
+  for (int i = 0; i < pos.count && i < channels && i < SOLVER_MAX_SENSORS; i++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      solver.pos[i][k] = pos.v[i][k];
+    }
+    solver.numSensors++;
+  }
+
+  tdoaSolver::configure(solver);
+  return tdoaSolver::ready();
 }
 
 TaskHandle_t taskHandle_App;
@@ -131,7 +180,12 @@ void appLoop(void *param)
 {
   while (true)
   {
-    g_ts.execute();
+    // 실행할 태스크가 없던 바퀴(execute() == true)면 한 틱 양보한다.
+    // poll 모드에서 이 태스크는 코어 0 에서 돌므로 쉬지 않으면 IDLE0 이 못 돌아 태스크 워치독이 걸린다.
+    if (g_ts.execute())
+    {
+      vTaskDelay(1);
+    }
   }
 }
 
@@ -140,51 +194,137 @@ void setup()
 
   String strDeviceName = "BB32_" + String(getChipID().c_str());
 
-  Serial.begin(115200);
+  // 명령을 몰아 보내도 긴 명령(calibrate, bench) 처리 중에 넘치지 않게
+  Serial.setRxBufferSize(CMD_RX_BUFFER);
+  serialStream::setup();
+  Serial.begin(STREAM_TEXT_BAUD);
+  // 지연 로그 flush 태스크 (코어 0, 그 전에 쌓인 config 로그도 여기서 나간다)
+  dlog::start();
   delay(1000);
   Serial.printf("Start : %s\n", strDeviceName.c_str());
 
   g_config.load();
+  Serial.printf("config load : %u us\n", g_config.loadUs());
+  // 설정 저장은 코어 0 태스크가 모아서 (캡처 코어에서 플래시를 쓰지 않는다)
+  g_config.startCommitTask();
+  const configSchema::Values &cfg = g_config.values();
 
-  int channels_num = g_config.get<int>("ch_num", 2);
-  g_detect_delay = g_config.get<uint32_t>("detect_delay", 250);
+  int channels_num = cfg.ch_num;
+  if (channels_num > MAX_CHANNELS)
+  {
+    Serial.printf("ch_num %d > CAPTURE_CHANNELS %d\n", channels_num, MAX_CHANNELS);
+    channels_num = MAX_CHANNELS;
+  }
+  g_detect_delay = cfg.detect_delay;
+  float aperture_m = cfg.aperture_mm / 1000.0f;
+  float sound_speed = cfg.sound_speed;
 
   Serial.printf("channels_num : %d\n", channels_num);
   Serial.printf("detect_delay : %d\n", g_detect_delay);
 
-  int sensor_PINS[] = {18, 19, 23, 25, 26, 27};
+  // 캡처 모드 : edge (비교기 보드 디지털 에지, 핀별 ISR), bank (같은 에지, GPIO 뱅크 ISR 하나),
+  //             poll (같은 에지, 코어 1 전용 폴링 루프), adc (마이크 아날로그 파형 직접 샘플링)
+  String capture_mode = cfg.capture_mode;
+  Serial.printf("capture_mode : %s\n", capture_mode.c_str());
 
-  if (g_config.hasKey("sensorPins"))
+  timeBase::setup();
+
+  if (capture_mode == "adc")
   {
+    adcCapture::Settings adc;
+    int adc_PINS[] = {36, 39, 34, 35, 32, 33, 37, 38};
+    loadPins("adcPins", cfg.adcPins, adc_PINS, ADC_MAX_CHANNELS);
 
-    Serial.println("sensorPins key exist");
+    if (channels_num > ADC_MAX_CHANNELS)
+    {
+      channels_num = ADC_MAX_CHANNELS;
+    }
+    adc.numChannels = channels_num;
+    for (int i = 0; i < ADC_MAX_CHANNELS; i++)
+    {
+      adc.pins[i] = adc_PINS[i];
+    }
+    adc.rateHz = cfg.adc_rate;
+    adc.preSamples = cfg.adc_pre;
+    adc.postSamples = cfg.adc_post;
+    adc.threshold = cfg.adc_threshold;
 
-    JsonDocument _doc_sensorpins;
-    g_config.getArray("sensorPins", _doc_sensorpins);
+    for (int i = 0; i < channels_num; i++)
+    {
+      Serial.printf("%2d adc pin : %d\n", i, adc.pins[i]);
+    }
 
-    JsonArray _pins = _doc_sensorpins.as<JsonArray>();
+    if (!adcCapture::setup(adc))
+    {
+      Serial.println("adc capture setup failed");
+    }
+    dataCapture::setupSource("adc", adcCapture::numChannels(), adcCapture::ringLatencyNs());
+  }
+  else
+  {
+    // 기본 핀은 6채널까지, 그 이상은 config sensorPins 로 지정 (-1 : 미지정)
+    int sensor_PINS[MAX_CHANNELS];
+    const int default_PINS[] = {18, 19, 23, 25, 26, 27};
+    for (int i = 0; i < MAX_CHANNELS; i++)
+    {
+      sensor_PINS[i] = i < (int)(sizeof(default_PINS) / sizeof(default_PINS[0])) ? default_PINS[i] : -1;
+    }
+    loadPins("sensorPins", cfg.sensorPins, sensor_PINS, MAX_CHANNELS);
+
+    for (int i = 0; i < channels_num; i++)
+    {
+      if (sensor_PINS[i] < 0)
+      {
+        Serial.printf("sensor pin %d not set, ch_num %d -> %d\n", i, channels_num, i);
+        channels_num = i;
+        break;
+      }
+    }
 
-    int _index = 0;
-    for (JsonVariant v : _pins)
+    for (int i = 0; i < channels_num; i++)
     {
-      int pin = v.as<int>();
+      Serial.printf("%2d sensor pin : %d\n", i, sensor_PINS[i]);
+    }
 
-      sensor_PINS[_index] = pin;
-      // Serial.printf("%2d sensor pin : %d\n", _index, pin);
-      _index++;
+    if (capture_mode == "bank")
+    {
+      dataCapture::setupBank(sensor_PINS, channels_num);
+    }
+    else if (capture_mode == "poll")
+    {
+      dataCapture::setupPoll(sensor_PINS, channels_num, cfg.poll_burst_us);
+    }
+    else
+    {
+      dataCapture::setup(sensor_PINS, channels_num);
     }
   }
-  else
+
+  dataCapture::setCorrelation(aperture_m, sound_speed, g_detect_delay, cfg.ring_holdoff_us);
+  Serial.printf("window_us : %d\n", dataCapture::windowUs());
+
+  // 채널별 지연 보정 (calibrate 명령으로 측정, ns)
+  if (capture_mode != "adc")
+  {
+    int cal_offsets[MAX_CHANNELS] = {0};
+    int cal_count = loadPins("cal_offsets", cfg.cal_offsets, cal_offsets, MAX_CHANNELS);
+    dataCapture::setOffsets(cal_offsets, cal_count);
+  }
+
+  if (capture_mode == "adc" && cfg.gcc_phat != 0)
   {
-    Serial.println("sensorPins key not exist");
+    uint32_t window_length = cfg.adc_pre + cfg.adc_post;
+    g_gcc_phat = tdoaRefine::setup(dataCapture::channels_num, window_length, dataCapture::windowUs() * 1000);
+    Serial.printf("gcc_phat : %d\n", g_gcc_phat);
   }
 
-  for (int i = 0; i < channels_num; i++)
+  if (loadSolver(dataCapture::channels_num, sound_speed))
   {
-    Serial.printf("%2d sensor pin : %d\n", i, sensor_PINS[i]);
+    Serial.printf("solver : %dD, %d sensors\n", tdoaSolver::current().dim, tdoaSolver::current().numSensors);
   }
 
-  dataCapture::setup(sensor_PINS, channels_num);
+  // poll 모드는 코어 1 을 폴링 루프가 점유하므로 앱 태스크를 코어 0 으로 옮긴다.
+  BaseType_t app_core = (capture_mode == "poll") ? 0 : 1;
 
   // 태스크 생성 (코어 1에 고정)
   xTaskCreatePinnedToCore(
@@ -193,9 +333,9 @@ void setup()
       4096,       // 스택 크기
       // &dataProcess, // 태스크에 전달할 인수
       NULL,
-      1,           // 우선순위
+      2,           // 우선순위 (ISR 알림 즉시 appLoop 보다 먼저 실행)
       &taskHandle, // 태스크 핸들
-      1            // 코어 1에 고정
+      app_core     // 코어 1에 고정 (poll 모드는 0)
   );
   if (taskHandle == NULL)
   {
@@ -214,7 +354,7 @@ void setup()
       NULL,            // 태스크에 전달할 인수
       1,               // 우선순위
       &taskHandle_App, // 태스크 핸들
-      1                // 코어 1에 고정
+      app_core         // 코어 1에 고정 (poll 모드는 0)
   );
 
   pinMode(BUILTIN_LED, OUTPUT);
@@ -234,9 +374,27 @@ void setup()
 
   // BLE setup
   ble_setup(strDeviceName);
+  // 시차 묶음 전송 정책 (ble_batch_ms 0 : 이벤트마다 0x09)
+  ble_setBatch(cfg.ble_batch_ms, cfg.ble_batch_fill);
+  // v2 형식 tick 단위 (2^n ns, 클라이언트가 v2 를 고른 경우)
+  ble_setTickShift(cfg.ble_tick_shift);
+  // 연결 없이 광고로 이벤트 브로드캐스트 (GATT 서비스와 같이)
+  ble_setBroadcast(cfg.ble_broadcast != 0);
+  // 이벤트 기록 링 (resume 재전송), 0 이면 없음
+  ble_setHistory(cfg.ble_history, dataCapture::channels_num);
+  // 유선 바이너리 이벤트 스트림 (stream_binary 1 이면 부팅 로그 뒤 stream_baud 로 바꾼다)
+  if (cfg.stream_binary != 0)
+  {
+    Serial.printf("stream binary : %d baud\n", cfg.stream_baud);
+    serialStream::request(true, cfg.stream_baud);
+    serialStream::applyPending();
+  }
 
   // task manager start
   g_ts.startNow();
+
+  // poll 모드 폴링 태스크 시작 (이후 코어 1 의 loopTask 는 돌지 않는다)
+  dataCapture::start();
 }
 
 void loop()
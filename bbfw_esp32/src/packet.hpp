@@ -1,8 +1,14 @@
 #ifndef PACKET_HPP
 #define PACKET_HPP
 
+#include "dataCapture.hpp"
+
 #define CHECK_CODE 250130
 
+// 지원하는 시차 패킷 형식 (about 응답 header parm[0] 비트마스크, cmd 0x02 로 선택)
+#define BLE_FORMAT_V1 0x01 // cmd 0x09 / 0x0B : uint32_t ns 배열
+#define BLE_FORMAT_V2 0x02 // cmd 0x0C : 채널 비트맵 + zig-zag varint (아래)
+
 struct S_Ble_Header_Packet
 {
   uint32_t checkCode;
@@ -12,17 +18,366 @@ struct S_Ble_Header_Packet
 
 struct S_Ble_Packet_About
 {
-  S_Ble_Header_Packet header;
+  S_Ble_Header_Packet header; //cmd 0x01, parm[0] 지원 형식 (BLE_FORMAT_*)
   uint64_t chipId;
   u_int8_t version[3];
   u_int8_t chennelNum;
   uint32_t sampleRate;
 };
 
+// ping 왕복 (cmd 0x03) : 장치는 받은 그대로 notify 로 돌려준다.
+struct S_Ble_Packet_Ping
+{
+  S_Ble_Header_Packet header; //cmd 0x03
+  uint32_t token;             // 클라이언트가 정하는 값 (보낸 시각 등)
+};
+
+// resume (cmd 0x04) : 기록 링에서 fromSeq 부터 toSeq 전까지 다시 보낸다. (toSeq 0 = 요청 시점까지)
+// 응답은 같은 구조 (parm[0] 상태, 실제 보낼 범위), 재전송 묶음은 BLE_TD_FLAG_REPLAY 표시
+struct S_Ble_Packet_Resume
+{
+  S_Ble_Header_Packet header; //cmd 0x04, 응답 parm[0] BLE_RESUME_*
+  uint32_t fromSeq;
+  uint32_t toSeq;
+};
+
+#define BLE_RESUME_OK 0
+#define BLE_RESUME_PARTIAL 1 // 앞부분이 기록 링에서 밀려났다. (fromSeq 가 앞당겨짐)
+#define BLE_RESUME_NONE 2    // 기록 링 없음 (ble_history 0)
+
+// 시차 묶음 flags (0x0B parm[2], 0x0C flags)
+#define BLE_TD_FLAG_BENCH 0x01  // bench 합성 데이터 (클라이언트는 무시)
+#define BLE_TD_FLAG_REPLAY 0x02 // resume 재전송
+
+// 가변 길이 : 8 + 4 x parm[0] bytes (채널 수만큼만 전송)
 struct S_Ble_Packet_Data
 {
-  S_Ble_Header_Packet header; //cmd 0x09
-  uint32_t data[8]; //max 8 channel
+  S_Ble_Header_Packet header; //cmd 0x09, parm[0] 채널 수
+  uint32_t data[CAPTURE_CHANNELS]; //max CAPTURE_CHANNELS channel
+};
+
+// 요청할 ATT MTU (상대가 허락한 값까지만 쓴다, 기본 23)
+#define BLE_LOCAL_MTU 517
+
+// 여러 이벤트 묶음 (MTU 까지) : 12 + 4 x parm[0] x parm[1] bytes
+#define BLE_BATCH_MAX_WORDS ((BLE_LOCAL_MTU - 3 - 12) / 4)
+
+struct S_Ble_Packet_Batch
+{
+  S_Ble_Header_Packet header; //cmd 0x0B, parm[0] 채널 수, parm[1] 이벤트 수, parm[2] BLE_TD_FLAG_*
+  uint32_t seq;               // 첫 이벤트의 seq (묶음 안 이벤트는 seq 가 연속, 빠진 이벤트 확인용)
+  uint32_t data[BLE_BATCH_MAX_WORDS]; // 이벤트별 data[parm[0]] 가 parm[1] 개
+};
+
+struct S_Ble_Packet_Position
+{
+  S_Ble_Header_Packet header; //cmd 0x0A, parm[0] 차원(2/3), parm[1] 사용 채널 수, parm[2] 반복 수
+  float pos[3];               // 음원 좌표 (m), 2차원이면 pos[2] = 0
+  float residual;             // 거리차 잔차 RMS (m)
+  uint32_t mask;              // 계산에 쓴 채널 비트마스크
+};
+
+// v1 패킷은 자연 정렬로 패딩이 없다. (호스트 struct.unpack 과 맞춰 둔다)
+static_assert(sizeof(S_Ble_Header_Packet) == 8, "S_Ble_Header_Packet layout");
+static_assert(sizeof(S_Ble_Packet_About) == 24, "S_Ble_Packet_About layout");
+static_assert(sizeof(S_Ble_Packet_Ping) == 12, "S_Ble_Packet_Ping layout");
+static_assert(sizeof(S_Ble_Packet_Resume) == 16, "S_Ble_Packet_Resume layout");
+static_assert(sizeof(S_Ble_Packet_Position) == 28, "S_Ble_Packet_Position layout");
+
+//------------------------------------------------ control characteristic
+// 제어 특성 (CONTROL_UUID) : 설정/명령을 JSON 없이 바이너리로 주고받는다.
+//  요청 = header(cmd 0x20~) + 본문, 응답 = 같은 cmd 의 header + TLV 들 (제어 특성 notify)
+//  응답 header : parm[0] 상태 (BLE_CTL_*), parm[1] 1 이면 응답이 이어진다 (MTU 초과), parm[2] TLV 수
+//  TLV = key(1) + type(1) + len(1) + value(len), 값은 little-endian
+#define BLE_CTL_GET 0x20     // 본문 : key id 들 -> 각 key 의 TLV (없는 key 는 type NONE)
+#define BLE_CTL_SET 0x21     // 본문 : TLV 들, parm[0] 비트 0 저장, 비트 1 응답 후 재시작
+#define BLE_CTL_SAVE 0x22    // 설정 저장
+#define BLE_CTL_DUMP 0x23    // 저장된 모든 key 의 TLV
+#define BLE_CTL_CAPTURE 0x24 // parm[0] 1 시작, 0 정지 -> 응답 parm[2] 현재 상태
+#define BLE_CTL_STATS 0x25   // 통계 TLV (BLE_STAT_*)
+
+// 응답 상태
+#define BLE_CTL_OK 0
+#define BLE_CTL_BAD_KEY 1    // 모르는 key (응답 TLV 수 자리에 key id)
+#define BLE_CTL_BAD_VALUE 2  // 타입/길이/범위가 맞지 않음 (응답 TLV 수 자리에 key id)
+#define BLE_CTL_BAD_CMD 3
+#define BLE_CTL_BUSY 4       // 앞 요청을 처리 중이라 이 요청은 버렸다. (다시 보낸다)
+
+#define BLE_SET_SAVE 0x01
+#define BLE_SET_RESTART 0x02
+
+// TLV 값 타입
+enum BleTlvType : uint8_t
+{
+  TLV_NONE = 0, // 값 없음 (len 0)
+  TLV_I32 = 1,  // int32
+  TLV_F32 = 2,  // float
+  TLV_STR = 3,  // UTF-8 (널 없음)
+  TLV_I32A = 4, // int32 배열
+  TLV_POS = 5,  // uint8 차원(2/3) + float 좌표 배열 (센서 순서)
+};
+
+// 설정 key id (config 키 이름과 1:1)
+enum BleCtlKey : uint8_t
+{
+  KEY_CH_NUM = 1,
+  KEY_SENSOR_PINS = 2,
+  KEY_DETECT_DELAY = 3,
+  KEY_APERTURE_MM = 4,
+  KEY_SOUND_SPEED = 5,
+  KEY_CAPTURE_MODE = 6,
+  KEY_POLL_BURST_US = 7,
+  KEY_ADC_PINS = 8,
+  KEY_ADC_RATE = 9,
+  KEY_ADC_PRE = 10,
+  KEY_ADC_POST = 11,
+  KEY_ADC_THRESHOLD = 12,
+  KEY_GCC_PHAT = 13,
+  KEY_SENSOR_POS = 14,
+  KEY_CAL_OFFSETS = 15,
+  KEY_CAL_PIN = 16,
+  KEY_BENCH_PIN = 17,
+  KEY_BLE_BATCH_MS = 18,
+  KEY_BLE_BATCH_FILL = 19,
+  KEY_BLE_TICK_SHIFT = 20,
+  KEY_BLE_BROADCAST = 21,
+  KEY_BLE_HISTORY = 22,
+  KEY_STREAM_BINARY = 23,
+  KEY_STREAM_BAUD = 24,
+  KEY_RING_HOLDOFF_US = 25,
+};
+
+// 통계 key id (TLV_I32, uint32 값)
+enum BleStatKey : uint8_t
+{
+  STAT_EDGES = 0x80,
+  STAT_COMPLETE = 0x81,
+  STAT_PARTIAL = 0x82,
+  STAT_DROPPED = 0x83,
+  STAT_OVERFLOW = 0x84,
+  STAT_BLE_EVENTS = 0x85,
+  STAT_BLE_TX_DROPPED = 0x86,
+  STAT_FREE_HEAP = 0x87,
+  STAT_CAPTURE = 0x88, // 1 캡처 중, 0 정지
+};
+
+//------------------------------------------------ wire format v2
+// 명시적 packed little-endian 레이아웃 (호스트 '<' struct.unpack 그대로)
+//  header(10) + 이벤트 count 개
+//  이벤트 = varint(채널 비트맵) + 비트맵의 채널 순서로 varint(zigzag(tick))
+//  tick = 가장 빠른 채널 기준 시차 (ns) >> tickShift (반올림), 빠진 채널은 비트맵에 없다.
+// 4채널 1m 배열, tickShift 8 이면 채널당 1~2 바이트 : 이벤트 하나 약 8 바이트 (v1 0x09 는 8 + 32)
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "wire format is little-endian");
+
+struct __attribute__((packed)) S_Ble_V2_Header
+{
+  uint32_t checkCode;
+  uint8_t cmd;        // 0x0C
+  uint8_t count;      // 이벤트 수
+  uint8_t tickShift;  // tick 단위 = 2^tickShift ns
+  uint8_t flags;      // BLE_TD_FLAG_*
+  uint16_t seq;       // 첫 이벤트 seq 의 하위 16비트
+};
+static_assert(sizeof(S_Ble_V2_Header) == 10, "S_Ble_V2_Header layout");
+
+// 이벤트 하나의 최대 크기 (비트맵 varint 5 + 채널당 varint 5)
+#define BLE_V2_MAX_EVENT (5 + 5 * CAPTURE_CHANNELS)
+
+// 인코딩/디코딩 : 버퍼 위에서 바로 읽고 쓴다. (복사 없음, constexpr)
+namespace packetV2 {
+
+constexpr uint32_t zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+constexpr int32_t unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+constexpr int varintSize(uint32_t v)
+{
+  int n = 1;
+  while (v >= 0x80)
+  {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+// 쓴 바이트 수, 자리가 없으면 0
+constexpr int putVarint(uint8_t *p, const uint8_t *end, uint32_t v)
+{
+  int n = 0;
+  do
+  {
+    if (p + n >= end)
+    {
+      return 0;
+    }
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    p[n++] = v ? (b | 0x80) : b;
+  } while (v);
+  return n;
+}
+
+// 읽은 바이트 수, 잘렸거나 5 바이트를 넘으면 0
+constexpr int getVarint(const uint8_t *p, const uint8_t *end, uint32_t &v)
+{
+  v = 0;
+  for (int n = 0; n < 5 && p + n < end; n++)
+  {
+    v |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    if ((p[n] & 0x80) == 0)
+    {
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+constexpr int32_t toTick(uint32_t ns, int shift)
+{
+  return shift > 0 ? (int32_t)(((int64_t)(int32_t)ns + (1 << (shift - 1))) >> shift) : (int32_t)ns;
+}
+
+/**
+ * @brief 이벤트 하나를 out 에 인코딩
+ *
+ * @param ticks    채널별 시차 (ns), mask 에 없는 채널은 읽지 않는다.
+ * @param channels ticks 배열 길이
+ * @return 쓴 바이트 수, 자리가 없으면 0 (out 은 일부 써졌을 수 있다)
+ */
+constexpr int encodeEvent(uint8_t *out, const uint8_t *end, const uint32_t *ticks, int channels, uint32_t mask, int shift)
+{
+  mask &= dataCapture::channelMask(channels);
+  int n = putVarint(out, end, mask);
+  if (n == 0)
+  {
+    return 0;
+  }
+  for (int ch = 0; ch < channels; ch++)
+  {
+    if (mask & (1UL << ch))
+    {
+      int w = putVarint(out + n, end, zigzag(toTick(ticks[ch], shift)));
+      if (w == 0)
+      {
+        return 0;
+      }
+      n += w;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief 이벤트 하나를 디코딩 (빠진 채널은 TICK_MISSING)
+ *
+ * @param ticks    채널별 시차 (ns) 출력, channels 개
+ * @return 읽은 바이트 수, 잘못된 데이터면 0
+ */
+constexpr int decodeEvent(const uint8_t *in, const uint8_t *end, uint32_t *ticks, int channels, uint32_t &mask, int shift)
+{
+  int n = getVarint(in, end, mask);
+  if (n == 0 || (mask & ~dataCapture::channelMask(channels)) != 0)
+  {
+    return 0;
+  }
+  for (int ch = 0; ch < channels; ch++)
+  {
+    ticks[ch] = TICK_MISSING;
+    if (mask & (1UL << ch))
+    {
+      uint32_t v = 0;
+      int r = getVarint(in + n, end, v);
+      if (r == 0)
+      {
+        return 0;
+      }
+      n += r;
+      ticks[ch] = (uint32_t)unzigzag(v) << shift;
+    }
+  }
+  return n;
+}
+
+// 컴파일 시간 왕복 검사 : 4채널 중 3채널, 256ns 단위
+constexpr bool selfTest()
+{
+  const uint32_t ticks[4] = {0, 1200000, TICK_MISSING, 2300};
+  uint8_t buf[32] = {};
+  int n = encodeEvent(buf, buf + sizeof(buf), ticks, 4, 0x0B, 8);
+  uint32_t out[4] = {};
+  uint32_t mask = 0;
+  int r = decodeEvent(buf, buf + n, out, 4, mask, 8);
+  return n == 5 && r == n && mask == 0x0B && out[0] == 0 && out[1] == 1200128 && out[2] == TICK_MISSING && out[3] == 2304;
+}
+static_assert(selfTest(), "packetV2 round trip");
+
+} // namespace packetV2
+
+//------------------------------------------------ broadcast
+// 광고 제조사 데이터로 이벤트를 보낸다. (연결 없이 여러 스캐너가 같은 이벤트를 받는다)
+//  header(5) + 이벤트 count 개, 이벤트 = seq(2) + 시각(4, us) + v2 인코딩 (varint 채널 비트맵 + zigzag tick)
+//  legacy 광고 : 이벤트 하나씩 최근 BLE_BCAST_DEPTH 개를 돌려가며, extended 광고 : 최근 이벤트를 한 광고에
+#define BLE_BCAST_COMPANY 0xFFFF // 시험용 company id (스캐너는 이 id 로 거른다)
+#define BLE_BCAST_FORMAT 0xB1
+
+// 제조사 데이터 최대 크기 : legacy 31 - flags 3 - AD 헤더 2, extended 는 한 HCI 명령(251) 안에서
+#define BLE_BCAST_LEGACY_MAX 26
+#define BLE_BCAST_EXT_MAX 240
+
+struct __attribute__((packed)) S_Ble_Bcast_Header
+{
+  uint16_t company;  // BLE_BCAST_COMPANY
+  uint8_t format;    // BLE_BCAST_FORMAT
+  uint8_t tickShift; // tick 단위 = 2^tickShift ns (legacy 는 자리가 모자라면 키운다)
+  uint8_t count;     // 이벤트 수
+};
+static_assert(sizeof(S_Ble_Bcast_Header) == 5, "S_Ble_Bcast_Header layout");
+
+struct __attribute__((packed)) S_Ble_Bcast_Event
+{
+  uint16_t seq;    // 이벤트 순번 (스캐너는 같은 seq 를 한 번만 쓴다)
+  uint32_t timeUs; // 가장 빠른 채널 시각 (기기 timeBase, us 하위 32비트)
+};
+static_assert(sizeof(S_Ble_Bcast_Event) == 6, "S_Ble_Bcast_Event layout");
+
+//------------------------------------------------ serial binary stream
+// stream binary 모드의 시리얼 출력 (USB 유선)
+//  레코드 = payload + CRC32(payload, little-endian 4 bytes) 를 COBS 로 인코딩하고 0x00 으로 끝낸다.
+//  CRC32 는 zlib.crc32 와 같다. payload 첫 바이트가 레코드 종류
+#define STREAM_REC_EVENT 0x01 // S_Stream_Event + uint32_t ticks[channels] (ns, 빠진 채널 0xFFFFFFFF)
+#define STREAM_REC_TEXT 0x02  // 종류 1 byte + 텍스트 (명령 응답 JSON, 줄 끝 '\n' 까지 이어 붙인다)
+#define STREAM_REC_POS 0x03   // S_Stream_Pos
+
+struct __attribute__((packed)) S_Stream_Event
+{
+  uint8_t type;      // STREAM_REC_EVENT
+  uint8_t channels;  // 뒤따르는 ticks 수
+  uint16_t reserved;
+  uint32_t seq;      // 이벤트 seq (BLE 와 같은 번호)
+  uint64_t timeNs;   // 가장 빠른 채널 시각 (timeBase ns)
+  uint32_t mask;     // 에지가 들어온 채널 비트마스크
+};
+static_assert(sizeof(S_Stream_Event) == 20, "S_Stream_Event layout");
+
+struct __attribute__((packed)) S_Stream_Pos
+{
+  uint8_t type;       // STREAM_REC_POS
+  uint8_t dim;        // 2 / 3
+  uint8_t used;       // 계산에 쓴 센서 수
+  uint8_t iterations;
+  uint32_t seq;       // 같은 이벤트의 seq
+  float pos[3];       // 음원 좌표 (m)
+  float residual;     // 거리차 잔차 RMS (m)
+  uint32_t mask;      // 계산에 쓴 채널 비트마스크
 };
+static_assert(sizeof(S_Stream_Pos) == 28, "S_Stream_Pos layout");
 
 #endif
\ No newline at end of file
@@ -1,62 +1,741 @@
 #include <Arduino.h>
 
-#include <vector>
-
-#include "tonkey.hpp"
+#include "cmdLine.hpp"
+#include "lineAssembler.hpp"
+#include "poolAllocator.hpp"
 
 #include "config.hpp"
 #include "context.hpp"
+#include "dataCapture.hpp"
+#include "adcCapture.hpp"
+#include "calPulse.hpp"
+#include "ble.hpp"
+#include "tdoaRefine.hpp"
+#include "tdoaSolver.hpp"
+#include "serialStream.hpp"
+#include "dlog.hpp"
 
 extern Config g_config;
 
+// 명령 처리기 : 토큰은 시리얼 줄 버퍼 안을 가리킨다.
+typedef void (*CmdHandler)(const CmdTokens &tokens, JsonDocument &_res_doc);
+// bench 대상 : iterations 가 0 이면 대상별 기본값
+typedef void (*BenchHandler)(int iterations, JsonDocument &_res_doc);
+
+void parseCmd(char *line, Print &out);
+
+// 시리얼 명령 줄 (pollCmd)
+static LineAssembler<CMD_LINE_MAX> s_cmdLine;
 
-tonkey g_MainParser;
+// 명령 응답 JSON 문서의 메모리 (config set 의 값 문서도 같이 쓴다, 앱 태스크 전용)
+PoolAllocator<CMD_JSON_POOL_BYTES> g_cmdJsonPool;
 
-String parseCmd(String _strLine)
+/**
+ * @brief 채널 간 디스패치 스큐 측정
+ *        bench_pin 출력을 모든 센서 입력에 같이 물려 두고 펄스를 보내면,
+ *        이벤트 안 채널 간 시각 폭이 곧 캡처 경로가 만드는 거짓 시차다.
+ *        capture_mode edge / bank 에서 각각 돌려 비교한다.
+ */
+static void benchSkew(int pulses, JsonDocument &_res_doc)
 {
+    if (pulses <= 0)
+    {
+        pulses = 100;
+    }
+
+    int pin = g_config.values().bench_pin;
+    if (pin < 0)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "bench_pin not set";
+        return;
+    }
 
-    JsonDocument _res_doc;
+    // 펄스 간격 : 상관 창 + detect_delay 보다 넉넉히
+    uint32_t gapMs = dataCapture::windowUs() / 1000 + g_config.values().detect_delay + 20;
 
-    g_MainParser.parse(_strLine);
-    if (g_MainParser.getTokenCount() > 0)
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    delay(gapMs);
+
+    dataCapture::resetSpread();
+    for (int i = 0; i < pulses; i++)
     {
-        String cmd = g_MainParser.getToken(0);
+        digitalWrite(pin, HIGH);
+        delayMicroseconds(50);
+        digitalWrite(pin, LOW);
+        delay(gapMs);
+    }
+
+    dataCapture::Stats stats;
+    dataCapture::getStats(stats);
+
+    _res_doc["result"] = "ok";
+    _res_doc["capture"] = dataCapture::backendName();
+    _res_doc["pulses"] = pulses;
+    _res_doc["events"] = stats.spreadEvents;
+    _res_doc["skew_avg_ns"] = stats.spreadAvgNs;
+    _res_doc["skew_max_ns"] = stats.spreadMaxNs;
+}
 
-        if (cmd == "about")
+// calibrate 진행 상태 : 명령은 시작만 하고 pollCmd 가 펄스 송신과 결과 응답을 이어 간다.
+enum CalState : uint8_t
+{
+    CAL_IDLE,
+    CAL_STARTING, // 캡처 태스크가 보정 시작을 적용하기를 기다림
+    CAL_FIRING,  // RMT 펄스 열 송신 중
+    CAL_SETTLE,  // 마지막 이벤트가 닫히기를 기다림
+    CAL_COLLECT, // 캡처 태스크가 결과를 넘기기를 기다림
+};
+static CalState s_calState = CAL_IDLE;
+static int s_calShots = 0;
+static uint32_t s_calPeriodUs = 0;
+static uint32_t s_calSettleMs = 0;
+
+/**
+ * @brief 채널별 지연 보정 시작
+ *        cal_pin(없으면 bench_pin) 의 RMT 펄스를 모든 센서 입력에 같이 물려 두고 shots 번 쏜다.
+ *        펄스는 RMT 가 내고 기다리지 않으므로 그동안 다른 명령, BLE 제어, LED 태스크가 그대로 돈다.
+ *        끝나면 pollCalibrate 가 결과 응답을 한 줄 더 보낸다.
+ */
+static void runCalibrate(int shots, JsonDocument &_res_doc)
+{
+    if (s_calState != CAL_IDLE)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "calibrate busy";
+        return;
+    }
+
+    const configSchema::Values &cfg = g_config.values();
+    int pin = cfg.cal_pin >= 0 ? cfg.cal_pin : cfg.bench_pin;
+    if (pin < 0)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "cal_pin not set";
+        return;
+    }
+    if (strcmp(dataCapture::backendName(), "adc") == 0 || dataCapture::channels_num < 2)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "need edge capture with 2+ channels";
+        return;
+    }
+
+    // 펄스 간격 : 상관 창 + detect_delay 보다 넉넉히 (bench skew 와 같다)
+    uint32_t periodUs = dataCapture::windowUs() + (cfg.detect_delay + 20) * 1000;
+    if (periodUs > calPulse::maxPeriodUs())
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "detect_delay too long for calibrate";
+        _res_doc["max_period_us"] = calPulse::maxPeriodUs();
+        return;
+    }
+    if (!calPulse::setup(pin))
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "rmt setup failed";
+        return;
+    }
+    s_calPeriodUs = periodUs;
+    s_calShots = shots;
+
+    // 보정값은 캡처 태스크가 비운다. 적용을 확인한 뒤 pollCalibrate 가 펄스를 쏜다.
+    dataCapture::requestCalibrationBegin();
+    s_calState = CAL_STARTING;
+
+    _res_doc["result"] = "started";
+    _res_doc["shots"] = shots;
+    _res_doc["duration_ms"] = calPulse::durationMs(shots, s_calPeriodUs);
+}
+
+// 보정 결과 : 새 보정값 적용 및 저장
+static void finishCalibrate(const dataCapture::CalResult &cal, JsonDocument &_res_doc)
+{
+    _res_doc["cmd"] = "calibrate";
+    if (calPulse::failed() || cal.events == 0)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = calPulse::failed() ? "rmt write failed" : "no complete events";
+        _res_doc["events"] = cal.events;
+        return;
+    }
+
+    int offsets[MAX_CHANNELS];
+    int32_t saved[MAX_CHANNELS];
+    JsonArray offsetNs = _res_doc["offset_ns"].to<JsonArray>();
+    JsonArray jitterNs = _res_doc["jitter_ns"].to<JsonArray>();
+    for (int ch = 0; ch < dataCapture::channels_num; ch++)
+    {
+        offsets[ch] = cal.offsetNs[ch];
+        saved[ch] = cal.offsetNs[ch];
+        offsetNs.add(cal.offsetNs[ch]);
+        jitterNs.add(cal.jitterNs[ch]);
+    }
+    dataCapture::setOffsets(offsets, dataCapture::channels_num);
+    g_config.setInts(KEY_CAL_OFFSETS, saved, dataCapture::channels_num);
+
+    _res_doc["result"] = "ok";
+    _res_doc["capture"] = dataCapture::backendName();
+    _res_doc["shots"] = s_calShots;
+    _res_doc["events"] = cal.events;
+}
+
+/**
+ * @brief calibrate 진행 (pollCmd 에서, 기다리지 않는다)
+ *        펄스 송신 -> 마지막 이벤트가 닫힐 때까지 한 간격 -> 캡처 태스크가 넘긴 결과로 응답
+ */
+static void pollCalibrate(Print &out)
+{
+    switch (s_calState)
+    {
+    case CAL_STARTING:
+        if (!dataCapture::calibrating())
+        {
+            break;
+        }
+        if (!calPulse::start(s_calShots, s_calPeriodUs))
         {
-            /* code */
-            _res_doc["result"] = "ok";
-            _res_doc["os"] = "cronos-v1";
-            _res_doc["app"] = "bluebyte";
-            _res_doc["version"] = String(g_version[0]) + "." + String(g_version[1]) + "." + String(g_version[2]);
-            // _res_doc["author"] = "gbox3d";
-            // _res_doc["sample_rate"] = sample_rate;
-            // _res_doc["num_channels"] = NUM_CHANNELS;
+            // 결과 응답이 rmt write failed 로 나가고 측정 전 보정값은 캡처 태스크가 되돌린다.
+            dataCapture::requestCalibrationEnd();
+            s_calState = CAL_COLLECT;
+            break;
+        }
+        s_calState = CAL_FIRING;
+        break;
+
+    case CAL_FIRING:
+        if (!calPulse::poll())
+        {
+            s_calSettleMs = millis();
+            s_calState = CAL_SETTLE;
+        }
+        break;
+
+    case CAL_SETTLE:
+        if (millis() - s_calSettleMs > s_calPeriodUs / 1000 + 1)
+        {
+            dataCapture::requestCalibrationEnd();
+            s_calState = CAL_COLLECT;
+        }
+        break;
+
+    case CAL_COLLECT:
+    {
+        dataCapture::CalResult cal;
+        if (!dataCapture::takeCalibration(cal))
+        {
+            break;
+        }
+        s_calState = CAL_IDLE;
+        JsonDocument _res_doc(&g_cmdJsonPool);
+        finishCalibrate(cal, _res_doc);
+        serializeJson(_res_doc, out);
+        out.println();
+        calPulse::end();
+    }
+    break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief 위치 계산 속도/정확도 측정
+ *        설정된 센서 배치(없으면 1m 정사각형 4개)에서 격자 위 음원의 시차를 만들어 풀어 본다.
+ */
+static void benchSolver(int iterations, JsonDocument &_res_doc)
+{
+    if (iterations <= 0)
+    {
+        iterations = 1000;
+    }
+
+    // 지역 배치로 푼다. (dataLoop 가 쓰는 배치는 건드리지 않는다)
+    tdoaSolver::Setup setup = {};
+    if (tdoaSolver::ready())
+    {
+        setup = tdoaSolver::current();
+    }
+    else
+    {
+        setup.numSensors = 4;
+        setup.dim = 2;
+        setup.soundSpeed = DEFAULT_SOUND_SPEED;
+        const float corners[4][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}};
+        for (int i = 0; i < 4; i++)
+        {
+            setup.pos[i][0] = corners[i][0];
+            setup.pos[i][1] = corners[i][1];
+        }
+    }
+    tdoaSolver::prepare(setup);
+
+    // 센서를 감싸는 상자
+    float lo[3] = {0}, hi[3] = {0};
+    for (int i = 0; i < setup.numSensors; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            if (i == 0 || setup.pos[i][k] < lo[k])
+            {
+                lo[k] = setup.pos[i][k];
+            }
+            if (i == 0 || setup.pos[i][k] > hi[k])
+            {
+                hi[k] = setup.pos[i][k];
+            }
+        }
+    }
+
+    uint32_t mask = (1UL << setup.numSensors) - 1;
+    uint32_t seed = 1;
+    uint32_t maxUs = 0;
+    int64_t totalUs = 0;
+    float maxErr = 0;
+    int failed = 0;
+
+    for (int n = 0; n < iterations; n++)
+    {
+        float src[3] = {0};
+        for (int k = 0; k < setup.dim; k++)
+        {
+            seed = seed * 1664525UL + 1013904223UL;
+            src[k] = lo[k] + (hi[k] - lo[k]) * ((seed >> 8) & 0xFFFF) / 65535.0f;
+        }
+
+        float dist[SOLVER_MAX_SENSORS];
+        float minDist = 0;
+        for (int i = 0; i < setup.numSensors; i++)
+        {
+            float s = 0;
+            for (int k = 0; k < setup.dim; k++)
+            {
+                s += (src[k] - setup.pos[i][k]) * (src[k] - setup.pos[i][k]);
+            }
+            dist[i] = sqrtf(s);
+            if (i == 0 || dist[i] < minDist)
+            {
+                minDist = dist[i];
+            }
+        }
+        uint32_t ticks[SOLVER_MAX_SENSORS];
+        for (int i = 0; i < setup.numSensors; i++)
+        {
+            ticks[i] = (uint32_t)((dist[i] - minDist) / setup.soundSpeed * 1e9f);
+        }
+
+        tdoaSolver::Fix fix;
+        int64_t t0 = esp_timer_get_time();
+        bool ok = tdoaSolver::solve(setup, ticks, mask, fix);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+        totalUs += us;
+        if (us > maxUs)
+        {
+            maxUs = us;
+        }
+        if (!ok)
+        {
+            failed++;
+            continue;
+        }
+        float err = 0;
+        for (int k = 0; k < setup.dim; k++)
+        {
+            err += (fix.pos[k] - src[k]) * (fix.pos[k] - src[k]);
+        }
+        err = sqrtf(err);
+        if (err > maxErr)
+        {
+            maxErr = err;
+        }
+    }
+
+    _res_doc["result"] = "ok";
+    _res_doc["sensors"] = setup.numSensors;
+    _res_doc["dim"] = setup.dim;
+    _res_doc["events"] = iterations;
+    _res_doc["avg_us"] = (float)totalUs / iterations;
+    _res_doc["max_us"] = maxUs;
+    _res_doc["max_err_m"] = maxErr;
+    _res_doc["failed"] = failed;
+}
+
+/**
+ * @brief 설정 읽기 비용 비교
+ *        예전 Config::get 은 읽을 때마다 저장된 JSON 문자열 전체를 새 JsonDocument 로 파싱했다.
+ *        같은 문자열로 그 방식을 흉내 낸 시간과 values() 필드 읽기 시간을 잰다.
+ *        부팅 때는 setup 이 key 마다 한 번씩 읽었으므로 (key 수 x JSON 파싱) 과 지금 load() 한 번을 같이 보고한다.
+ */
+static void benchConfig(int iterations, JsonDocument &_res_doc)
+{
+    if (iterations <= 0)
+    {
+        iterations = 200;
+    }
+
+    // 지금 설정의 저장 형식 (예전 Config::jsonDoc 과 같은 문자열)
+    JsonDocument stored;
+    g_config.dump(stored.to<JsonObject>());
+    String json;
+    serializeJson(stored, json);
+
+    volatile int32_t sink = 0;
+    int64_t t0 = esp_timer_get_time();
+    for (int n = 0; n < iterations; n++)
+    {
+        JsonDocument doc;
+        deserializeJson(doc, json);
+        sink = doc["detect_delay"].as<int32_t>();
+    }
+    int64_t jsonUs = esp_timer_get_time() - t0;
+
+    // 필드 읽기는 너무 짧아서 1000 배 돌린다. (컴파일러가 루프 밖으로 빼지 못하게 volatile 로 읽음)
+    const volatile int32_t *field = &g_config.values().detect_delay;
+    int reads = iterations * 1000;
+    t0 = esp_timer_get_time();
+    for (int n = 0; n < reads; n++)
+    {
+        sink = *field;
+    }
+    int64_t typedUs = esp_timer_get_time() - t0;
+    (void)sink;
+
+    float jsonGetUs = (float)jsonUs / iterations;
+    _res_doc["result"] = "ok";
+    _res_doc["iterations"] = iterations;
+    _res_doc["json_bytes"] = json.length();
+    _res_doc["json_get_us"] = jsonGetUs;
+    _res_doc["typed_get_ns"] = typedUs * 1000.0f / reads;
+    _res_doc["keys"] = configSchema::count;
+    _res_doc["json_boot_us"] = jsonGetUs * configSchema::count;
+    _res_doc["load_us"] = g_config.loadUs();
+}
+
+/**
+ * @brief 전송 방식별 BLE 처리량 (연결된 상태에서 초당 이벤트 수, 이벤트당 바이트 수)
+ */
+static void benchBle(int iterations, JsonDocument &_res_doc)
+{
+    if (iterations <= 0)
+    {
+        iterations = 200;
+    }
+
+    S_Ble_Bench bench;
+    if (ble_bench(iterations, dataCapture::channels_num, bench))
+    {
+        S_Ble_Stats ble;
+        ble_getStats(ble);
+        _res_doc["result"] = "ok";
+        _res_doc["events"] = iterations;
+        _res_doc["mtu"] = ble.mtu;
+        _res_doc["single_eps"] = bench.single.eps;
+        _res_doc["single_bytes"] = bench.single.bytesPerEvent;
+        _res_doc["batch_eps"] = bench.batch.eps;
+        _res_doc["batch_bytes"] = bench.batch.bytesPerEvent;
+        _res_doc["v2_eps"] = bench.v2.eps;
+        _res_doc["v2_bytes"] = bench.v2.bytesPerEvent;
+    }
+    else
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "ble not connected";
+    }
+}
+
+static void benchGcc(int iterations, JsonDocument &_res_doc)
+{
+    // GCC-PHAT 4채널 합성 신호 처리 속도
+    if (iterations <= 0)
+    {
+        iterations = 20;
+    }
+
+    tdoaRefine::BenchResult bench;
+    if (tdoaRefine::bench(iterations, bench))
+    {
+        _res_doc["result"] = "ok";
+        _res_doc["events"] = bench.events;
+        _res_doc["dual_us"] = bench.dualUs;
+        _res_doc["single_us"] = bench.singleUs;
+        _res_doc["events_per_sec"] = bench.dualUs > 0 ? 1000000 / bench.dualUs : 0;
+        JsonArray lags = _res_doc["lag_ns"].to<JsonArray>();
+        for (int i = 0; i < 4; i++)
+        {
+            lags.add(bench.lagNs[i]);
+        }
+    }
+    else
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "bench alloc failed";
+    }
+}
+
+static void benchLines(int iterations, JsonDocument &_res_doc);
+
+static constexpr CmdEntry<BenchHandler> s_benchTargets[] = {
+    {"ble", benchBle},
+    {"config", benchConfig},
+    {"gcc", benchGcc},
+    {"lines", benchLines},
+    {"skew", benchSkew},
+    {"solve", benchSolver},
+};
+CMD_TABLE_SORTED(s_benchTargets);
+
+//------------------------------------------------ commands
+static void cmdAbout(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    _res_doc["result"] = "ok";
+    _res_doc["os"] = "cronos-v1";
+    _res_doc["app"] = "bluebyte";
+    char version[16];
+    snprintf(version, sizeof(version), "%d.%d.%d", g_version[0], g_version[1], g_version[2]);
+    _res_doc["version"] = version;
+    // _res_doc["author"] = "gbox3d";
+    // _res_doc["sample_rate"] = sample_rate;
+    // _res_doc["num_channels"] = NUM_CHANNELS;
+    _res_doc["capture"] = dataCapture::backendName();
+    _res_doc["tick_unit"] = "ns";
+    _res_doc["edge_ring"] = EDGE_RING_SIZE;
+    _res_doc["ble_stack"] = ble_stackName();
 // esp8266 chip id
 #ifdef ESP8266
-            _res_doc["chipid"] = ESP.getChipId();
+    _res_doc["chipid"] = ESP.getChipId();
 #elif ESP32
-            _res_doc["chipid"] = ESP.getEfuseMac();
+    _res_doc["chipid"] = ESP.getEfuseMac();
 #endif
-        }
-        else if (cmd == "reboot")
+}
+
+static void cmdBench(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    // bench [gcc|solve|skew|ble|config|lines] [iterations]
+    const CmdEntry<BenchHandler> *target = cmdFind(s_benchTargets, tokens.get(1, "gcc"));
+    if (target == NULL)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "unknown bench target";
+        return;
+    }
+    target->handler(tokens.toInt(2), _res_doc);
+}
+
+static void cmdCalibrate(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    // calibrate [shots] | calibrate clear
+    if (tokens.is(1, "clear"))
+    {
+        if (s_calState != CAL_IDLE)
         {
+            _res_doc["result"] = "fail";
+            _res_doc["ms"] = "calibrate busy";
+            return;
+        }
+        g_config.reset(KEY_CAL_OFFSETS);
+        dataCapture::setOffsets(NULL, 0);
+        _res_doc["result"] = "ok";
+    }
+    else
+    {
+        int shots = tokens.toInt(1);
+        runCalibrate(shots > 0 ? shots : 2000, _res_doc);
+    }
+}
+
+static void cmdConfig(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    g_config.parseCmd(tokens, _res_doc);
+}
+
+static void cmdReboot(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
 #ifdef ESP8266
-            ESP.reset();
+    ESP.reset();
 #elif ESP32
-            ESP.restart();
+    ESP.restart();
 #endif
+}
+
+static void cmdStats(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    dataCapture::Stats stats;
+    dataCapture::getStats(stats);
+
+    _res_doc["result"] = "ok";
+    _res_doc["edges"] = stats.edges;
+    _res_doc["complete"] = stats.complete;
+    _res_doc["partial"] = stats.partial;
+    _res_doc["orphan"] = stats.orphan;
+    _res_doc["ringing"] = stats.ringing;
+    _res_doc["holdoff"] = stats.holdoff;
+    _res_doc["forced"] = stats.forced;
+    _res_doc["dropped"] = stats.dropped;
+    _res_doc["window_us"] = dataCapture::windowUs();
+    _res_doc["spread_avg_ns"] = stats.spreadAvgNs;
+    _res_doc["spread_max_ns"] = stats.spreadMaxNs;
+
+    if (strcmp(dataCapture::backendName(), "poll") == 0)
+    {
+        _res_doc["poll_loop_ns"] = stats.pollLoopNs;
+        _res_doc["poll_missed"] = stats.pollMissed;
+    }
+
+    if (strcmp(dataCapture::backendName(), "adc") == 0)
+    {
+        adcCapture::Stats adc;
+        adcCapture::getStats(adc);
+        _res_doc["adc_frames"] = adc.frames;
+        _res_doc["adc_dma_overflow"] = adc.dmaOverflow;
+        _res_doc["adc_triggers"] = adc.triggers;
+        _res_doc["adc_windows_stale"] = adc.windowsStale;
+        _res_doc["adc_windows_busy"] = adc.windowsBusy;
+        _res_doc["adc_overrun"] = adc.overrun;
+        _res_doc["adc_resync"] = adc.resync;
+        _res_doc["adc_windows_lost"] = adc.windowsLost;
+        _res_doc["adc_skew_ns"] = adc.skewNs;
+
+        if (tdoaRefine::ready())
+        {
+            tdoaRefine::Stats refine;
+            tdoaRefine::getStats(refine);
+            _res_doc["gcc_refined"] = refine.refined;
+            _res_doc["gcc_no_window"] = refine.noWindow;
+            _res_doc["gcc_overrun"] = refine.overrun;
+            _res_doc["gcc_last_us"] = refine.lastUs;
+            _res_doc["gcc_max_us"] = refine.maxUs;
+            _res_doc["gcc_min_peak"] = refine.minPeak;
         }
-        else if (cmd == "config")
+    }
+    S_Ble_Stats ble;
+    ble_getStats(ble);
+    _res_doc["ble_mtu"] = ble.mtu;
+    _res_doc["ble_packets"] = ble.packets;
+    _res_doc["ble_events"] = ble.events;
+    _res_doc["ble_bytes"] = ble.bytes;
+    _res_doc["ble_tx_queued"] = ble.txQueued;
+    _res_doc["ble_tx_dropped"] = ble.txDropped;
+    _res_doc["ble_tx_high_water"] = ble.txHighWater;
+    _res_doc["ble_heap"] = ble.stackHeap;
+    _res_doc["ble_notify_failed"] = ble.notifyFailed;
+    _res_doc["ble_replayed"] = ble.replayed;
+    _res_doc["ble_history_lost"] = ble.historyLost;
+    _res_doc["free_heap"] = ESP.getFreeHeap();
+    _res_doc["cmd_lines"] = s_cmdLine.lines();
+    _res_doc["cmd_overlong"] = s_cmdLine.overlong();
+    _res_doc["cmd_json_peak"] = g_cmdJsonPool.peak();
+    _res_doc["cmd_json_failed"] = g_cmdJsonPool.failed();
+
+    serialStream::Stats stream;
+    serialStream::getStats(stream);
+    _res_doc["stream_records"] = stream.records;
+    _res_doc["stream_bytes"] = stream.bytes;
+    _res_doc["stream_dropped"] = stream.dropped;
+
+    dlog::Stats log;
+    dlog::getStats(log);
+    _res_doc["log_written"] = log.written;
+    _res_doc["log_dropped"] = log.dropped;
+    _res_doc["log_suppressed"] = log.suppressed;
+    _res_doc["log_high_water"] = log.highWater;
+    _res_doc["log_capacity"] = log.capacity;
+
+    Config::CommitStats commit;
+    g_config.getCommitStats(commit);
+    _res_doc["config_commits"] = commit.commits;
+    _res_doc["config_keys_written"] = commit.keysWritten;
+    _res_doc["config_commit_us"] = commit.lastUs;
+    _res_doc["config_commit_max_us"] = commit.maxUs;
+    _res_doc["config_write_failed"] = commit.failed;
+    _res_doc["config_dirty"] = commit.dirty;
+
+    _res_doc["ring_capacity"] = stats.ringCapacity;
+    _res_doc["ring_high_water"] = stats.ringHighWater;
+    _res_doc["ring_overflow"] = stats.overflow;
+}
+
+static void cmdStream(const CmdTokens &tokens, JsonDocument &_res_doc)
+{
+    // stream | stream binary [baud] | stream text
+    bool binary = serialStream::binary();
+    uint32_t baud = serialStream::baud();
+    if (tokens.is(1, "binary"))
+    {
+        long value = tokens.toInt(2, g_config.values().stream_baud);
+        if (value < STREAM_MIN_BAUD || value > STREAM_MAX_BAUD)
         {
-            std::vector<String> tokens;
-            for (int i = 0; i < g_MainParser.getTokenCount(); i++)
-            {
-                tokens.push_back(g_MainParser.getToken(i));
-            }
-            g_config.parseCmd(tokens, _res_doc);
+            _res_doc["result"] = "fail";
+            _res_doc["ms"] = "bad baud";
+            _res_doc["min"] = STREAM_MIN_BAUD;
+            _res_doc["max"] = STREAM_MAX_BAUD;
+            return;
         }
+        binary = true;
+        baud = value;
+    }
+    else if (tokens.is(1, "text"))
+    {
+        binary = false;
+        baud = STREAM_TEXT_BAUD;
+    }
+    else if (tokens.count() > 1)
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "unknown sub command";
+        return;
+    }
+    // 이 응답은 지금 모드/baud 로 나가고 그 뒤에 바뀐다. (mode, baud 는 바뀐 뒤 값)
+    if (binary != serialStream::binary() || baud != serialStream::baud())
+    {
+        serialStream::request(binary, baud);
+    }
+
+    serialStream::Stats stream;
+    serialStream::getStats(stream);
+    _res_doc["result"] = "ok";
+    _res_doc["mode"] = binary ? "binary" : "text";
+    _res_doc["baud"] = baud;
+    _res_doc["records"] = stream.records;
+    _res_doc["bytes"] = stream.bytes;
+    _res_doc["dropped"] = stream.dropped;
+}
+
+static constexpr CmdEntry<CmdHandler> s_commands[] = {
+    {"about", cmdAbout},
+    {"bench", cmdBench},
+    {"calibrate", cmdCalibrate},
+    {"config", cmdConfig},
+    {"reboot", cmdReboot},
+    {"stats", cmdStats},
+    {"stream", cmdStream},
+};
+CMD_TABLE_SORTED(s_commands);
+
+/**
+ * @brief 시리얼 명령 한 줄 처리, 응답 JSON 한 줄을 out 에 쓴다.
+ *        line 은 제자리에서 토큰으로 잘린다.
+ */
+void parseCmd(char *line, Print &out)
+{
+    JsonDocument _res_doc(&g_cmdJsonPool);
 
+    CmdTokens tokens;
+    tokens.parse(line);
+    if (tokens.overflow())
+    {
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "too many tokens";
+    }
+    else if (tokens.count() > 0)
+    {
+        const CmdEntry<CmdHandler> *cmd = cmdFind(s_commands, tokens.get(0));
+        if (cmd != NULL)
+        {
+            cmd->handler(tokens, _res_doc);
+        }
         else
         {
             _res_doc["result"] = "fail";
@@ -69,5 +748,162 @@ String parseCmd(String _strLine)
         _res_doc["ms"] = "need command";
     }
 
-    return _res_doc.as<String>();
-}
\ No newline at end of file
+    serializeJson(_res_doc, out);
+    out.println();
+}
+
+// 긴 줄을 버렸을 때의 응답 (parseCmd 응답과 같은 모양)
+static void replyOverlong(Print &out)
+{
+    JsonDocument _res_doc(&g_cmdJsonPool);
+    _res_doc["result"] = "fail";
+    _res_doc["ms"] = "line too long";
+    serializeJson(_res_doc, out);
+    out.println();
+}
+
+/**
+ * @brief 시리얼 명령 받기 (task_Cmd, CMD_POLL_MS 마다)
+ *        UART 에 와 있는 바이트만 읽어 줄로 모으고, 완성된 줄은 모두 바로 처리한다.
+ *        줄이 덜 왔으면 다음 주기에 이어 모은다. (readStringUntil 처럼 timeout 동안 멈추지 않음)
+ *        한 번에 CMD_RX_BUDGET 바이트까지만 읽어 다른 태스크가 밀리지 않게 한다.
+ *        진행 중인 calibrate (펄스 송신, 결과 응답) 도 여기서 이어 간다.
+ */
+void pollCmd(HardwareSerial &port)
+{
+    pollCalibrate(serialStream::replyOut(port));
+
+    uint8_t chunk[64];
+    size_t budget = CMD_RX_BUDGET;
+    while (budget > 0)
+    {
+        int avail = port.available();
+        if (avail <= 0)
+        {
+            break;
+        }
+        size_t n = (size_t)avail < sizeof(chunk) ? (size_t)avail : sizeof(chunk);
+        if (n > budget)
+        {
+            n = budget;
+        }
+        n = port.read(chunk, n);
+        if (n == 0)
+        {
+            break;
+        }
+        budget -= n;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            // stream binary 모드면 응답은 텍스트 레코드로
+            switch (s_cmdLine.push((char)chunk[i]))
+            {
+            case LineAssembler<CMD_LINE_MAX>::LINE:
+                parseCmd(s_cmdLine.line(), serialStream::replyOut(port));
+                // stream 명령의 모드/baud 변경은 응답이 나간 뒤
+                serialStream::applyPending();
+                break;
+            case LineAssembler<CMD_LINE_MAX>::OVERLONG:
+                replyOverlong(serialStream::replyOut(port));
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+// 응답 바이트 수만 세는 출력 (bench lines)
+class CountPrint : public Print
+{
+public:
+    size_t bytes = 0;
+
+    size_t write(uint8_t) override
+    {
+        bytes++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        bytes += size;
+        return size;
+    }
+};
+
+/**
+ * @brief 몰아 보낸 명령 처리량
+ *        호스트가 명령을 쉬지 않고 이어 보낸 것처럼 여러 줄 끝(LF, CRLF, CR)이 섞인 바이트열을 만들어
+ *        pollCmd 와 같이 64 바이트씩 줄 조립기에 넣고 처리한다. 응답은 바이트 수만 센다.
+ *        wire_lines_per_sec 는 지금 baud 로 이 줄들이 들어오는 속도 (이보다 처리가 빨라야 밀리지 않는다)
+ */
+static const char *const s_pipeLines[] = {
+    "config get ch_num\n",
+    "about\r\n",
+    "config get detect_delay\r",
+    "stats\n",
+};
+
+static void benchLines(int iterations, JsonDocument &_res_doc)
+{
+    if (iterations <= 0)
+    {
+        iterations = 200;
+    }
+    const int lineCount = sizeof(s_pipeLines) / sizeof(s_pipeLines[0]);
+
+    size_t inBytes = 0;
+    for (int n = 0; n < iterations; n++)
+    {
+        inBytes += strlen(s_pipeLines[n % lineCount]);
+    }
+    char *stream = (char *)malloc(inBytes);
+    LineAssembler<CMD_LINE_MAX> *assembler = new LineAssembler<CMD_LINE_MAX>();
+    if (stream == NULL || assembler == NULL)
+    {
+        free(stream);
+        delete assembler;
+        _res_doc["result"] = "fail";
+        _res_doc["ms"] = "bench alloc failed";
+        return;
+    }
+    size_t pos = 0;
+    for (int n = 0; n < iterations; n++)
+    {
+        size_t len = strlen(s_pipeLines[n % lineCount]);
+        memcpy(stream + pos, s_pipeLines[n % lineCount], len);
+        pos += len;
+    }
+
+    CountPrint out;
+    int64_t t0 = esp_timer_get_time();
+    for (size_t off = 0; off < inBytes; off += 64)
+    {
+        size_t n = inBytes - off < 64 ? inBytes - off : 64;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (assembler->push(stream[off + i]) == LineAssembler<CMD_LINE_MAX>::LINE)
+            {
+                parseCmd(assembler->line(), out);
+            }
+        }
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    uint32_t lines = assembler->lines();
+    free(stream);
+    delete assembler;
+
+    // 8N1 : 바이트당 10 비트
+    float wireLinesPerSec = (float)Serial.baudRate() / 10.0f * lines / inBytes;
+
+    _res_doc["result"] = "ok";
+    _res_doc["lines"] = lines;
+    _res_doc["in_bytes"] = inBytes;
+    _res_doc["out_bytes"] = out.bytes;
+    _res_doc["us_per_line"] = lines > 0 ? (float)us / lines : 0;
+    _res_doc["lines_per_sec"] = us > 0 ? lines * 1000000.0f / us : 0;
+    _res_doc["wire_lines_per_sec"] = wireLinesPerSec;
+}
+
@@ -0,0 +1,248 @@
+#include "serialStream.hpp"
+
+#include <esp_rom_crc.h>
+
+#include "packet.hpp"
+#include "dataCapture.hpp"
+
+namespace serialStream {
+
+volatile bool g_binary = false;
+
+// payload 최대 : 이벤트 (헤더 + 채널별 tick) 와 텍스트 조각 중 큰 것
+constexpr size_t EVENT_MAX = sizeof(S_Stream_Event) + sizeof(uint32_t) * MAX_CHANNELS;
+constexpr size_t TEXT_MAX = 1 + STREAM_TEXT_CHUNK;
+constexpr size_t PAYLOAD_MAX = EVENT_MAX > TEXT_MAX ? EVENT_MAX : TEXT_MAX;
+// + CRC32
+constexpr size_t RAW_MAX = PAYLOAD_MAX + sizeof(uint32_t);
+// COBS : 앞 코드 1 + 254 바이트마다 1, 구분자 1
+constexpr size_t FRAME_MAX = RAW_MAX + RAW_MAX / 254 + 2;
+
+static_assert(sizeof(S_Stream_Pos) <= PAYLOAD_MAX, "S_Stream_Pos exceeds stream payload");
+
+static uint32_t s_baud = STREAM_TEXT_BAUD;
+
+// stream 명령이 정한 다음 모드 (응답을 보낸 뒤 applyPending 에서)
+static bool s_pending = false;
+static bool s_pendingBinary = false;
+static uint32_t s_pendingBaud = 0;
+
+// dataLoop 와 앱 태스크가 같이 센다.
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static Stats s_stats = {};
+
+static void count(bool ok, size_t bytes)
+{
+    portENTER_CRITICAL(&s_mux);
+    if (ok)
+    {
+        s_stats.records++;
+        s_stats.bytes += bytes;
+    }
+    else
+    {
+        s_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// COBS 인코딩 : out 에 쓴 바이트 수 (0x00 이 없는 바이트열, 구분자는 붙이지 않음)
+static size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out)
+{
+    size_t codeAt = 0;
+    size_t w = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (in[i] == 0)
+        {
+            out[codeAt] = code;
+            codeAt = w++;
+            code = 1;
+            continue;
+        }
+        out[w++] = in[i];
+        if (++code == 0xFF)
+        {
+            out[codeAt] = code;
+            codeAt = w++;
+            code = 1;
+        }
+    }
+    out[codeAt] = code;
+    return w;
+}
+
+/**
+ * @brief 레코드 하나 보내기 : CRC32 를 붙여 COBS 로 감싸고 Serial.write 한 번으로 쓴다.
+ *
+ * @param raw    payload, 뒤에 CRC 자리(4 bytes)가 있어야 한다.
+ * @param length payload 길이
+ * @param wait   false 면 TX 버퍼에 자리가 없을 때 버린다. (dataLoop) true 면 자리가 날 때까지 (명령 응답)
+ */
+static bool writeRecord(uint8_t *raw, size_t length, bool wait)
+{
+    uint32_t crc = esp_rom_crc32_le(0, raw, length);
+    memcpy(raw + length, &crc, sizeof(crc));
+
+    uint8_t frame[FRAME_MAX];
+    size_t n = cobsEncode(raw, length + sizeof(crc), frame);
+    frame[n++] = 0;
+
+    bool ok = (wait || Serial.availableForWrite() >= (int)n) && Serial.write(frame, n) == n;
+
+    count(ok, n);
+    return ok;
+}
+
+// 텍스트 모드 이벤트 줄 : 바이너리와 같이 TX 버퍼에 자리가 없으면 버린다. (dataLoop 가 UART 를 기다리지 않게)
+static bool writeText(const char *text, size_t length)
+{
+    bool ok = Serial.availableForWrite() >= (int)length && Serial.write((const uint8_t *)text, length) == length;
+    count(ok, length);
+    return ok;
+}
+
+// 명령 응답 : 줄 끝이나 STREAM_TEXT_CHUNK 마다 STREAM_REC_TEXT 레코드 하나 (앱 태스크 전용)
+class ReplyPrint : public Print
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        m_buf[1 + m_len++] = c;
+        if (c == '\n' || m_len >= STREAM_TEXT_CHUNK)
+        {
+            emit();
+        }
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            write(buffer[i]);
+        }
+        return size;
+    }
+
+private:
+    uint8_t m_buf[RAW_MAX];
+    size_t m_len = 0;
+
+    void emit()
+    {
+        m_buf[0] = STREAM_REC_TEXT;
+        writeRecord(m_buf, 1 + m_len, true);
+        m_len = 0;
+    }
+};
+
+static ReplyPrint s_reply;
+
+void setup()
+{
+    Serial.setTxBufferSize(STREAM_TX_BUFFER);
+}
+
+void request(bool binary, uint32_t baud)
+{
+    s_pendingBinary = binary;
+    s_pendingBaud = binary ? baud : STREAM_TEXT_BAUD;
+    s_pending = true;
+}
+
+void applyPending()
+{
+    if (!s_pending)
+    {
+        return;
+    }
+    s_pending = false;
+
+    // 응답이 지금 baud 로 다 나간 뒤 바꾼다.
+    Serial.flush();
+    if (s_pendingBaud != s_baud)
+    {
+        Serial.updateBaudRate(s_pendingBaud);
+        s_baud = s_pendingBaud;
+    }
+    g_binary = s_pendingBinary;
+}
+
+uint32_t baud()
+{
+    return s_baud;
+}
+
+bool sendEvent(uint32_t seq, const uint32_t *ticks, int numChannels, uint32_t mask, uint64_t timeNs)
+{
+    if (numChannels > MAX_CHANNELS)
+    {
+        return false;
+    }
+
+    if (!g_binary)
+    {
+        // 채널별 tick (빠진 채널은 -1) 을 한 줄로
+        char line[MAX_CHANNELS * 12 + 4];
+        size_t len = 0;
+        for (int i = 0; i < numChannels; i++)
+        {
+            len += snprintf(line + len, sizeof(line) - len, "%d ", (int)ticks[i]);
+        }
+        line[len++] = '\r';
+        line[len++] = '\n';
+        return writeText(line, len);
+    }
+
+    S_Stream_Event header = {};
+    header.type = STREAM_REC_EVENT;
+    header.channels = numChannels;
+    header.seq = seq;
+    header.timeNs = timeNs;
+    header.mask = mask;
+
+    uint8_t raw[RAW_MAX];
+    memcpy(raw, &header, sizeof(header));
+    memcpy(raw + sizeof(header), ticks, sizeof(uint32_t) * numChannels);
+    return writeRecord(raw, sizeof(header) + sizeof(uint32_t) * numChannels, false);
+}
+
+bool sendPos(uint32_t seq, const tdoaSolver::Fix &fix, uint32_t mask)
+{
+    if (!g_binary)
+    {
+        char line[80];
+        int len = snprintf(line, sizeof(line), "pos %.3f %.3f %.3f res %.4f\n", fix.pos[0], fix.pos[1], fix.pos[2], fix.residual);
+        return writeText(line, len < (int)sizeof(line) ? len : sizeof(line) - 1);
+    }
+
+    S_Stream_Pos pos = {};
+    pos.type = STREAM_REC_POS;
+    pos.dim = fix.dim;
+    pos.used = fix.used;
+    pos.iterations = fix.iterations;
+    pos.seq = seq;
+    memcpy(pos.pos, fix.pos, sizeof(pos.pos));
+    pos.residual = fix.residual;
+    pos.mask = mask;
+
+    uint8_t raw[RAW_MAX];
+    memcpy(raw, &pos, sizeof(pos));
+    return writeRecord(raw, sizeof(pos), false);
+}
+
+Print &replyOut(Print &port)
+{
+    return g_binary ? (Print &)s_reply : port;
+}
+
+void getStats(Stats &stats)
+{
+    portENTER_CRITICAL(&s_mux);
+    stats = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+} // namespace serialStream
@@ -0,0 +1,71 @@
+#ifndef SERIALSTREAM_HPP
+#define SERIALSTREAM_HPP
+
+#include <Arduino.h>
+
+#include "tdoaSolver.hpp"
+
+// 시리얼 바이너리 이벤트 스트림 (stream binary 명령, 유선 USB)
+// 이벤트를 printf 텍스트 대신 CRC32 + COBS 로 감싼 바이너리 레코드로 보낸다. (packet.hpp STREAM_REC_*)
+// 레코드 하나는 Serial.write 한 번이라 두 태스크(dataLoop, 명령 응답)가 써도 섞이지 않는다.
+// TX 는 UART 드라이버 링 버퍼(STREAM_TX_BUFFER) 에 복사만 하고 기다리지 않는다. 자리가 없으면 버리고 dropped 로 센다.
+// 텍스트 모드의 이벤트 / 위치 줄도 같은 규칙으로 한 번에 쓰고 자리가 없으면 버린다.
+// 바이너리 모드 동안 디버그 로그(dlog)는 내보내지 않고, 명령 응답은 STREAM_REC_TEXT 레코드로 보낸다.
+
+// 텍스트 모드 baud (부팅 때, stream text 로 돌아올 때)
+#define STREAM_TEXT_BAUD 115200
+#define STREAM_MIN_BAUD 9600
+#define STREAM_MAX_BAUD 2000000
+// stream_baud 기본값
+#ifndef STREAM_DEFAULT_BAUD
+#define STREAM_DEFAULT_BAUD 921600
+#endif
+
+// UART TX 링 버퍼 (Serial.begin 전에 잡는다)
+#ifndef STREAM_TX_BUFFER
+#define STREAM_TX_BUFFER 4096
+#endif
+
+// 텍스트 레코드 하나의 최대 텍스트 (넘으면 여러 레코드로 나눈다)
+#define STREAM_TEXT_CHUNK 128
+
+namespace serialStream {
+
+struct Stats
+{
+    uint32_t records; // 보낸 레코드 (텍스트 모드는 이벤트 / 위치 줄)
+    uint32_t bytes;   // 보낸 바이트 (COBS, 구분자 포함)
+    uint32_t dropped; // TX 버퍼가 모자라 버린 레코드 / 줄
+};
+
+// Serial.begin 전에 : TX 링 버퍼 크기
+void setup();
+
+// 바이너리 모드 (binary() 로 읽는다)
+extern volatile bool g_binary;
+
+inline bool binary()
+{
+    return g_binary;
+}
+
+// 모드 바꾸기 요청 : 지금 명령의 응답이 나간 뒤 (applyPending) 바뀐다. 바이너리면 baud 도 바꾼다.
+void request(bool binary, uint32_t baud);
+void applyPending();
+
+// 지금 baud
+uint32_t baud();
+
+// 이벤트 / 위치 보내기 : 바이너리 모드면 레코드, 텍스트 모드면 한 줄 ("t0 t1 ... \r\n", "pos x y z res r\n")
+// 기다리지 않는다. TX 버퍼에 자리가 없으면 false (dropped)
+bool sendEvent(uint32_t seq, const uint32_t *ticks, int numChannels, uint32_t mask, uint64_t timeNs);
+bool sendPos(uint32_t seq, const tdoaSolver::Fix &fix, uint32_t mask);
+
+// 명령 응답 출력 : 텍스트 모드면 port 그대로, 바이너리 모드면 STREAM_REC_TEXT 레코드 (줄 끝이나 STREAM_TEXT_CHUNK 마다)
+Print &replyOut(Print &port);
+
+void getStats(Stats &stats);
+
+} // namespace serialStream
+
+#endif // SERIALSTREAM_HPP
@@ -0,0 +1,444 @@
+#include "tdoaRefine.hpp"
+
+#include <atomic>
+
+#include <esp_timer.h>
+
+#include "gccPhat.hpp"
+#include "adcCapture.hpp"
+#include "dataCapture.hpp"
+#include "dlog.hpp"
+
+namespace tdoaRefine {
+
+#define MAX_PAIRS (MAX_CHANNELS * (MAX_CHANNELS - 1) / 2)
+
+// bench 합성 신호
+#define BENCH_CHANNELS 4
+static const float BENCH_DELAYS[BENCH_CHANNELS] = {0.0f, 7.0f, -19.0f, 31.0f}; // 샘플
+
+using gccPhat::Complex;
+
+struct Span
+{
+    const int16_t *p1;
+    uint32_t n1;
+    const int16_t *p2;
+    uint32_t n2;
+};
+
+enum Phase
+{
+    PHASE_SPECTRA, // 채널 두 개씩 순방향 FFT
+    PHASE_PAIRS    // 쌍 두 개씩 교차 스펙트럼 역방향 FFT
+};
+
+static int s_n = 0;
+static int s_channels = 0;
+static int s_maxLag = 0;
+static Complex *s_spectra[MAX_CHANNELS] = {NULL}; // n/2+1
+static Complex *s_work[2] = {NULL};                // [0] 작업 태스크, [1] 호출 태스크
+
+// 현재 작업 (s_lock 으로 보호, 작업 태스크는 알림 후에만 읽는다)
+static Span s_span[MAX_CHANNELS];
+static int s_chList[MAX_CHANNELS];
+static int s_chCount = 0;
+static int s_pairA[MAX_PAIRS];
+static int s_pairB[MAX_PAIRS];
+static int s_pairCount = 0;
+static gccPhat::Lag s_lag[MAX_PAIRS];
+
+static Phase s_phase = PHASE_SPECTRA;
+static int s_jobCount = 0;
+static std::atomic<int> s_nextJob(0);
+
+static TaskHandle_t s_worker = NULL;
+static SemaphoreHandle_t s_done = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+
+static Stats s_stats = {};
+
+// adc 캡처를 쓰지 않을 때(bench) 가정하는 샘플 간격
+static const uint32_t DEFAULT_PERIOD_NS = 20000;
+
+static uint32_t periodNs()
+{
+    return adcCapture::numChannels() > 0 ? adcCapture::samplePeriodNs() : DEFAULT_PERIOD_NS;
+}
+
+// 남은 작업을 하나씩 가져가 처리한다. 두 코어가 같은 카운터를 나눠 쓴다.
+static void runJobs(Complex *work)
+{
+    int job;
+    while ((job = s_nextJob.fetch_add(1)) < s_jobCount)
+    {
+        int first = job * 2;
+        int second = first + 1;
+
+        if (s_phase == PHASE_SPECTRA)
+        {
+            const Span &a = s_span[s_chList[first]];
+            gccPhat::load(work, 0, a.p1, a.n1, a.p2, a.n2);
+            if (second < s_chCount)
+            {
+                const Span &b = s_span[s_chList[second]];
+                gccPhat::load(work, 1, b.p1, b.n1, b.p2, b.n2);
+            }
+            else
+            {
+                gccPhat::clear(work, 1);
+            }
+            gccPhat::fft(work, false);
+            gccPhat::split(work, s_spectra[s_chList[first]],
+                           second < s_chCount ? s_spectra[s_chList[second]] : NULL);
+        }
+        else
+        {
+            bool two = second < s_pairCount;
+            gccPhat::cross(work,
+                           s_spectra[s_pairA[first]], s_spectra[s_pairB[first]],
+                           two ? s_spectra[s_pairA[second]] : NULL,
+                           two ? s_spectra[s_pairB[second]] : NULL);
+            gccPhat::fft(work, true);
+            s_lag[first] = gccPhat::peak(work, 0, s_maxLag);
+            if (two)
+            {
+                s_lag[second] = gccPhat::peak(work, 1, s_maxLag);
+            }
+        }
+    }
+}
+
+static void workerTask(void *param)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        runJobs(s_work[0]);
+        xSemaphoreGive(s_done);
+    }
+}
+
+static void runPhase(Phase phase, int jobs, bool dual)
+{
+    s_phase = phase;
+    s_jobCount = jobs;
+    s_nextJob.store(0);
+
+    if (dual)
+    {
+        xTaskNotifyGive(s_worker);
+    }
+    runJobs(s_work[1]);
+    if (dual)
+    {
+        xSemaphoreTake(s_done, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief s_span 의 mask 채널로 GCC-PHAT 을 돌려 채널별 상대 시각(샘플, 평균 0)을 구한다.
+ *        t_k = 1/N * sum_j (t_k - t_j) : 모든 쌍 지연의 최소자승 해
+ */
+static bool compute(uint32_t mask, float *offsets, bool dual)
+{
+    s_chCount = 0;
+    for (int ch = 0; ch < s_channels; ch++)
+    {
+        if (mask & (1UL << ch))
+        {
+            s_chList[s_chCount++] = ch;
+        }
+    }
+    if (s_chCount < 2)
+    {
+        return false;
+    }
+
+    s_pairCount = 0;
+    for (int i = 0; i < s_chCount; i++)
+    {
+        for (int j = i + 1; j < s_chCount; j++)
+        {
+            s_pairA[s_pairCount] = s_chList[i];
+            s_pairB[s_pairCount] = s_chList[j];
+            s_pairCount++;
+        }
+    }
+
+    runPhase(PHASE_SPECTRA, (s_chCount + 1) / 2, dual);
+    runPhase(PHASE_PAIRS, (s_pairCount + 1) / 2, dual);
+
+    float sum[MAX_CHANNELS] = {0};
+    float minPeak = 1.0f;
+    for (int p = 0; p < s_pairCount; p++)
+    {
+        // s_lag = t_a - t_b
+        sum[s_pairA[p]] += s_lag[p].samples;
+        sum[s_pairB[p]] -= s_lag[p].samples;
+        if (s_lag[p].peak < minPeak)
+        {
+            minPeak = s_lag[p].peak;
+        }
+    }
+    for (int i = 0; i < s_chCount; i++)
+    {
+        int ch = s_chList[i];
+        offsets[ch] = sum[ch] / s_chCount;
+    }
+    s_stats.minPeak = minPeak;
+    return true;
+}
+
+// 구간 앞쪽 skip 개를 건너뛴다.
+static void advance(Span &span, uint32_t skip)
+{
+    if (skip < span.n1)
+    {
+        span.p1 += skip;
+        span.n1 -= skip;
+        return;
+    }
+    skip -= span.n1;
+    span.p1 = span.p2 + skip;
+    span.n1 = span.n2 - skip;
+    span.p2 = NULL;
+    span.n2 = 0;
+}
+
+bool setup(int channels, uint32_t windowLength, uint32_t maxLagNs)
+{
+    s_n = 0;
+
+    int n = 4;
+    while (n * 2 <= (int)windowLength && n * 2 <= GCC_PHAT_MAX_N)
+    {
+        n *= 2;
+    }
+    if (!gccPhat::init(n))
+    {
+        DLOG_E(CAPTURE, "gcc-phat init failed");
+        return false;
+    }
+
+    if (channels > MAX_CHANNELS)
+    {
+        channels = MAX_CHANNELS;
+    }
+    for (int ch = 0; ch < MAX_CHANNELS; ch++)
+    {
+        free(s_spectra[ch]);
+        s_spectra[ch] = NULL;
+    }
+    for (int ch = 0; ch < channels; ch++)
+    {
+        s_spectra[ch] = (Complex *)malloc(sizeof(Complex) * (n / 2 + 1));
+        if (s_spectra[ch] == NULL)
+        {
+            DLOG_E(CAPTURE, "gcc-phat spectrum alloc failed");
+            return false;
+        }
+    }
+    for (int core = 0; core < 2; core++)
+    {
+        free(s_work[core]);
+        s_work[core] = (Complex *)malloc(sizeof(Complex) * n);
+        if (s_work[core] == NULL)
+        {
+            DLOG_E(CAPTURE, "gcc-phat work alloc failed");
+            return false;
+        }
+    }
+
+    s_n = n;
+    s_channels = channels;
+    uint32_t period = periodNs();
+    s_maxLag = period > 0 ? (int)(maxLagNs / period) + 1 : n / 2 - 1;
+
+    if (s_lock == NULL)
+    {
+        s_lock = xSemaphoreCreateMutex();
+        s_done = xSemaphoreCreateBinary();
+        // 호출 태스크(dataLoop, 코어 1)와 나란히 돌도록 코어 0 에 둔다.
+        xTaskCreatePinnedToCore(workerTask, "gccPhat", 4096, NULL, 2, &s_worker, 0);
+    }
+    return true;
+}
+
+bool ready()
+{
+    return s_n > 0;
+}
+
+bool refine(uint64_t eventNs, uint32_t mask, uint32_t *ticks)
+{
+    if (s_n == 0)
+    {
+        return false;
+    }
+
+    adcCapture::Window window;
+    if (!adcCapture::acquire(window, eventNs))
+    {
+        s_stats.noWindow++;
+        return false;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    // 창이 FFT 크기보다 길면 트리거 앞 n/4 부터 자른다.
+    uint32_t skip = 0;
+    uint32_t pre = (uint32_t)(window.trigger - window.start);
+    if (pre > (uint32_t)s_n / 4)
+    {
+        skip = pre - s_n / 4;
+    }
+    if (skip + s_n > window.length)
+    {
+        skip = window.length > (uint32_t)s_n ? window.length - s_n : 0;
+    }
+
+    for (int ch = 0; ch < s_channels; ch++)
+    {
+        Span &span = s_span[ch];
+        adcCapture::span(window, ch, span.p1, span.n1, span.p2, span.n2);
+        advance(span, skip);
+    }
+
+    float offsets[MAX_CHANNELS];
+    bool ok = compute(mask, offsets, true);
+
+    xSemaphoreGive(s_lock);
+
+    if (!adcCapture::valid(window))
+    {
+        ok = false;
+        s_stats.overrun++;
+    }
+    adcCapture::release(window);
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    s_stats.lastUs = us;
+    if (us > s_stats.maxUs)
+    {
+        s_stats.maxUs = us;
+    }
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    // 샘플 -> ns, 채널 스캔 순서에 따른 샘플 시각 차이를 더하고 가장 빠른 채널 기준으로 맞춘다.
+    float period = (float)periodNs();
+    float ns[MAX_CHANNELS];
+    float minNs = 0;
+    bool first = true;
+    for (int ch = 0; ch < s_channels; ch++)
+    {
+        if (!(mask & (1UL << ch)))
+        {
+            continue;
+        }
+        ns[ch] = offsets[ch] * period + adcCapture::channelSkewNs(ch);
+        if (first || ns[ch] < minNs)
+        {
+            minNs = ns[ch];
+            first = false;
+        }
+    }
+    for (int ch = 0; ch < s_channels; ch++)
+    {
+        if (mask & (1UL << ch))
+        {
+            ticks[ch] = (uint32_t)(ns[ch] - minNs + 0.5f);
+        }
+    }
+
+    s_stats.refined++;
+    return true;
+}
+
+bool bench(int iterations, BenchResult &result)
+{
+    if (s_n == 0 && !setup(BENCH_CHANNELS, GCC_PHAT_MAX_N, 2000000))
+    {
+        return false;
+    }
+    int channels = s_channels < BENCH_CHANNELS ? s_channels : BENCH_CHANNELS;
+    int n = s_n;
+
+    int16_t *buf = (int16_t *)malloc(sizeof(int16_t) * n * channels);
+    if (buf == NULL)
+    {
+        return false;
+    }
+
+    // 같은 잡음 버스트를 채널마다 정수 샘플만큼 밀어 넣는다.
+    uint32_t seed = 12345;
+    const int pad = 64;
+    int16_t *src = (int16_t *)malloc(sizeof(int16_t) * (n + pad * 2));
+    if (src == NULL)
+    {
+        free(buf);
+        return false;
+    }
+    for (int i = 0; i < n + pad * 2; i++)
+    {
+        seed = seed * 1664525UL + 1013904223UL;
+        src[i] = (int16_t)((seed >> 20) & 0x3FF) - 512;
+    }
+    for (int ch = 0; ch < channels; ch++)
+    {
+        int delay = (int)BENCH_DELAYS[ch];
+        for (int i = 0; i < n; i++)
+        {
+            buf[ch * n + i] = 2048 + src[i + pad - delay];
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int ch = 0; ch < channels; ch++)
+    {
+        s_span[ch].p1 = buf + ch * n;
+        s_span[ch].n1 = n;
+        s_span[ch].p2 = NULL;
+        s_span[ch].n2 = 0;
+    }
+    uint32_t mask = (1UL << channels) - 1;
+    float offsets[MAX_CHANNELS];
+
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        compute(mask, offsets, true);
+    }
+    int64_t t1 = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        compute(mask, offsets, false);
+    }
+    int64_t t2 = esp_timer_get_time();
+    xSemaphoreGive(s_lock);
+
+    free(src);
+    free(buf);
+
+    uint32_t period = periodNs();
+    result.events = iterations;
+    result.dualUs = (uint32_t)((t1 - t0) / iterations);
+    result.singleUs = (uint32_t)((t2 - t1) / iterations);
+    for (int ch = 0; ch < BENCH_CHANNELS; ch++)
+    {
+        result.lagNs[ch] = ch < channels ? (offsets[ch] - offsets[0]) * period : 0.0f;
+    }
+    return true;
+}
+
+void getStats(Stats &stats)
+{
+    stats = s_stats;
+}
+
+} // namespace tdoaRefine
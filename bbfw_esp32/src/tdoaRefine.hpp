@@ -0,0 +1,55 @@
+#ifndef TDOAREFINE_HPP
+#define TDOAREFINE_HPP
+
+#include <Arduino.h>
+
+// adc 캡처 모드의 시차 정밀화
+// 첫 에지 도착 시각 대신, 이벤트를 포함하는 고정 파형 창에서 GCC-PHAT 로 채널 쌍별 지연을 구해
+// g_ResultTicks 를 다시 채운다.
+// - 채널 스펙트럼과 쌍별 상호상관을 코어 0 작업 태스크와 호출한 태스크(코어 1)가 나눠 처리한다.
+// - 모든 쌍의 지연을 최소자승으로 합쳐 채널별 시각을 구한다.
+
+namespace tdoaRefine {
+
+struct Stats
+{
+    uint32_t refined;   // 정밀화한 이벤트
+    uint32_t noWindow;  // 이벤트를 포함하는 창이 없어 첫 에지 값을 그대로 둔 이벤트
+    uint32_t overrun;   // 처리 중 창이 덮어쓰여 버린 결과
+    uint32_t lastUs;    // 마지막 처리 시간
+    uint32_t maxUs;
+    float minPeak;      // 마지막 이벤트의 가장 낮은 쌍별 상관 피크
+};
+
+struct BenchResult
+{
+    uint32_t events;
+    uint32_t dualUs;     // 이벤트당 처리 시간 (두 코어)
+    uint32_t singleUs;   // 이벤트당 처리 시간 (한 코어)
+    float lagNs[4];      // 채널 0 기준 측정 지연 (합성 지연 확인용)
+};
+
+/**
+ * @brief FFT 크기와 최대 지연을 정하고 버퍼와 코어 0 작업 태스크를 만든다.
+ *
+ * @param channels     채널 수
+ * @param windowLength adc 창 길이 (샘플), 이 이하의 2의 거듭제곱을 FFT 크기로 쓴다.
+ * @param maxLagNs     최대 시차 (상관 창)
+ */
+bool setup(int channels, uint32_t windowLength, uint32_t maxLagNs);
+bool ready();
+
+/**
+ * @brief eventNs 를 포함하는 adc 창으로 mask 채널의 시차를 다시 계산해 ticks 에 쓴다.
+ *        창이 없거나 덮어쓰였으면 false 를 돌려주고 ticks 는 그대로 둔다.
+ */
+bool refine(uint64_t eventNs, uint32_t mask, uint32_t *ticks);
+
+// 4채널 합성 신호로 처리 속도를 잰다. (serial bench 명령)
+bool bench(int iterations, BenchResult &result);
+
+void getStats(Stats &stats);
+
+} // namespace tdoaRefine
+
+#endif // TDOAREFINE_HPP
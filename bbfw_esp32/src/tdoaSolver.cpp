@@ -0,0 +1,429 @@
+#include "tdoaSolver.hpp"
+
+#include <math.h>
+
+namespace tdoaSolver {
+
+static Setup s_setup = {};
+static bool s_ready = false;
+
+// 이보다 짧은 거리는 0 으로 본다. (m)
+static const float MIN_NORM = 1e-6f;
+// Gauss-Newton 종료 조건 : 갱신 크기 (m)
+static const float STEP_TOLERANCE = 1e-5f;
+// 두 초기값 후보의 비용이 이만큼 이내면 같다고 본다. (m^2)
+static const float TIE_COST = 1e-6f;
+
+bool prepare(Setup &setup)
+{
+    if (setup.numSensors > SOLVER_MAX_SENSORS)
+    {
+        setup.numSensors = SOLVER_MAX_SENSORS;
+    }
+    if (setup.dim != 3)
+    {
+        setup.dim = 2;
+        for (int i = 0; i < setup.numSensors; i++)
+        {
+            setup.pos[i][2] = 0.0f;
+        }
+    }
+    return setup.numSensors >= setup.dim + 1 && setup.soundSpeed > 0.0f;
+}
+
+void configure(const Setup &setup)
+{
+    s_setup = setup;
+    s_ready = prepare(s_setup);
+}
+
+bool ready()
+{
+    return s_ready;
+}
+
+const Setup &current()
+{
+    return s_setup;
+}
+
+// n x n (n <= 3) 선형 방정식 a x = b (부분 피벗 가우스 소거), a, b 는 덮어쓴다.
+static bool linearSolve(float a[3][3], float b[3], int n, float x[3])
+{
+    for (int col = 0; col < n; col++)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++)
+        {
+            if (fabsf(a[row][col]) > fabsf(a[pivot][col]))
+            {
+                pivot = row;
+            }
+        }
+        if (fabsf(a[pivot][col]) < 1e-12f)
+        {
+            return false;
+        }
+        if (pivot != col)
+        {
+            for (int k = 0; k < n; k++)
+            {
+                float t = a[col][k];
+                a[col][k] = a[pivot][k];
+                a[pivot][k] = t;
+            }
+            float t = b[col];
+            b[col] = b[pivot];
+            b[pivot] = t;
+        }
+        for (int row = col + 1; row < n; row++)
+        {
+            float f = a[row][col] / a[col][col];
+            for (int k = col; k < n; k++)
+            {
+                a[row][k] -= f * a[col][k];
+            }
+            b[row] -= f * b[col];
+        }
+    }
+    for (int row = n - 1; row >= 0; row--)
+    {
+        float s = b[row];
+        for (int k = row + 1; k < n; k++)
+        {
+            s -= a[row][k] * x[k];
+        }
+        x[row] = s / a[row][row];
+    }
+    return true;
+}
+
+static inline float norm(const float *v, int dim)
+{
+    float s = 0.0f;
+    for (int k = 0; k < dim; k++)
+    {
+        s += v[k] * v[k];
+    }
+    return sqrtf(s);
+}
+
+// 기준 센서를 원점으로 옮긴 좌표계의 문제 (q : 센서, d : 기준 대비 거리차)
+struct Problem
+{
+    int dim;
+    int m;                              // 기준 제외 센서 수
+    float q[SOLVER_MAX_SENSORS][3];
+    float d[SOLVER_MAX_SENSORS];
+};
+
+// 잔차 r_i = |x - q_i| - |x| - d_i 의 제곱합
+static float cost(const Problem &pb, const float *x)
+{
+    float r0 = norm(x, pb.dim);
+    float sum = 0.0f;
+    for (int i = 0; i < pb.m; i++)
+    {
+        float diff[3];
+        for (int k = 0; k < pb.dim; k++)
+        {
+            diff[k] = x[k] - pb.q[i][k];
+        }
+        float r = norm(diff, pb.dim) - r0 - pb.d[i];
+        sum += r * r;
+    }
+    return sum;
+}
+
+/**
+ * @brief 닫힌 형태 초기값
+ *        q_i . x = (|q_i|^2 - d_i^2) / 2 - d_i R  을 최소자승으로 풀어 x = u + v R,
+ *        |x| = R 을 대입한 이차식의 근 중 잔차가 작은 것을 고른다.
+ */
+static bool initialGuess(const Problem &pb, float *x)
+{
+    const int dim = pb.dim;
+    float qtq[3][3] = {{0}};
+    float qta[3] = {0};
+    float qtd[3] = {0};
+    for (int i = 0; i < pb.m; i++)
+    {
+        float qq = 0.0f;
+        for (int k = 0; k < dim; k++)
+        {
+            qq += pb.q[i][k] * pb.q[i][k];
+        }
+        float a = 0.5f * (qq - pb.d[i] * pb.d[i]);
+        for (int r = 0; r < dim; r++)
+        {
+            for (int c = 0; c < dim; c++)
+            {
+                qtq[r][c] += pb.q[i][r] * pb.q[i][c];
+            }
+            qta[r] += pb.q[i][r] * a;
+            qtd[r] -= pb.q[i][r] * pb.d[i];
+        }
+    }
+
+    float m1[3][3], m2[3][3];
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            m1[r][c] = qtq[r][c];
+            m2[r][c] = qtq[r][c];
+        }
+    }
+    float u[3] = {0}, v[3] = {0};
+    if (!linearSolve(m1, qta, dim, u) || !linearSolve(m2, qtd, dim, v))
+    {
+        return false; // 센서가 한 직선(평면) 위에 있음
+    }
+
+    // (v.v - 1) R^2 + 2 (u.v) R + u.u = 0
+    float qa = -1.0f, qb = 0.0f, qc = 0.0f;
+    for (int k = 0; k < dim; k++)
+    {
+        qa += v[k] * v[k];
+        qb += 2.0f * u[k] * v[k];
+        qc += u[k] * u[k];
+    }
+
+    float roots[2];
+    int count = 0;
+    if (fabsf(qa) < 1e-9f)
+    {
+        if (fabsf(qb) > 1e-12f)
+        {
+            roots[count++] = -qc / qb;
+        }
+    }
+    else
+    {
+        float disc = qb * qb - 4.0f * qa * qc;
+        if (disc >= 0.0f)
+        {
+            float sq = sqrtf(disc);
+            roots[count++] = (-qb + sq) / (2.0f * qa);
+            roots[count++] = (-qb - sq) / (2.0f * qa);
+        }
+        else
+        {
+            // 잡음으로 근이 없으면 꼭짓점
+            roots[count++] = -qb / (2.0f * qa);
+        }
+    }
+
+    // 센서 수가 차원 + 1 이면 두 근이 모두 잔차 0 일 수 있다. 그때는 센서 중심에 가까운 쪽을 고른다.
+    float center[3] = {0};
+    for (int i = 0; i < pb.m; i++)
+    {
+        for (int k = 0; k < dim; k++)
+        {
+            center[k] += pb.q[i][k] / (pb.m + 1);
+        }
+    }
+
+    float best = -1.0f;
+    float bestDist = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        float r = roots[i] < 0.0f ? 0.0f : roots[i];
+        float cand[3];
+        float off[3];
+        for (int k = 0; k < dim; k++)
+        {
+            cand[k] = u[k] + v[k] * r;
+            off[k] = cand[k] - center[k];
+        }
+        float c = cost(pb, cand);
+        float dist = norm(off, dim);
+        bool tie = best >= 0.0f && fabsf(c - best) <= TIE_COST;
+        if (best < 0.0f || (tie ? dist < bestDist : c < best))
+        {
+            best = c;
+            bestDist = dist;
+            for (int k = 0; k < dim; k++)
+            {
+                x[k] = cand[k];
+            }
+        }
+    }
+    return best >= 0.0f;
+}
+
+// Gauss-Newton, 비용이 늘면 갱신을 반으로 줄인다.
+static int refine(const Problem &pb, float *x, float &c)
+{
+    const int dim = pb.dim;
+    c = cost(pb, x);
+
+    int iter = 0;
+    while (iter < SOLVER_MAX_ITERATIONS)
+    {
+        iter++;
+
+        float r0 = norm(x, dim);
+        float g0[3] = {0};
+        if (r0 > MIN_NORM)
+        {
+            for (int k = 0; k < dim; k++)
+            {
+                g0[k] = x[k] / r0;
+            }
+        }
+
+        float h[3][3] = {{0}};
+        float g[3] = {0};
+        for (int i = 0; i < pb.m; i++)
+        {
+            float diff[3];
+            for (int k = 0; k < dim; k++)
+            {
+                diff[k] = x[k] - pb.q[i][k];
+            }
+            float ri = norm(diff, dim);
+            float j[3];
+            for (int k = 0; k < dim; k++)
+            {
+                j[k] = (ri > MIN_NORM ? diff[k] / ri : 0.0f) - g0[k];
+            }
+            float res = ri - r0 - pb.d[i];
+            for (int r = 0; r < dim; r++)
+            {
+                for (int col = 0; col < dim; col++)
+                {
+                    h[r][col] += j[r] * j[col];
+                }
+                g[r] -= j[r] * res;
+            }
+        }
+
+        // 약한 감쇠로 특이 행렬을 피한다.
+        float trace = 0.0f;
+        for (int k = 0; k < dim; k++)
+        {
+            trace += h[k][k];
+        }
+        for (int k = 0; k < dim; k++)
+        {
+            h[k][k] += 1e-6f * trace + 1e-12f;
+        }
+
+        float step[3] = {0};
+        if (!linearSolve(h, g, dim, step))
+        {
+            break;
+        }
+
+        float next[3];
+        float nc = c;
+        for (int half = 0; half < 4; half++)
+        {
+            for (int k = 0; k < dim; k++)
+            {
+                next[k] = x[k] + step[k];
+            }
+            nc = cost(pb, next);
+            if (nc <= c)
+            {
+                break;
+            }
+            for (int k = 0; k < dim; k++)
+            {
+                step[k] *= 0.5f;
+            }
+        }
+        if (nc > c)
+        {
+            break;
+        }
+
+        for (int k = 0; k < dim; k++)
+        {
+            x[k] = next[k];
+        }
+        c = nc;
+
+        if (norm(step, dim) < STEP_TOLERANCE)
+        {
+            break;
+        }
+    }
+    return iter;
+}
+
+bool solve(const Setup &setup, const uint32_t *ticks, uint32_t mask, Fix &fix)
+{
+    fix.ok = false;
+    fix.dim = setup.dim;
+    fix.used = 0;
+    fix.iterations = 0;
+    fix.residual = 0.0f;
+    fix.pos[0] = fix.pos[1] = fix.pos[2] = 0.0f;
+
+    int used[SOLVER_MAX_SENSORS];
+    int n = 0;
+    int ref = -1;
+    for (int i = 0; i < setup.numSensors; i++)
+    {
+        if (!(mask & (1UL << i)) || ticks[i] == SOLVER_TICK_MISSING)
+        {
+            continue;
+        }
+        used[n++] = i;
+        if (ref < 0 || ticks[i] < ticks[ref])
+        {
+            ref = i;
+        }
+    }
+    fix.used = n;
+    if (n < setup.dim + 1 || setup.soundSpeed <= 0.0f)
+    {
+        return false;
+    }
+
+    Problem pb;
+    pb.dim = setup.dim;
+    pb.m = 0;
+    const float nsToM = setup.soundSpeed * 1e-9f;
+    for (int i = 0; i < n; i++)
+    {
+        int s = used[i];
+        if (s == ref)
+        {
+            continue;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            pb.q[pb.m][k] = setup.pos[s][k] - setup.pos[ref][k];
+        }
+        pb.d[pb.m] = (float)(ticks[s] - ticks[ref]) * nsToM;
+        pb.m++;
+    }
+
+    float x[3] = {0};
+    if (!initialGuess(pb, x))
+    {
+        return false;
+    }
+
+    float c;
+    fix.iterations = refine(pb, x, c);
+
+    for (int k = 0; k < pb.dim; k++)
+    {
+        fix.pos[k] = x[k] + setup.pos[ref][k];
+    }
+    fix.residual = sqrtf(c / pb.m);
+    fix.ok = true;
+    return true;
+}
+
+bool solve(const uint32_t *ticks, uint32_t mask, Fix &fix)
+{
+    // s_setup 은 configure 에서 prepare 를 거쳤다. 준비 안 된 배치는 solve 가 센서 수 / 음속 검사로 거른다.
+    return solve(s_setup, ticks, mask, fix);
+}
+
+} // namespace tdoaSolver
@@ -0,0 +1,71 @@
+#ifndef TDOASOLVER_HPP
+#define TDOASOLVER_HPP
+
+#include <stdint.h>
+
+// TDOA 음원 위치 계산 (기기 내장)
+// PC 의 blueBytePy/solver/ls.py (scipy least_squares) 와 같은 잔차를 최소화한다.
+//  1. 닫힌 형태 초기값 : 기준 센서 거리 R 을 매개변수로 선형화해 p = u + v R 로 풀고
+//     |p - s_ref| = R 이차식의 근 중 잔차가 작은 쪽을 고른다. (Chan/Ho 방식의 거리차 선형화)
+//  2. Gauss-Newton 몇 번으로 비선형 잔차를 다듬는다.
+// 고정 크기 배열만 쓰고 힙을 쓰지 않는다. Arduino 의존성이 없어 호스트 g++ 로도 빌드된다.
+
+namespace tdoaSolver {
+
+// 빌드 채널 수를 따른다. (호스트 빌드는 8)
+#if defined(CAPTURE_CHANNELS)
+#define SOLVER_MAX_SENSORS CAPTURE_CHANNELS
+#else
+#define SOLVER_MAX_SENSORS 8
+#endif
+
+// Gauss-Newton 최대 반복 수
+#ifndef SOLVER_MAX_ITERATIONS
+#define SOLVER_MAX_ITERATIONS 5
+#endif
+
+// 시차가 없는 채널 (dataCapture TICK_MISSING 과 같은 값)
+#define SOLVER_TICK_MISSING 0xFFFFFFFFUL
+
+struct Setup
+{
+    int numSensors;
+    int dim;                              // 2 또는 3
+    float pos[SOLVER_MAX_SENSORS][3];     // 센서 좌표 (m)
+    float soundSpeed;                     // m/s
+};
+
+struct Fix
+{
+    float pos[3];      // 음원 좌표 (m), 2차원이면 pos[2] = 0
+    float residual;    // 거리차 잔차 RMS (m)
+    uint8_t dim;
+    uint8_t used;      // 계산에 쓴 센서 수
+    uint8_t iterations;
+    bool ok;
+};
+
+// 센서 수 / 차원을 정리한다. (2차원이면 z = 0) 풀 수 있는 배치면 true
+bool prepare(Setup &setup);
+
+// dataLoop 가 쓰는 센서 배치 (prepare 를 거친다)
+void configure(const Setup &setup);
+bool ready();
+const Setup &current();
+
+/**
+ * @brief 채널별 시차(ns)로 음원 위치를 구한다.
+ *
+ * @param setup prepare 를 거친 센서 배치 (bench 는 지역 배치로 부른다)
+ * @param ticks 가장 빠른 채널 기준 시차 (ns), 빠진 채널은 SOLVER_TICK_MISSING
+ * @param mask  시차가 있는 채널
+ * @return false : 센서 수가 차원 + 1 보다 적거나 해가 없음
+ */
+bool solve(const Setup &setup, const uint32_t *ticks, uint32_t mask, Fix &fix);
+
+// configure 로 정한 배치로 (dataLoop)
+bool solve(const uint32_t *ticks, uint32_t mask, Fix &fix);
+
+} // namespace tdoaSolver
+
+#endif // TDOASOLVER_HPP
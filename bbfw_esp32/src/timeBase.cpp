@@ -0,0 +1,95 @@
+#include "timeBase.hpp"
+
+#include <esp_ipc.h>
+
+namespace timeBase {
+
+Anchor g_anchors[portNUM_PROCESSORS];
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_refreshTimer = NULL;
+
+// CCOUNT 랩(240MHz 17.9초)보다 충분히 짧게
+static const uint64_t REFRESH_PERIOD_US = 1000000;
+
+/**
+ * @brief 호출한 코어의 앵커를 새로 잡는다.
+ *        주파수가 그대로면 이전 앵커에서 이어서 계산(연속성 유지),
+ *        바뀌었거나 처음이면 esp_timer 로 다시 맞춘다.
+ *        이어서 계산할 때는 지난 사이클 중 정수 us 만큼만 앵커를 옮긴다.
+ *        1us 미만 나머지 사이클은 다음 앵커로 넘어가므로 갱신마다 ns 이하 끝수가 버려져 늦어지지 않는다.
+ */
+void refresh()
+{
+#if defined(__XTENSA__)
+    Anchor &a = g_anchors[xPortGetCoreID()];
+    uint32_t mhz = getCpuFrequencyMhz();
+
+    portENTER_CRITICAL(&s_mux);
+    uint32_t cc = XTHAL_GET_CCOUNT();
+    uint64_t ns;
+    if (a.mhz == mhz && a.mhz != 0)
+    {
+        uint32_t us = (cc - a.ccount) / mhz;
+        cc = a.ccount + us * mhz;
+        ns = a.ns + (uint64_t)us * 1000;
+    }
+    else
+    {
+        ns = (uint64_t)esp_timer_get_time() * 1000;
+    }
+    a.seq = a.seq + 1;
+    a.ccount = cc;
+    a.ns = ns;
+    a.mhz = mhz;
+    a.seq = a.seq + 1;
+    portEXIT_CRITICAL(&s_mux);
+#endif
+}
+
+static void refreshTask(void *arg)
+{
+    refresh();
+}
+
+// esp_timer 태스크(코어 0)에서 호출 : 다른 코어는 IPC 로 갱신
+static void onRefreshTimer(void *arg)
+{
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        if (core == xPortGetCoreID())
+        {
+            refresh();
+        }
+        else
+        {
+            esp_ipc_call(core, refreshTask, NULL);
+        }
+    }
+}
+
+// CPU/APB 주파수 변경 후 다시 앵커
+static void onApbChange(void *arg, apb_change_ev_t ev_type, uint32_t old_apb, uint32_t new_apb)
+{
+    if (ev_type == APB_AFTER_CHANGE)
+    {
+        onRefreshTimer(NULL);
+    }
+}
+
+void setup()
+{
+    onRefreshTimer(NULL);
+
+    esp_timer_create_args_t args = {};
+    args.callback = onRefreshTimer;
+    args.arg = NULL;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "timeBase";
+    esp_timer_create(&args, &s_refreshTimer);
+    esp_timer_start_periodic(s_refreshTimer, REFRESH_PERIOD_US);
+
+    addApbChangeCallback(NULL, onApbChange);
+}
+
+} // namespace timeBase
@@ -0,0 +1,96 @@
+#ifndef TIMEBASE_HPP
+#define TIMEBASE_HPP
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#if defined(__XTENSA__)
+#include <xtensa/core-macros.h>
+#endif
+
+// 64비트 나노초 타임스탬프
+// Xtensa CCOUNT 사이클 카운터(240MHz 에서 4.17ns)를 코어별 앵커에서 64비트로 확장하고
+// 앵커는 esp_timer_get_time() 에 맞춘다.
+// - 32비트 micros() 처럼 71분마다 랩어라운드 하지 않는다.
+// - CCOUNT 는 코어별 레지스터라 앵커도 코어별로 둔다.
+// - 주기적으로(1초) 앵커를 갱신하므로 CCOUNT 랩(240MHz 에서 17.9초) 을 넘지 않는다.
+// - CPU 주파수가 바뀌면 esp_timer 기준으로 다시 앵커를 잡는다.
+
+namespace timeBase {
+
+typedef uint64_t stamp_t; // 부팅 후 나노초
+
+struct Anchor
+{
+    volatile uint32_t seq;     // 홀수면 갱신 중 (seqlock)
+    volatile uint32_t ccount;  // 앵커 시점 CCOUNT
+    volatile uint64_t ns;      // 앵커 시점 시각
+    volatile uint32_t mhz;     // CCOUNT 주파수
+};
+
+extern Anchor g_anchors[portNUM_PROCESSORS];
+
+// 앵커 설정 및 주기 갱신 타이머 시작 (setup() 에서 한 번)
+void setup();
+// 호출한 코어의 앵커를 갱신 (인터럽트 비활성 상태에서 짧게 수행)
+void refresh();
+
+// 사이클 수 -> ns (32비트 나눗셈 두 번, 정확값)
+inline __attribute__((always_inline)) uint64_t cyclesToNs(uint32_t cycles, uint32_t mhz)
+{
+    uint32_t q = cycles / mhz;
+    uint32_t r = cycles % mhz;
+    return (uint64_t)q * 1000 + (r * 1000) / mhz;
+}
+
+/**
+ * @brief 현재 시각 (ns). ISR 에서도 호출 가능
+ */
+inline __attribute__((always_inline)) stamp_t now()
+{
+#if defined(__XTENSA__)
+    const Anchor &a = g_anchors[xPortGetCoreID()];
+    uint32_t seq;
+    stamp_t t;
+    do
+    {
+        seq = a.seq;
+        uint32_t cc = XTHAL_GET_CCOUNT();
+        t = a.ns + cyclesToNs(cc - a.ccount, a.mhz);
+    } while ((seq & 1) || seq != a.seq);
+    return t;
+#else
+    return (stamp_t)esp_timer_get_time() * 1000;
+#endif
+}
+
+/**
+ * @brief 이 코어에서 앞서 읽어 둔 CCOUNT 값 -> ns (poll 루프처럼 시각을 나중에 변환할 때)
+ *        읽은 뒤 이 코어의 앵커가 갱신되지 않았어야 한다.
+ */
+inline __attribute__((always_inline)) stamp_t fromCycles(uint32_t cc)
+{
+#if defined(__XTENSA__)
+    const Anchor &a = g_anchors[xPortGetCoreID()];
+    uint32_t seq;
+    stamp_t t;
+    do
+    {
+        seq = a.seq;
+        t = a.ns + cyclesToNs(cc - a.ccount, a.mhz);
+    } while ((seq & 1) || seq != a.seq);
+    return t;
+#else
+    return now();
+#endif
+}
+
+// ns -> us (32비트, 표시/타임아웃용)
+inline uint32_t toUs(stamp_t t)
+{
+    return (uint32_t)(t / 1000);
+}
+
+} // namespace timeBase
+
+#endif // TIMEBASE_HPP
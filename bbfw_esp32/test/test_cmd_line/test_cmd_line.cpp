@@ -0,0 +1,302 @@
+// 명령 처리 단위 테스트 : pio test -e native -f test_cmd_line -v (-v 로 비교 시간 출력)
+// - CmdTokens 제자리 토큰화, 정렬된 명령 표 이진 탐색
+// - 명령 JSON 문서의 고정 풀 할당기 (poolAllocator.hpp)
+// - 예전 경로(tonkey : 토큰마다 문자열 복사 -> vector 복사 -> == 비교 사슬)와 지금 경로의 줄당 시간 비교
+//   tonkey 는 Arduino String 을 쓰므로 같은 순서의 복사를 std::string 으로 흉내 낸다.
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "cmdLine.hpp"
+#include "poolAllocator.hpp"
+
+typedef int (*Handler)();
+
+static int cmdAbout() { return 1; }
+static int cmdBench() { return 2; }
+static int cmdCalibrate() { return 3; }
+static int cmdConfig() { return 4; }
+static int cmdReboot() { return 5; }
+static int cmdStats() { return 6; }
+static int cmdStream() { return 7; }
+
+// parseCmd.cpp s_commands 와 같은 이름
+static constexpr CmdEntry<Handler> s_commands[] = {
+    {"about", cmdAbout},
+    {"bench", cmdBench},
+    {"calibrate", cmdCalibrate},
+    {"config", cmdConfig},
+    {"reboot", cmdReboot},
+    {"stats", cmdStats},
+    {"stream", cmdStream},
+};
+CMD_TABLE_SORTED(s_commands);
+
+static const char *const s_lines[] = {
+    "stats",
+    "config get detect_delay",
+    "bench solve 1000",
+    "config setA sensorPins [18,19,21,22]",
+};
+static const int LINE_COUNT = sizeof(s_lines) / sizeof(s_lines[0]);
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_tokens_in_place()
+{
+    char line[] = "  config\tset  detect_delay 20 ";
+    CmdTokens tokens;
+    TEST_ASSERT_EQUAL_INT(4, tokens.parse(line));
+    TEST_ASSERT_FALSE(tokens.overflow());
+    TEST_ASSERT_TRUE(tokens.is(0, "config"));
+    TEST_ASSERT_TRUE(tokens.is(2, "detect_delay"));
+    TEST_ASSERT_EQUAL_INT(20, tokens.toInt(3));
+    TEST_ASSERT_EQUAL_STRING("gcc", tokens.get(4, "gcc"));
+    // 토큰은 줄 버퍼 안을 가리킨다.
+    TEST_ASSERT_TRUE(tokens.get(0) >= line && tokens.get(0) < line + sizeof(line));
+}
+
+void test_tokens_overflow()
+{
+    char line[CMD_MAX_TOKENS * 2 + 8];
+    char *p = line;
+    for (int i = 0; i < CMD_MAX_TOKENS + 1; i++)
+    {
+        *p++ = 'a';
+        *p++ = ' ';
+    }
+    *p = 0;
+    CmdTokens tokens;
+    TEST_ASSERT_EQUAL_INT(CMD_MAX_TOKENS, tokens.parse(line));
+    TEST_ASSERT_TRUE(tokens.overflow());
+}
+
+void test_table_find()
+{
+    for (const CmdEntry<Handler> &entry : s_commands)
+    {
+        const CmdEntry<Handler> *found = cmdFind(s_commands, entry.name);
+        TEST_ASSERT_TRUE(found == &entry);
+    }
+    TEST_ASSERT_TRUE(cmdFind(s_commands, "") == NULL);
+    TEST_ASSERT_TRUE(cmdFind(s_commands, "abou") == NULL);
+    TEST_ASSERT_TRUE(cmdFind(s_commands, "streams") == NULL);
+    TEST_ASSERT_TRUE(cmdFind(s_commands, "zzz") == NULL);
+}
+
+// 끝 블록부터 풀면 끝이 되돌아가고, 모두 풀리면 처음부터 다시 쓴다.
+void test_pool_stack_order()
+{
+    static PoolAllocator<256> pool;
+    void *first = pool.allocate(10);
+    TEST_ASSERT_TRUE(first != NULL);
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)first & 7);
+    void *a = pool.allocate(20);
+    void *b = pool.allocate(30);
+    TEST_ASSERT_TRUE(a != NULL && b != NULL);
+
+    // 가운데 블록은 끝이 아니라서 자리를 바로 돌려받지 않는다.
+    pool.deallocate(a);
+    void *c = pool.allocate(8);
+    TEST_ASSERT_TRUE(c > b);
+    pool.deallocate(c);
+    pool.deallocate(b);
+    // b 와 이미 풀린 a 까지 걷어 낸다.
+    void *d = pool.allocate(8);
+    TEST_ASSERT_TRUE(d == a);
+    pool.deallocate(d);
+    pool.deallocate(first);
+    TEST_ASSERT_TRUE(pool.allocate(8) == first);
+}
+
+// 끝 블록은 제자리에서 늘고 줄며, 가운데 블록은 옮겨 가며 내용을 지킨다. 모자라면 NULL
+void test_pool_reallocate()
+{
+    static PoolAllocator<256> pool;
+    char *s = (char *)pool.allocate(8);
+    strcpy(s, "abcdefg");
+    TEST_ASSERT_TRUE(pool.reallocate(s, 64) == s);
+    TEST_ASSERT_TRUE(pool.reallocate(s, 16) == s);
+
+    void *tail = pool.allocate(16);
+    char *moved = (char *)pool.reallocate(s, 40);
+    TEST_ASSERT_TRUE(moved != NULL && moved != s);
+    TEST_ASSERT_EQUAL_STRING("abcdefg", moved);
+
+    uint32_t failed = pool.failed();
+    TEST_ASSERT_TRUE(pool.reallocate(moved, 1000) == NULL);
+    TEST_ASSERT_TRUE(pool.allocate(1000) == NULL);
+    TEST_ASSERT_EQUAL_INT(failed + 2, pool.failed());
+    TEST_ASSERT_TRUE(pool.peak() <= pool.capacity());
+
+    pool.deallocate(moved);
+    pool.deallocate(tail);
+}
+
+// 실제 ArduinoJson 문서 : 응답을 만들고 풀리면 풀이 비워진다. 모자라면 overflowed() 로 알린다.
+void test_pool_json_document()
+{
+    static PoolAllocator<CMD_JSON_POOL_BYTES> pool;
+    void *start = pool.allocate(8);
+    pool.deallocate(start);
+
+    {
+        JsonDocument doc(&pool);
+        char text[32];
+        for (int i = 0; i < 40; i++)
+        {
+            snprintf(text, sizeof(text), "key_%d", i);
+            doc[text] = i; // char* 키는 복사된다.
+        }
+        JsonArray offsets = doc["offset_ns"].to<JsonArray>();
+        for (int i = 0; i < 16; i++)
+        {
+            offsets.add(i * 100);
+        }
+        TEST_ASSERT_FALSE(doc.overflowed());
+        TEST_ASSERT_EQUAL_INT(39, doc["key_39"].as<int>());
+
+        JsonDocument value(&pool);
+        TEST_ASSERT_FALSE(deserializeJson(value, "[18,19,21,22]"));
+        TEST_ASSERT_EQUAL_INT(22, value[3].as<int>());
+    }
+    TEST_ASSERT_TRUE(pool.peak() > 0);
+    TEST_ASSERT_EQUAL_INT(0, pool.failed());
+    TEST_ASSERT_TRUE(pool.allocate(8) == start);
+
+    static PoolAllocator<256> small;
+    JsonDocument doc(&small);
+    char text[32];
+    for (int i = 0; i < 40; i++)
+    {
+        snprintf(text, sizeof(text), "key_%d", i);
+        doc[text] = i;
+    }
+    TEST_ASSERT_TRUE(doc.overflowed());
+    TEST_ASSERT_TRUE(small.failed() > 0);
+}
+
+// tonkey::parse 와 같은 순서의 복사 : 남은 줄을 잘라 가며 토큰마다 새 문자열
+static int oldFind(const char *text)
+{
+    static std::string tokens[64];
+    int count = 0;
+    std::string line = text;
+    while (line.length() > 0 && count < 64)
+    {
+        size_t index = line.find(' ');
+        if (index == std::string::npos)
+        {
+            tokens[count++] = line;
+            break;
+        }
+        tokens[count++] = line.substr(0, index);
+        line = line.substr(index + 1);
+    }
+    std::vector<std::string> list;
+    for (int i = 0; i < count; i++)
+    {
+        list.push_back(tokens[i]);
+    }
+
+    std::string cmd = list[0];
+    if (cmd == "about")
+        return 1;
+    else if (cmd == "bench")
+        return 2;
+    else if (cmd == "calibrate")
+        return 3;
+    else if (cmd == "config")
+        return 4;
+    else if (cmd == "reboot")
+        return 5;
+    else if (cmd == "stats")
+        return 6;
+    else if (cmd == "stream")
+        return 7;
+    return 0;
+}
+
+static int newFind(const char *text)
+{
+    char line[64];
+    strncpy(line, text, sizeof(line) - 1);
+    line[sizeof(line) - 1] = 0;
+    CmdTokens tokens;
+    tokens.parse(line);
+    const CmdEntry<Handler> *cmd = cmdFind(s_commands, tokens.get(0));
+    return cmd != NULL ? cmd->handler() : 0;
+}
+
+// 두 경로가 같은 명령을 찾는지 확인하고 줄당 시간을 출력한다. (시간은 호스트마다 달라 검사하지 않는다)
+void test_old_vs_new_path()
+{
+    for (int i = 0; i < LINE_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(oldFind(s_lines[i]), newFind(s_lines[i]));
+    }
+
+    const int iterations = 20000;
+    volatile int sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; n++)
+    {
+        sink = oldFind(s_lines[n % LINE_COUNT]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; n++)
+    {
+        sink = newFind(s_lines[n % LINE_COUNT]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    (void)sink;
+
+    double oldNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+    double newNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / iterations;
+    char message[96];
+    snprintf(message, sizeof(message), "old_ns %.0f new_ns %.0f speedup %.1f", oldNs, newNs, newNs > 0 ? oldNs / newNs : 0.0);
+    TEST_MESSAGE(message);
+}
+
+static int runTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tokens_in_place);
+    RUN_TEST(test_tokens_overflow);
+    RUN_TEST(test_table_find);
+    RUN_TEST(test_pool_stack_order);
+    RUN_TEST(test_pool_reallocate);
+    RUN_TEST(test_pool_json_document);
+    RUN_TEST(test_old_vs_new_path);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // 업로드 뒤 시리얼 연결 대기
+    runTests();
+}
+
+void loop()
+{
+}
+#else
+int main()
+{
+    return runTests();
+}
+#endif
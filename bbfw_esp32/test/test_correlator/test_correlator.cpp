@@ -0,0 +1,197 @@
+// 상관기(Correlator) 단위 테스트 : pio test -e lolin_d32 -f test_correlator
+// 하드웨어 없이 에지 시각만 넣어 이벤트 묶음을 확인한다.
+#include <Arduino.h>
+#include <unity.h>
+
+#include "../../src/correlator.cpp"
+#include "../../src/packet.hpp"
+
+using namespace dataCapture;
+
+static const int CHANNELS = 4;
+// 1m 구경 / 343 m/s ~ 2.9ms
+static const uint32_t WINDOW_NS = 2915000 + 100000;
+static const uint32_t RING_NS = 50000;
+// configure 가 넣는 기본 지연 여유 (correlator.cpp EXPIRE_MARGIN_NS)
+static const uint32_t LATENCY_NS = 200000;
+
+// 충격음 하나의 채널별 도착 지연 (ns)
+static const timeBase::stamp_t DELAY_NS[CHANNELS] = {0, 300000, 600000, 900000};
+
+static Correlator s_correlator;
+
+static void addEdge(int channel, timeBase::stamp_t ns)
+{
+    EdgeRecord edge = {ns, 0, (uint8_t)channel};
+    s_correlator.addEdge(edge);
+}
+
+// 두 충격음의 에지를 도착 순서대로 넣는다.
+static void addImpulses(timeBase::stamp_t t0, timeBase::stamp_t t1)
+{
+    timeBase::stamp_t times[2 * CHANNELS];
+    int channels[2 * CHANNELS];
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        times[i] = t0 + DELAY_NS[i];
+        channels[i] = i;
+        times[CHANNELS + i] = t1 + DELAY_NS[i];
+        channels[CHANNELS + i] = i;
+    }
+    for (int i = 1; i < 2 * CHANNELS; i++)
+    {
+        for (int j = i; j > 0 && times[j] < times[j - 1]; j--)
+        {
+            timeBase::stamp_t t = times[j];
+            times[j] = times[j - 1];
+            times[j - 1] = t;
+            int c = channels[j];
+            channels[j] = channels[j - 1];
+            channels[j - 1] = c;
+        }
+    }
+    for (int i = 0; i < 2 * CHANNELS; i++)
+    {
+        addEdge(channels[i], times[i]);
+    }
+}
+
+static void checkEvent(timeBase::stamp_t t0)
+{
+    Event event;
+    TEST_ASSERT_TRUE(s_correlator.pop(event));
+    TEST_ASSERT_EQUAL_HEX32(channelMask(CHANNELS), event.mask);
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)(t0 + DELAY_NS[i]), (uint32_t)event.ns[i]);
+    }
+}
+
+void setUp()
+{
+    s_correlator = Correlator();
+    s_correlator.configure(CHANNELS, WINDOW_NS, 0, RING_NS);
+}
+
+void tearDown()
+{
+}
+
+// 창(2.9ms) 보다 짧은 1.5ms 간격 두 충격음 -> 완전한 이벤트 둘
+void test_two_impulses_inside_window()
+{
+    const timeBase::stamp_t t0 = 10000000;
+    const timeBase::stamp_t t1 = t0 + 1500000;
+    addImpulses(t0, t1);
+    s_correlator.expire(t1 + 10 * (timeBase::stamp_t)WINDOW_NS);
+
+    checkEvent(t0);
+    checkEvent(t1);
+    Event event;
+    TEST_ASSERT_FALSE(s_correlator.pop(event));
+    TEST_ASSERT_EQUAL_UINT32(2, s_correlator.complete);
+    TEST_ASSERT_EQUAL_UINT32(0, s_correlator.partial);
+    TEST_ASSERT_EQUAL_UINT32(0, s_correlator.ringing);
+}
+
+// ring hold-off 안의 같은 채널 재트리거는 링잉으로 버리고 이벤트는 하나
+void test_ringing_dropped()
+{
+    const timeBase::stamp_t t0 = 10000000;
+    addEdge(0, t0);
+    addEdge(0, t0 + 10000);
+    addEdge(1, t0 + DELAY_NS[1]);
+    addEdge(1, t0 + DELAY_NS[1] + 20000);
+    addEdge(2, t0 + DELAY_NS[2]);
+    addEdge(3, t0 + DELAY_NS[3]);
+    s_correlator.expire(t0 + 10 * (timeBase::stamp_t)WINDOW_NS);
+
+    checkEvent(t0);
+    Event event;
+    TEST_ASSERT_FALSE(s_correlator.pop(event));
+    TEST_ASSERT_EQUAL_UINT32(2, s_correlator.ringing);
+    TEST_ASSERT_EQUAL_UINT32(1, s_correlator.complete);
+}
+
+// 간격(0.5ms)이 채널 지연 폭(0.9ms)보다 짧아 두 이벤트가 함께 열리고 에지가 엇갈려 들어온다.
+// 채널이 다 찬 이벤트는 창을 기다리지 않고 바로 닫힌다.
+void test_interleaved_impulses()
+{
+    const timeBase::stamp_t t0 = 10000000;
+    const timeBase::stamp_t t1 = t0 + 500000;
+    TEST_ASSERT_TRUE(t1 - t0 < DELAY_NS[CHANNELS - 1]);
+
+    Event event;
+    addEdge(0, t0);               // 0.0 ms
+    addEdge(1, t0 + DELAY_NS[1]); // 0.3
+    addEdge(0, t1);               // 0.5 : ch0 이 이미 찬 첫 이벤트 대신 둘째 이벤트를 연다.
+    addEdge(2, t0 + DELAY_NS[2]); // 0.6
+    addEdge(1, t1 + DELAY_NS[1]); // 0.8
+    TEST_ASSERT_FALSE(s_correlator.pop(event));
+    TEST_ASSERT_TRUE(s_correlator.hasOpen());
+
+    addEdge(3, t0 + DELAY_NS[3]); // 0.9 : 첫 이벤트가 차서 닫힌다.
+    checkEvent(t0);
+    TEST_ASSERT_FALSE(s_correlator.pop(event));
+
+    addEdge(2, t1 + DELAY_NS[2]); // 1.1
+    addEdge(3, t1 + DELAY_NS[3]); // 1.4
+    checkEvent(t1);
+    TEST_ASSERT_FALSE(s_correlator.hasOpen());
+    TEST_ASSERT_EQUAL_UINT32(2, s_correlator.complete);
+    TEST_ASSERT_EQUAL_UINT32(0, s_correlator.partial);
+    TEST_ASSERT_EQUAL_UINT32(0, s_correlator.forced);
+}
+
+// 빠진 채널(2) : 창 + 지연 여유가 지나야 닫히고, 일부 채널 이벤트로 나간다.
+// 패킷에는 빠진 채널이 TICK_MISSING 으로 실린다.
+void test_missing_channel()
+{
+    const timeBase::stamp_t t0 = 10000000;
+    addEdge(0, t0);
+    addEdge(1, t0 + DELAY_NS[1]);
+    addEdge(3, t0 + DELAY_NS[3]);
+
+    Event event;
+    const timeBase::stamp_t deadline = t0 + WINDOW_NS + LATENCY_NS;
+    s_correlator.expire(deadline - 1);
+    TEST_ASSERT_FALSE(s_correlator.pop(event));
+    TEST_ASSERT_TRUE(s_correlator.nsUntilDeadline(deadline - 1) == 1);
+
+    s_correlator.expire(deadline);
+    TEST_ASSERT_TRUE(s_correlator.pop(event));
+    TEST_ASSERT_EQUAL_HEX32(0x0B, event.mask);
+    TEST_ASSERT_EQUAL_UINT32(1, s_correlator.partial);
+    TEST_ASSERT_EQUAL_UINT32(0, s_correlator.complete);
+    TEST_ASSERT_FALSE(s_correlator.hasOpen());
+
+    uint32_t ticks[CHANNELS];
+    for (int ch = 0; ch < CHANNELS; ch++)
+    {
+        ticks[ch] = (event.mask & (1UL << ch)) ? (uint32_t)(event.ns[ch] - event.minNs) : TICK_MISSING;
+    }
+    uint8_t buf[32];
+    int n = packetV2::encodeEvent(buf, buf + sizeof(buf), ticks, CHANNELS, event.mask, 0);
+    TEST_ASSERT_TRUE(n > 0);
+    uint32_t out[CHANNELS];
+    uint32_t mask = 0;
+    TEST_ASSERT_EQUAL_INT(n, packetV2::decodeEvent(buf, buf + n, out, CHANNELS, mask, 0));
+    TEST_ASSERT_EQUAL_HEX32(event.mask, mask);
+    TEST_ASSERT_EQUAL_UINT32(TICK_MISSING, out[2]);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)DELAY_NS[3], out[3]);
+}
+
+void setup()
+{
+    delay(2000); // 업로드 뒤 시리얼 연결 대기
+    UNITY_BEGIN();
+    RUN_TEST(test_two_impulses_inside_window);
+    RUN_TEST(test_ringing_dropped);
+    RUN_TEST(test_interleaved_impulses);
+    RUN_TEST(test_missing_channel);
+    UNITY_END();
+}
+
+void loop()
+{
+}
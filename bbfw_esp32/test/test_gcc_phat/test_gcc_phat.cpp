@@ -0,0 +1,206 @@
+// GCC-PHAT 커널 단위 테스트 : pio test -e native -f test_gcc_phat (보드에서는 pio test -e lolin_d32 -f test_gcc_phat)
+// 같은 합성 신호를 채널마다 알려진 만큼 늦춰 넣고 상호상관 피크로 구한 지연을 확인한다.
+#include <math.h>
+#include <unity.h>
+
+#include "../../src/gccPhat.cpp"
+
+using gccPhat::Complex;
+
+static const int N = 1024;
+static const int MAX_LAG = 200;
+
+static Complex s_work[N];
+static Complex s_spec[4][N / 2 + 1];
+static int16_t s_buf[4][N];
+
+// 잡음 버스트 : 같은 seed 면 같은 신호, delay 샘플만큼 늦춘다.
+static void makeNoise(int16_t *dst, int delay)
+{
+    const int pad = MAX_LAG;
+    static int16_t src[N + 2 * pad];
+    uint32_t seed = 12345;
+    for (int i = 0; i < N + 2 * pad; i++)
+    {
+        seed = seed * 1664525UL + 1013904223UL;
+        src[i] = (int16_t)((seed >> 20) & 0x3FF) - 512;
+    }
+    for (int i = 0; i < N; i++)
+    {
+        dst[i] = 2048 + src[i + pad - delay];
+    }
+}
+
+// 광대역 합성음 (주파수 / 위상이 무작위인 사인 64개의 합) : 해석식이라 샘플 이하 지연도 정확히 만든다.
+static void makeTones(int16_t *dst, float delay)
+{
+    const int TONES = 64;
+    const float PI2 = 6.28318530717958647692f;
+    float freq[TONES], phase[TONES];
+    uint32_t seed = 777;
+    for (int k = 0; k < TONES; k++)
+    {
+        seed = seed * 1664525UL + 1013904223UL;
+        freq[k] = 0.02f + 0.43f * (seed >> 8) / 16777216.0f; // 샘플당 주기
+        seed = seed * 1664525UL + 1013904223UL;
+        phase[k] = PI2 * (seed >> 8) / 16777216.0f;
+    }
+    for (int i = 0; i < N; i++)
+    {
+        float t = i - delay;
+        float v = 0.0f;
+        for (int k = 0; k < TONES; k++)
+        {
+            v += sinf(PI2 * freq[k] * t + phase[k]);
+        }
+        dst[i] = (int16_t)lroundf(2048.0f + 100.0f * v);
+    }
+}
+
+// 채널 a, b 의 스펙트럼을 FFT 한 번으로 구한다.
+static void spectra(int a, int b)
+{
+    gccPhat::load(s_work, 0, s_buf[a], N, NULL, 0);
+    gccPhat::load(s_work, 1, s_buf[b], N, NULL, 0);
+    gccPhat::fft(s_work, false);
+    gccPhat::split(s_work, s_spec[a], s_spec[b]);
+}
+
+// (a1, b1), (a2, b2) 두 쌍의 상호상관을 역변환 한 번으로 구한다.
+static void lags(int a1, int b1, int a2, int b2, gccPhat::Lag &lag1, gccPhat::Lag &lag2)
+{
+    gccPhat::cross(s_work, s_spec[a1], s_spec[b1], s_spec[a2], s_spec[b2]);
+    gccPhat::fft(s_work, true);
+    lag1 = gccPhat::peak(s_work, 0, MAX_LAG);
+    lag2 = gccPhat::peak(s_work, 1, MAX_LAG);
+}
+
+void setUp()
+{
+    TEST_ASSERT_TRUE(gccPhat::init(N));
+}
+
+void tearDown()
+{
+}
+
+void test_init_sizes()
+{
+    TEST_ASSERT_FALSE(gccPhat::init(1000));
+    TEST_ASSERT_FALSE(gccPhat::init(2 * GCC_PHAT_MAX_N));
+    TEST_ASSERT_TRUE(gccPhat::init(256));
+    TEST_ASSERT_EQUAL_INT(256, gccPhat::size());
+    TEST_ASSERT_TRUE(gccPhat::init(N));
+    TEST_ASSERT_EQUAL_INT(N, gccPhat::size());
+}
+
+// 정수 지연 : 양수 = 첫 채널이 늦음, 두 쌍을 실수부 / 허수부로 한 번에
+void test_integer_lags()
+{
+    const int delay[4] = {0, 7, -13, 150};
+    for (int ch = 0; ch < 4; ch++)
+    {
+        makeNoise(s_buf[ch], delay[ch]);
+    }
+    spectra(0, 1);
+    spectra(2, 3);
+
+    gccPhat::Lag lag1, lag2;
+    lags(1, 0, 3, 2, lag1, lag2);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 7.0f, lag1.samples);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 163.0f, lag2.samples);
+    TEST_ASSERT_TRUE(lag1.peak > 0.5f);
+    TEST_ASSERT_TRUE(lag2.peak > 0.5f);
+
+    lags(0, 2, 2, 1, lag1, lag2);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 13.0f, lag1.samples);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -20.0f, lag2.samples);
+}
+
+// 샘플 이하 지연 : 포물선 보간 (sinc 모양 피크라 0.1 샘플 정도 치우침이 있다)
+void test_fractional_lags()
+{
+    const float delay[4] = {0.0f, 2.25f, -5.5f, 31.75f};
+    for (int ch = 0; ch < 4; ch++)
+    {
+        makeTones(s_buf[ch], delay[ch]);
+    }
+    spectra(0, 1);
+    spectra(2, 3);
+
+    gccPhat::Lag lag1, lag2;
+    lags(1, 0, 3, 0, lag1, lag2);
+    TEST_ASSERT_FLOAT_WITHIN(0.15f, 2.25f, lag1.samples);
+    TEST_ASSERT_FLOAT_WITHIN(0.15f, 31.75f, lag2.samples);
+
+    lags(2, 0, 1, 2, lag1, lag2);
+    TEST_ASSERT_FLOAT_WITHIN(0.15f, -5.5f, lag1.samples);
+    TEST_ASSERT_FLOAT_WITHIN(0.15f, 7.75f, lag2.samples);
+}
+
+// 원형 버퍼 두 구간(p1, p2) 으로 나눠 읽어도 한 구간과 같다. 채널 수가 홀수면 clear
+void test_split_span_and_odd_channel()
+{
+    makeNoise(s_buf[0], 0);
+    makeNoise(s_buf[1], 42);
+
+    gccPhat::load(s_work, 0, s_buf[1], 300, s_buf[1] + 300, N - 300);
+    gccPhat::clear(s_work, 1);
+    gccPhat::fft(s_work, false);
+    gccPhat::split(s_work, s_spec[1], NULL);
+
+    gccPhat::load(s_work, 0, s_buf[0], N, NULL, 0);
+    gccPhat::clear(s_work, 1);
+    gccPhat::fft(s_work, false);
+    gccPhat::split(s_work, s_spec[0], NULL);
+
+    gccPhat::cross(s_work, s_spec[1], s_spec[0], NULL, NULL);
+    gccPhat::fft(s_work, true);
+    gccPhat::Lag lag = gccPhat::peak(s_work, 0, MAX_LAG);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 42.0f, lag.samples);
+}
+
+// 범위 밖 지연은 maxLag 안에서만 찾는다.
+void test_max_lag_window()
+{
+    makeNoise(s_buf[0], 0);
+    makeNoise(s_buf[1], 30);
+    spectra(0, 1);
+
+    gccPhat::cross(s_work, s_spec[1], s_spec[0], NULL, NULL);
+    gccPhat::fft(s_work, true);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 30.0f, gccPhat::peak(s_work, 0, MAX_LAG).samples);
+    gccPhat::Lag lag = gccPhat::peak(s_work, 0, 10);
+    TEST_ASSERT_TRUE(fabsf(lag.samples) <= 10.5f);
+    TEST_ASSERT_TRUE(lag.peak < 0.2f);
+}
+
+static int runTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_sizes);
+    RUN_TEST(test_integer_lags);
+    RUN_TEST(test_fractional_lags);
+    RUN_TEST(test_split_span_and_odd_channel);
+    RUN_TEST(test_max_lag_window);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // 업로드 뒤 시리얼 연결 대기
+    runTests();
+}
+
+void loop()
+{
+}
+#else
+int main()
+{
+    return runTests();
+}
+#endif
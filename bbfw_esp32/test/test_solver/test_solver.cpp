@@ -0,0 +1,207 @@
+// TDOA 위치 계산 단위 테스트 : pio test -e native -f test_solver (보드에서는 pio test -e lolin_d32 -f test_solver)
+// 알려진 배치와 음원 위치로 시차를 만들어 넣고 계산한 위치를 확인한다.
+#include <math.h>
+#include <unity.h>
+
+#include "../../src/tdoaSolver.cpp"
+
+using namespace tdoaSolver;
+
+static const float SOUND_SPEED = 343.0f;
+
+static Setup makeSetup(int dim, int numSensors, const float (*pos)[3])
+{
+    Setup setup = {};
+    setup.dim = dim;
+    setup.numSensors = numSensors;
+    setup.soundSpeed = SOUND_SPEED;
+    for (int i = 0; i < numSensors; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            setup.pos[i][k] = pos[i][k];
+        }
+    }
+    TEST_ASSERT_TRUE(prepare(setup));
+    return setup;
+}
+
+// 음원 src 에서 각 센서까지의 도착 시각을 가장 빠른 채널 기준 시차(ns)로 만든다. noiseNs 는 채널별 더할 오차
+static uint32_t makeTicks(const Setup &setup, const float *src, const float *noiseNs, uint32_t *ticks)
+{
+    double t[SOLVER_MAX_SENSORS];
+    double first = 1e30;
+    for (int i = 0; i < setup.numSensors; i++)
+    {
+        double d2 = 0.0;
+        for (int k = 0; k < setup.dim; k++)
+        {
+            double dk = (double)src[k] - setup.pos[i][k];
+            d2 += dk * dk;
+        }
+        t[i] = sqrt(d2) / SOUND_SPEED * 1e9 + (noiseNs ? noiseNs[i] : 0.0f);
+        if (t[i] < first)
+        {
+            first = t[i];
+        }
+    }
+    uint32_t mask = 0;
+    for (int i = 0; i < setup.numSensors; i++)
+    {
+        ticks[i] = (uint32_t)lround(t[i] - first);
+        mask |= 1UL << i;
+    }
+    return mask;
+}
+
+static void checkFix(const Setup &setup, const float *src, const float *noiseNs, float tolM)
+{
+    uint32_t ticks[SOLVER_MAX_SENSORS];
+    uint32_t mask = makeTicks(setup, src, noiseNs, ticks);
+    Fix fix;
+    TEST_ASSERT_TRUE(solve(setup, ticks, mask, fix));
+    TEST_ASSERT_TRUE(fix.ok);
+    TEST_ASSERT_EQUAL_INT(setup.dim, fix.dim);
+    TEST_ASSERT_EQUAL_INT(setup.numSensors, fix.used);
+    for (int k = 0; k < setup.dim; k++)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(tolM, src[k], fix.pos[k]);
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// 1m 정사각형 네 모서리 (2차원, 센서 수 > 차원 + 1)
+void test_square_2d()
+{
+    const float pos[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+    Setup setup = makeSetup(2, 4, pos);
+    const float inside[2] = {0.3f, 0.7f};
+    const float outside[2] = {2.5f, -1.2f};
+    checkFix(setup, inside, NULL, 0.005f);
+    checkFix(setup, outside, NULL, 0.02f);
+}
+
+// 2차원 센서 3개 (차원 + 1) : 쌍곡선 두 개가 두 점에서 만나 이차식의 두 근이 모두 잔차 0 이 된다.
+// 이때는 센서 중심에 가까운 근을 고른다. near / far 는 같은 시차를 만드는 두 위치
+void test_triangle_2d_two_roots()
+{
+    const float pos[3][3] = {{0, 0, 0}, {1, 0, 0}, {0.5f, 0.9f, 0}};
+    Setup setup = makeSetup(2, 3, pos);
+    const float near[2] = {0.25f, 1.25f};
+    const float far[2] = {0.185546f, 1.616380f};
+    checkFix(setup, near, NULL, 0.005f);
+
+    // 먼 쪽 음원도 시차가 같아 가까운 근으로 풀린다. (잔차 ~ 0)
+    uint32_t ticks[SOLVER_MAX_SENSORS];
+    uint32_t mask = makeTicks(setup, far, NULL, ticks);
+    Fix fix;
+    TEST_ASSERT_TRUE(solve(setup, ticks, mask, fix));
+    TEST_ASSERT_TRUE(fix.residual < 0.001f);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, near[0], fix.pos[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, near[1], fix.pos[1]);
+
+    // 센서 안쪽 음원
+    const float inside[2] = {0.45f, 0.35f};
+    checkFix(setup, inside, NULL, 0.005f);
+}
+
+// 3차원 센서 5개 (사면체 + 위 하나)
+void test_3d()
+{
+    const float pos[5][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0.5f}};
+    Setup setup = makeSetup(3, 5, pos);
+    const float src[3] = {0.4f, 0.6f, 0.3f};
+    checkFix(setup, src, NULL, 0.005f);
+}
+
+// 채널별 잡음 (수 us) : 닫힌 형태 초기값을 Gauss-Newton 이 다듬어 잔차를 줄인다.
+void test_gauss_newton_with_noise()
+{
+    const float pos[6][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0.5f, -0.2f, 0}, {-0.2f, 0.5f, 0}};
+    Setup setup = makeSetup(2, 6, pos);
+    const float src[2] = {0.6f, 0.4f};
+    const float noiseNs[6] = {0, 4000, -3000, 2000, -5000, 3000};
+    checkFix(setup, src, noiseNs, 0.03f);
+
+    uint32_t ticks[SOLVER_MAX_SENSORS];
+    uint32_t mask = makeTicks(setup, src, noiseNs, ticks);
+    Fix fix;
+    TEST_ASSERT_TRUE(solve(setup, ticks, mask, fix));
+    TEST_ASSERT_TRUE(fix.iterations >= 1);
+    TEST_ASSERT_TRUE(fix.residual < 0.01f);
+}
+
+// 빠진 채널은 건너뛰고, 남은 센서가 차원 + 1 보다 적으면 실패
+void test_missing_channels()
+{
+    const float pos[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+    Setup setup = makeSetup(2, 4, pos);
+    const float src[2] = {0.3f, 0.2f};
+    uint32_t ticks[SOLVER_MAX_SENSORS];
+    uint32_t mask = makeTicks(setup, src, NULL, ticks);
+
+    Fix fix;
+    ticks[3] = SOLVER_TICK_MISSING;
+    TEST_ASSERT_TRUE(solve(setup, ticks, mask & ~(1UL << 3), fix));
+    TEST_ASSERT_EQUAL_INT(3, fix.used);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, src[0], fix.pos[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, src[1], fix.pos[1]);
+
+    ticks[2] = SOLVER_TICK_MISSING;
+    TEST_ASSERT_FALSE(solve(setup, ticks, mask & 0x3, fix));
+    TEST_ASSERT_FALSE(fix.ok);
+    TEST_ASSERT_EQUAL_INT(2, fix.used);
+}
+
+// 지역 배치로 푼 것이 configure 한 배치를 바꾸지 않는다. (bench solver)
+void test_local_setup_keeps_configured()
+{
+    const float live[3][3] = {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}};
+    configure(makeSetup(2, 3, live));
+    const float pos[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+    Setup local = makeSetup(2, 4, pos);
+    const float src[2] = {0.5f, 0.5f};
+    checkFix(local, src, NULL, 0.005f);
+
+    TEST_ASSERT_TRUE(ready());
+    TEST_ASSERT_EQUAL_INT(3, current().numSensors);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f, current().pos[1][0]);
+}
+
+static int runTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_square_2d);
+    RUN_TEST(test_triangle_2d_two_roots);
+    RUN_TEST(test_3d);
+    RUN_TEST(test_gauss_newton_with_noise);
+    RUN_TEST(test_missing_channels);
+    RUN_TEST(test_local_setup_keeps_configured);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // 업로드 뒤 시리얼 연결 대기
+    runTests();
+}
+
+void loop()
+{
+}
+#else
+int main()
+{
+    return runTests();
+}
+#endif
@@ -3,7 +3,7 @@
 import sys
 import struct
 
-from time import sleep
+from time import sleep, perf_counter
 
 from PySide6.QtCore import QUuid, QByteArray
 from PySide6.QtWidgets import QApplication, QWidget, QMainWindow
@@ -22,6 +22,54 @@ from solver.ls import estimate_position_tdoa
 
 CHECK_CODE = 250130
 
+# 시차 패킷 형식 (about 응답 parm[0] 비트마스크)
+BLE_FORMAT_V1 = 0x01
+BLE_FORMAT_V2 = 0x02
+TICK_MISSING = 0xFFFFFFFF
+
+# 시차 묶음 flags (0x0B parm[2], 0x0C flags)
+BLE_TD_FLAG_BENCH = 0x01
+BLE_TD_FLAG_REPLAY = 0x02
+
+# resume (cmd 0x04) 응답 상태
+BLE_RESUME_OK = 0
+BLE_RESUME_PARTIAL = 1
+BLE_RESUME_NONE = 2
+
+
+def _read_varint(buf, pos):
+    value = 0
+    for n in range(5):
+        if pos + n >= len(buf):
+            return None, pos
+        b = buf[pos + n]
+        value |= (b & 0x7F) << (7 * n)
+        if b & 0x80 == 0:
+            return value, pos + n + 1
+    return None, pos
+
+
+def decode_v2_events(buf, count, tick_shift, num_channels):
+    """ v2 이벤트 count 개 -> 채널별 시차(ns) 튜플 목록, 빠진 채널은 TICK_MISSING """
+    events = []
+    pos = 0
+    for _ in range(count):
+        mask, pos = _read_varint(buf, pos)
+        if mask is None:
+            return None
+        ticks = []
+        for ch in range(max(num_channels, mask.bit_length())):
+            if mask & (1 << ch):
+                v, pos = _read_varint(buf, pos)
+                if v is None:
+                    return None
+                tick = (v >> 1) ^ -(v & 1)  # zig-zag
+                ticks.append((tick << tick_shift) & 0xFFFFFFFF)
+            else:
+                ticks.append(TICK_MISSING)
+        events.append(tuple(ticks))
+    return events if pos == len(buf) else None
+
 
 class MainWindow(QMainWindow, Ui_MainWindow):
     def __init__(self):
@@ -34,6 +82,15 @@ class MainWindow(QMainWindow, Ui_MainWindow):
         
         self.characteristic = None
         self.device_info = None
+        
+        # 시차 데이터 단위 (ticks/sec), about 응답의 sampleRate 로 갱신
+        self.tick_rate = 1000000000
+        # 다음에 받을 이벤트 seq (연결이 끊겨도 유지, 다시 연결하면 여기부터 resume 요청)
+        self.event_seq = None
+        # about 응답의 채널 수, 시차 패킷 형식 (cmd 0x02 응답)
+        self.num_channels = 8
+        self.wire_format = BLE_FORMAT_V1
+        self.tick_shift = 0
 
         self.controller = None
         self.service = None
@@ -138,8 +195,16 @@ class MainWindow(QMainWindow, Ui_MainWindow):
         with open("datalog.txt", 'a') as f:
             f.write(str(data_values) + "\n")
         
-        # TDOA 데이터가 4채널 이상이라면 처음 4채널 데이터 사용
-        tdoa_data = data_values[:4]
+        if len(data_values) < 4:
+            return
+
+        # 빠진 채널(0xFFFFFFFF)이 있는 부분 이벤트는 위치 추정에서 제외
+        if any(v == 0xFFFFFFFF for v in data_values[:4]):
+            self.pte_Logs.appendPlainText(f"부분 이벤트 (빠진 채널 있음): {data_values}")
+            return
+        
+        # TDOA 데이터가 4채널 이상이라면 처음 4채널 데이터 사용 (tick -> μs)
+        tdoa_data = [v * 1e6 / self.tick_rate for v in data_values[:4]]
         # 추정 위치 계산 (가상 좌표, [0,1] 범위)
         estimated_pos = estimate_position_tdoa(tdoa_data)
         self.previewWidget.add_estimated_position(estimated_pos)
@@ -162,9 +227,9 @@ class MainWindow(QMainWindow, Ui_MainWindow):
             # <I B 3B Q 3B B I
             # checkCode(4), cmd(1), parm[3], chipId(8), version[3], chennelNum(1), sampleRate(4)
             
-            #S_Ble_Packet_Data = 40 bytes
-            #<I B 3B 8I
-            #checkCode(4), cmd(1), parm[3], data[8]
+            #S_Ble_Packet_Data = 8 + 4 x n bytes
+            #<I B 3B nI
+            #checkCode(4), cmd(1), parm[3] (parm[0] = n), data[n]
             
             # 헤더 파싱
             if(len(value) >= 8):
@@ -178,23 +243,39 @@ class MainWindow(QMainWindow, Ui_MainWindow):
                         print("=== About 응답 수신 ===")
                         _body = value[8:]
                         if len(value) == 24:
-                            chip_id, ver0, ver1, ver2, _, _ = struct.unpack('<Q B B B B I', _body)
+                            chip_id, ver0, ver1, ver2, ch_num, sample_rate = struct.unpack('<Q B B B B I', _body)
                             print(f"chipId       : 0x{chip_id:X}")
                             print(f"version      : {ver0}.{ver1}.{ver2}")
-                            # print(f"chennelNum   : {ch_num}")
-                            # print(f"sampleRate   : {sample_rate}")
+                            print(f"chennelNum   : {ch_num}")
+                            print(f"sampleRate   : {sample_rate}")
+                            if sample_rate > 0:
+                                self.tick_rate = sample_rate
                             
                             self.pte_Logs.appendPlainText(f"chipId       : 0x{chip_id:X}")
                             self.pte_Logs.appendPlainText(f"version      : {ver0}.{ver1}.{ver2}")
+                            self.num_channels = ch_num
+
+                            # 지원 형식 (p1 비트마스크) : v2 를 지원하면 v2 로 바꾼다.
+                            if p1 & BLE_FORMAT_V2:
+                                self.sendFormatCommand(2)
+                            # write -> notify 왕복 시간 (BLE 스택 비교용)
+                            self.sendPingCommand()
+                            # 다시 연결 : 끊긴 동안의 이벤트를 기록 링에서 받는다.
+                            if self.event_seq is not None:
+                                self.sendResumeCommand(self.event_seq, 0)
                             # self.pte_Logs.appendPlainText(f"chennelNum   : {ch_num}")
                             # self.pte_Logs.appendPlainText(f"sampleRate   : {sample_rate}")
                         else:
                             print("잘못된 About 응답 패킷 크기")
                     elif cmd == 0x09:
+                        if p3 == 1:
+                            return  # bench 데이터
                         print("=== Data 패킷 수신 (cmd=0x09) ===")
-                        if len(value) == 40:
+                        # 가변 길이 : 8 + 4 x 채널 수(p1), p1 == 0 은 이전 펌웨어의 8채널 고정 패킷
+                        num_channels = p1 if p1 > 0 else 8
+                        if len(value) == 8 + 4 * num_channels:
                             _body = value[8:]
-                            data_values = struct.unpack('<8I', _body)
+                            data_values = struct.unpack(f'<{num_channels}I', _body)
                             
                             print(f"수신된 데이터: {data_values}")
                             self.pte_Logs.appendPlainText(f"수신된 데이터: {data_values}")
@@ -202,6 +283,74 @@ class MainWindow(QMainWindow, Ui_MainWindow):
                             self.onReceiveTD_Data(data_values)
                         else:
                             print("잘못된 Data 응답 패킷 크기")
+                    elif cmd == 0x0B:
+                        # S_Ble_Packet_Batch = 12 + 4 x 채널 수(p1) x 이벤트 수(p2)
+                        # <I B 3B I nI
+                        # checkCode(4), cmd(1), 채널 수, 이벤트 수, flags(1 bench, 2 재전송), seq(4, 첫 이벤트), data[p2][p1]
+                        if p1 > 0 and len(value) == 12 + 4 * p1 * p2:
+                            if p3 & BLE_TD_FLAG_BENCH:
+                                return  # bench 데이터
+                            (seq,) = struct.unpack('<I', value[8:12])
+                            self.trackEvents(seq, p2, p3)
+
+                            print(f"=== 묶음 패킷 수신 (cmd=0x0B) : seq {seq}, 이벤트 {p2}개 ===")
+                            values = struct.unpack(f'<{p1 * p2}I', value[12:])
+                            for i in range(p2):
+                                data_values = values[i * p1:(i + 1) * p1]
+                                self.pte_Logs.appendPlainText(f"수신된 데이터: {data_values}")
+                                self.onReceiveTD_Data(data_values)
+                        else:
+                            print("잘못된 묶음 패킷 크기")
+                    elif cmd == 0x02:
+                        # 형식 선택 응답 : p1 형식, p2 v2 tick 단위 (2^p2 ns)
+                        self.wire_format = p1
+                        self.tick_shift = p2
+                        self.pte_Logs.appendPlainText(f"시차 패킷 형식 : v{2 if p1 == BLE_FORMAT_V2 else 1}")
+                    elif cmd == 0x03:
+                        # ping 응답 : token = 보낸 시각 (us)
+                        if len(value) == 12:
+                            (token,) = struct.unpack('<I', value[8:12])
+                            rtt_us = (int(perf_counter() * 1000000) - token) & 0xFFFFFFFF
+                            self.pte_Logs.appendPlainText(f"ping rtt : {rtt_us / 1000:.1f} ms")
+                        else:
+                            print("잘못된 ping 패킷 크기")
+                    elif cmd == 0x04:
+                        # resume 응답 : p1 상태, 실제로 다시 보낼 범위
+                        if len(value) == 16:
+                            from_seq, to_seq = struct.unpack('<I I', value[8:16])
+                            status = {BLE_RESUME_OK: "ok", BLE_RESUME_PARTIAL: "일부 잃음", BLE_RESUME_NONE: "기록 없음"}.get(p1, str(p1))
+                            self.pte_Logs.appendPlainText(f"resume : {from_seq} ~ {to_seq} ({to_seq - from_seq}개, {status})")
+                        else:
+                            print("잘못된 resume 패킷 크기")
+                    elif cmd == 0x0C:
+                        # wire format v2 : <I B B B B H + 이벤트 count 개
+                        # checkCode(4), cmd(1), count(1), tickShift(1), flags(1), seq(2)
+                        # 이벤트 = varint(채널 비트맵) + 채널별 varint(zigzag(tick))
+                        if len(value) >= 10:
+                            count, tick_shift, flags, seq = struct.unpack('<B B B H', value[5:10])
+                            if flags & BLE_TD_FLAG_BENCH:
+                                return  # bench 데이터
+                            self.trackEvents(self.unwrapSeq(seq), count, flags)
+                            events = decode_v2_events(bytes(value[10:]), count, tick_shift, self.num_channels)
+                            if events is None:
+                                print("잘못된 v2 패킷")
+                                return
+                            for data_values in events:
+                                self.pte_Logs.appendPlainText(f"수신된 데이터: {data_values}")
+                                self.onReceiveTD_Data(data_values)
+                        else:
+                            print("잘못된 v2 패킷 크기")
+                    elif cmd == 0x0A:
+                        # S_Ble_Packet_Position = 28 bytes
+                        # <I B 3B 3f f I
+                        # checkCode(4), cmd(1), dim(1), used(1), iterations(1), pos[3], residual, mask
+                        if len(value) == 28:
+                            x, y, z, residual, mask = struct.unpack('<3f f I', value[8:])
+                            pos = (x, y) if p1 == 2 else (x, y, z)
+                            print(f"=== 위치 패킷 수신 (cmd=0x0A) : {pos} res {residual:.4f} m ===")
+                            self.pte_Logs.appendPlainText(f"기기 위치 : {tuple(round(v, 3) for v in pos)} (채널 {p2}개, 잔차 {residual * 1000:.1f} mm)")
+                        else:
+                            print("잘못된 위치 패킷 크기")
                         
                         
                 else:
@@ -225,6 +374,49 @@ class MainWindow(QMainWindow, Ui_MainWindow):
             self.service.writeCharacteristic(self.characteristic, packet)
             print(f"전송 바이트: {packet.toHex()}")
             
+    def sendFormatCommand(self, version):
+        """ 시차 패킷 형식 선택 (cmd 0x02, parm[0] = BLE_FORMAT_*) """
+        if self.characteristic and self.characteristic.isValid():
+            fmt = BLE_FORMAT_V2 if version == 2 else BLE_FORMAT_V1
+            packet_bytes = struct.pack('<I B 3B', CHECK_CODE, 0x02, fmt, 0, 0)
+            self.service.writeCharacteristic(self.characteristic, QByteArray(packet_bytes))
+            print(f"[sendFormatCommand] v{version}")
+
+    def sendPingCommand(self):
+        """ ping (cmd 0x03) : 기기가 같은 패킷을 notify 로 돌려준다. token 은 보낸 시각 (us) """
+        if self.characteristic and self.characteristic.isValid():
+            token = int(perf_counter() * 1000000) & 0xFFFFFFFF
+            packet_bytes = struct.pack('<I B 3B I', CHECK_CODE, 0x03, 0, 0, 0, token)
+            self.service.writeCharacteristic(self.characteristic, QByteArray(packet_bytes))
+
+    def sendResumeCommand(self, from_seq, to_seq):
+        """ resume (cmd 0x04) : from_seq 부터 to_seq 전까지 (0 이면 지금까지) 기록 링에서 다시 받는다. """
+        if self.characteristic and self.characteristic.isValid():
+            packet_bytes = struct.pack('<I B 3B I I', CHECK_CODE, 0x04, 0, 0, 0, from_seq, to_seq)
+            self.service.writeCharacteristic(self.characteristic, QByteArray(packet_bytes))
+            print(f"[sendResumeCommand] {from_seq} ~ {to_seq}")
+
+    def unwrapSeq(self, seq16):
+        """ v2 헤더의 하위 16비트 seq 를 마지막으로 받은 seq 근처의 32비트 seq 로 """
+        if self.event_seq is None:
+            return seq16
+        seq = (self.event_seq & ~0xFFFF) | seq16
+        if seq - self.event_seq > 0x8000:
+            seq -= 0x10000
+        elif self.event_seq - seq > 0x8000:
+            seq += 0x10000
+        return seq
+
+    def trackEvents(self, seq, count, flags):
+        """ 실시간 묶음의 seq 로 빠진 이벤트를 찾는다. (재전송 묶음은 이미 빠진 범위라 건너뛴다) """
+        if flags & BLE_TD_FLAG_REPLAY:
+            print(f"재전송 이벤트 : {seq} ~ {seq + count - 1}")
+            return
+        if self.event_seq is not None and seq > self.event_seq:
+            self.pte_Logs.appendPlainText(f"이벤트 빠짐 : {self.event_seq} ~ {seq - 1}")
+        if self.event_seq is None or seq + count > self.event_seq:
+            self.event_seq = seq + count
+
     def onClearPreview(self):
         """ 미리 보기 위젯 초기화 """
         self.previewWidget.clear()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# 유선 바이너리 이벤트 스트림 수신 (펌웨어 stream binary, bbfw_esp32 packet.hpp STREAM_REC_*)
+# 레코드 = COBS(payload + CRC32) + 0x00, CRC32 = zlib.crc32
+#
+#   python serialStream.py COM5 --baud 921600
+#
+# 시작할 때 115200 으로 "stream binary <baud>" 를 보내고 바꾼 baud 로 다시 연다.
+# 이벤트는 mainWindow 처럼 datalog.txt 에 튜플로 덧붙인다.
+import argparse
+import struct
+import time
+import zlib
+
+import serial
+
+STREAM_REC_EVENT = 0x01
+STREAM_REC_TEXT = 0x02
+STREAM_REC_POS = 0x03
+
+EVENT_HEADER = struct.Struct('<B B H I Q I')      # type, channels, reserved, seq, timeNs, mask
+POS_RECORD = struct.Struct('<B B B B I 3f f I')    # type, dim, used, iterations, seq, pos, residual, mask
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_record(frame):
+    """ 0x00 을 뺀 프레임 하나 -> payload (CRC 가 틀리면 None) """
+    raw = cobs_decode(frame)
+    if raw is None or len(raw) < 5:
+        return None
+    payload, crc = raw[:-4], struct.unpack('<I', raw[-4:])[0]
+    if zlib.crc32(payload) != crc:
+        return None
+    return payload
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('port')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--log', default='datalog.txt')
+    args = parser.parse_args()
+
+    with serial.Serial(args.port, 115200, timeout=1) as port:
+        port.write(f'stream binary {args.baud}\n'.encode())
+        print(port.readline().decode(errors='replace').strip())
+        time.sleep(0.05)
+        port.baudrate = args.baud
+        port.reset_input_buffer()
+
+        pending = bytearray()
+        text = ''
+        last_seq = None
+        bad = 0
+        with open(args.log, 'a') as log:
+            while True:
+                pending += port.read(port.in_waiting or 1)
+                while True:
+                    end = pending.find(0)
+                    if end < 0:
+                        break
+                    frame, pending = bytes(pending[:end]), pending[end + 1:]
+                    payload = parse_record(frame)
+                    if payload is None:
+                        bad += 1
+                        print(f'bad record ({bad})')
+                        continue
+
+                    kind = payload[0]
+                    if kind == STREAM_REC_EVENT:
+                        _, channels, _, seq, time_ns, mask = EVENT_HEADER.unpack_from(payload)
+                        ticks = struct.unpack_from(f'<{channels}I', payload, EVENT_HEADER.size)
+                        if last_seq is not None and seq != (last_seq + 1) & 0xFFFFFFFF:
+                            print(f'seq gap {last_seq} -> {seq}')
+                        last_seq = seq
+                        values = tuple(-1 if t == 0xFFFFFFFF else t for t in ticks)
+                        log.write(str(values) + '\n')
+                        print(seq, time_ns, values)
+                    elif kind == STREAM_REC_POS:
+                        _, dim, used, iterations, seq, x, y, z, residual, mask = POS_RECORD.unpack_from(payload)
+                        print(f'pos {seq} {x:.3f} {y:.3f} {z:.3f} res {residual:.4f}')
+                    elif kind == STREAM_REC_TEXT:
+                        text += payload[1:].decode(errors='replace')
+                        while '\n' in text:
+                            line, text = text.split('\n', 1)
+                            print(line.strip())
+
+
+if __name__ == '__main__':
+    main()